@@ -0,0 +1,216 @@
+// Streaming CBOR writer over a fixed buffer (RFC 8949)
+
+#include <CborWriter.h>
+#include <string.h>
+
+
+/************************************************************
+ * Constructor
+ * @param[in] buf  output buffer, owned by the caller
+ * @param[in] size size of buffer
+ ************************************************************/
+CborWriter::CborWriter(uint8_t *buf, size_t size) {
+  _buf = buf;
+  _size = size;
+  reset();
+}
+
+
+/************************************************************
+ * Start a new document
+ ************************************************************/
+void CborWriter::reset(void) {
+  _len = 0;
+  _overflow = (_size == 0);
+}
+
+
+/************************************************************
+ * Append bytes
+ * - nothing is appended if they do not fit completely
+ ************************************************************/
+void CborWriter::put(const uint8_t *data, size_t len) {
+  if (_overflow) return;
+  if (_len + len > _size) {
+    _overflow = true;
+    return;
+  }
+  memcpy(_buf + _len, data, len);
+  _len += len;
+}
+
+
+/************************************************************
+ * Append head (initial byte and argument)
+ ************************************************************/
+void CborWriter::putHead(uint8_t major, uint64_t value) {
+  uint8_t head[CBOR_HEAD_LEN];
+  put(head, encodeHead(major, value, head));
+}
+
+
+/************************************************************
+ * Append integer with sign
+ ************************************************************/
+void CborWriter::putInt(int64_t value) {
+  uint8_t head[CBOR_HEAD_LEN];
+  put(head, encodeInt(value, head));
+}
+
+
+/************************************************************
+ * Start next member
+ * @param[in] key key of member, CBOR_NO_KEY: array element or
+ *                top level
+ ************************************************************/
+void CborWriter::member(int16_t key) {
+  if (key != CBOR_NO_KEY) putHead(CBOR_UINT, (uint16_t)key);
+}
+
+
+/************************************************************
+ * Begin / end map and array (indefinite length)
+ * @param[in] key key of member, CBOR_NO_KEY: array element or
+ *                top level
+ ************************************************************/
+void CborWriter::beginMap(int16_t key) {
+  uint8_t b = CBOR_MAP | CBOR_INDEFINITE;
+  member(key);
+  put(&b, 1);
+}
+
+void CborWriter::endMap(void) {
+  uint8_t b = CBOR_BREAK;
+  put(&b, 1);
+}
+
+void CborWriter::beginArray(int16_t key) {
+  uint8_t b = CBOR_ARRAY | CBOR_INDEFINITE;
+  member(key);
+  put(&b, 1);
+}
+
+void CborWriter::endArray(void) {
+  endMap();
+}
+
+
+/************************************************************
+ * Add integers
+ * - shortest encoding: 0 - 23 take one byte
+ * @param[in] key   key of member, CBOR_NO_KEY: array element
+ * @param[in] value value
+ ************************************************************/
+void CborWriter::addInt(int16_t key, int64_t value) {
+  member(key);
+  putInt(value);
+}
+
+void CborWriter::addUInt(int16_t key, uint64_t value) {
+  member(key);
+  putHead(CBOR_UINT, value);
+}
+
+
+/************************************************************
+ * Add fixed point number
+ * - decimal fraction 4([-decimals, value]), plain integer if
+ *   there are no decimals
+ * @param[in] key      key of member, CBOR_NO_KEY: array element
+ * @param[in] value    value [10^-decimals], e.g. 2150
+ * @param[in] decimals number of decimals, e.g. 2: 21.50
+ ************************************************************/
+void CborWriter::addFixed(int16_t key, int32_t value, uint8_t decimals) {
+  member(key);
+  if (decimals) {
+    putHead(CBOR_TAG, CBOR_TAG_DECIMAL);
+    putHead(CBOR_ARRAY, 2);
+    putInt(-(int64_t)decimals);
+  }
+  putInt(value);
+}
+
+
+/************************************************************
+ * Add text string (UTF-8, not escaped)
+ * @param[in] key   key of member, CBOR_NO_KEY: array element
+ * @param[in] value text (NULL: empty string)
+ ************************************************************/
+void CborWriter::addString(int16_t key, const char *value) {
+  size_t len = value ? strlen(value) : 0;
+  member(key);
+  putHead(CBOR_TEXT, len);
+  put((const uint8_t *)value, len);
+}
+
+
+/************************************************************
+ * Add byte string
+ * @param[in] key  key of member, CBOR_NO_KEY: array element
+ * @param[in] data bytes
+ * @param[in] len  number of bytes
+ ************************************************************/
+void CborWriter::addBytes(int16_t key, const uint8_t *data, size_t len) {
+  member(key);
+  putHead(CBOR_BYTES, len);
+  put(data, len);
+}
+
+
+/************************************************************
+ * Add null
+ * @param[in] key key of member, CBOR_NO_KEY: array element
+ ************************************************************/
+void CborWriter::addNull(int16_t key) {
+  uint8_t b = CBOR_NULL;
+  member(key);
+  put(&b, 1);
+}
+
+
+/************************************************************
+ * Encode head: initial byte and argument (big endian)
+ * @param[in]  major major type CBOR_xx
+ * @param[in]  value argument (value, length or tag)
+ * @param[out] buf   at least CBOR_HEAD_LEN bytes
+ * @return     number of bytes
+ ************************************************************/
+size_t CborWriter::encodeHead(uint8_t major, uint64_t value, uint8_t *buf) {
+  size_t n;
+  if (value < 24) {
+    buf[0] = major | (uint8_t)value;
+    return 1;
+  } else if (value <= 0xff) {
+    buf[0] = major | 24;
+    n = 1;
+  } else if (value <= 0xffff) {
+    buf[0] = major | 25;
+    n = 2;
+  } else if (value <= 0xffffffffu) {
+    buf[0] = major | 26;
+    n = 4;
+  } else {
+    buf[0] = major | 27;
+    n = 8;
+  }
+  for (size_t i = n; i > 0; i--) {
+    buf[i] = (uint8_t)value;
+    value >>= 8;
+  }
+  return n + 1;
+}
+
+
+/************************************************************
+ * Encode integer with sign
+ * - negative values n as major type 1 with argument -1 - n
+ * @param[in]  value value
+ * @param[out] buf   at least CBOR_HEAD_LEN bytes
+ * @return     number of bytes
+ ************************************************************/
+size_t CborWriter::encodeInt(int64_t value, uint8_t *buf) {
+  if (value < 0) {
+    return encodeHead(CBOR_NEGINT, (uint64_t)(-1 - value), buf);
+  }
+  return encodeHead(CBOR_UINT, (uint64_t)value, buf);
+}
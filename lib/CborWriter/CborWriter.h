@@ -0,0 +1,73 @@
+// Streaming CBOR writer over a fixed buffer (RFC 8949)
+//
+// - Counterpart of JsonWriter for compact binary messages: members
+//   are identified by small integer keys instead of names
+// - Maps and arrays have indefinite length (closed by a break byte),
+//   so nothing has to be counted in advance
+// - Fixed point values are written as decimal fractions (tag 4:
+//   [-decimals, value]), so they are decoded without rounding
+// - No heap allocation; if the buffer is too small, writing stops
+//   and overflow() is set
+// - Only depends on <stdint.h>, so host side tools can use it as well
+
+#ifndef CBORWRITER_h
+#define CBORWRITER_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CBOR_NO_KEY              -1 // array element or top level
+#define CBOR_HEAD_LEN             9 // longest head: initial byte + 64 bit argument
+
+// Major types (upper 3 bits of the initial byte)
+#define CBOR_UINT              0x00
+#define CBOR_NEGINT            0x20
+#define CBOR_BYTES             0x40
+#define CBOR_TEXT              0x60
+#define CBOR_ARRAY             0x80
+#define CBOR_MAP               0xa0
+#define CBOR_TAG               0xc0
+#define CBOR_SIMPLE            0xe0
+// Single byte items
+#define CBOR_INDEFINITE        0x1f // additional info: indefinite length
+#define CBOR_FALSE             0xf4
+#define CBOR_TRUE              0xf5
+#define CBOR_NULL              0xf6
+#define CBOR_BREAK             0xff // end of indefinite map / array
+#define CBOR_TAG_DECIMAL          4 // decimal fraction [exponent, mantissa]
+
+class CborWriter {
+  public:
+    CborWriter(uint8_t *buf, size_t size);
+
+    void           reset(void);                                              // start a new document
+    void           beginMap(int16_t key = CBOR_NO_KEY);                      // indefinite map (key: member of enclosing map)
+    void           endMap(void);                                             // break
+    void           beginArray(int16_t key = CBOR_NO_KEY);                    // indefinite array
+    void           endArray(void);                                           // break
+    void           addInt(int16_t key, int64_t value);                       // 42, -7
+    void           addUInt(int16_t key, uint64_t value);                     // 4294967295
+    void           addFixed(int16_t key, int32_t value, uint8_t decimals);   // value / 10^decimals: 2150, 2 -> 4([-2, 2150])
+    void           addString(int16_t key, const char *value);                // text string
+    void           addBytes(int16_t key, const uint8_t *data, size_t len);   // byte string
+    void           addNull(int16_t key);                                     // null
+    const uint8_t *data(void) const { return _buf; }                         // encoded bytes
+    size_t         length(void) const { return _len; }                       // number of encoded bytes
+    bool           overflow(void) const { return _overflow; }                // buffer was too small
+
+    static size_t  encodeHead(uint8_t major, uint64_t value, uint8_t *buf);  // initial byte and argument, return length
+    static size_t  encodeInt(int64_t value, uint8_t *buf);                   // integer with sign, return length
+
+  protected:
+    uint8_t *_buf;
+    size_t   _size;
+    size_t   _len;
+    bool     _overflow;
+
+    void put(const uint8_t *data, size_t len);
+    void putHead(uint8_t major, uint64_t value);
+    void putInt(int64_t value);
+    void member(int16_t key);
+};
+
+#endif  // CBORWRITER_h
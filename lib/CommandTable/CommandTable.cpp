@@ -0,0 +1,131 @@
+// Command table with a perfect hash, commands parsed in place
+
+#include <CommandTable.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/************************************************************
+ * Constructor
+ * @param[in] buf  output buffer
+ * @param[in] size size of output buffer (incl. terminator)
+ ************************************************************/
+CommandReply::CommandReply(char *buf, size_t size) : _buf(buf), _size(size) {
+  reset();
+}
+
+
+/************************************************************
+ * Start a new response
+ ************************************************************/
+void CommandReply::reset(void) {
+  _len = 0;
+  if (_size) _buf[0] = 0;
+}
+
+
+/************************************************************
+ * Append text
+ ************************************************************/
+void CommandReply::add(const char *text) {
+  add(text, strlen(text));
+}
+
+
+/************************************************************
+ * Append len characters of text, truncated if the buffer is
+ * full
+ ************************************************************/
+void CommandReply::add(const char *text, size_t len) {
+  if (!_size) return;
+  if (len > _size - 1 - _len) len = _size - 1 - _len;
+  memcpy(_buf + _len, text, len);
+  _len += len;
+  _buf[_len] = 0;
+}
+
+
+/************************************************************
+ * Append unsigned integer
+ ************************************************************/
+void CommandReply::addUInt(uint64_t value) {
+  char num[21];
+  size_t i = sizeof(num);
+  do {
+    num[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  add(num + i, sizeof(num) - i);
+}
+
+
+/************************************************************
+ * Compare command name, ignoring case
+ * @param[in] name command name, terminated
+ * @param[in] p    name received, need not be terminated
+ * @param[in] len  length of name received
+ ************************************************************/
+bool commandNameEquals(const char *name, const char *p, size_t len) {
+  char a, b;
+  for (size_t i = 0; i < len; i++) {
+    a = name[i];
+    b = p[i];
+    if (!a) return false;
+    if ((a >= 'A') && (a <= 'Z')) a |= 0x20;
+    if ((b >= 'A') && (b <= 'Z')) b |= 0x20;
+    if (a != b) return false;
+  }
+  return name[len] == 0;
+}
+
+
+/************************************************************
+ * Parse arguments
+ * - separated by blanks (or tabs, line ends), strings with
+ *   blanks in double quotes
+ * @param[in]  types argument types COMMAND_ARG_xx, e.g. "sd"
+ * @param[in]  p     first character after the command name
+ * @param[in]  end   end of the command line
+ * @param[out] args  arguments (COMMAND_ARGS_MAX)
+ * @return     NULL, or the error
+ ************************************************************/
+const char *commandParseArgs(const char *types, const char *p, const char *end, CommandArg *args) {
+  char tok[COMMAND_ARG_SIZE + 1];
+  const char *start;
+  char *stop;
+  size_t len;
+  bool quoted;
+  for (uint8_t n = 0; (n < COMMAND_ARGS_MAX) && types[n]; n++) {
+    while ((p < end) && commandIsBlank(*p)) p++;
+    if (p >= end) return "Missing Argument, see help";
+    // token
+    quoted = (*p == '"') && (types[n] == COMMAND_ARG_STRING);
+    if (quoted) p++;
+    start = p;
+    while ((p < end) && (quoted ? (*p != '"') : !commandIsBlank(*p))) p++;
+    if (quoted && (p >= end)) return "Missing closing Quote";
+    len = p - start;
+    if (quoted) p++;
+    if (len > COMMAND_ARG_SIZE) return "Argument too long";
+    memcpy(tok, start, len);
+    tok[len] = 0;
+    // value
+    switch (types[n]) {
+      case COMMAND_ARG_UINT:
+        if ((tok[0] < '0') || (tok[0] > '9')) return "Invalid Number";
+        args[n].asUInt64 = strtoull(tok, &stop, 10);
+        if (*stop) return "Invalid Number";
+        break;
+      case COMMAND_ARG_DOUBLE:
+        args[n].asDouble = strtod(tok, &stop);
+        if (!len || *stop) return "Invalid Number";
+        break;
+      default:
+        memcpy(args[n].asString, tok, len + 1);
+        break;
+    }
+  }
+  while ((p < end) && commandIsBlank(*p)) p++;
+  if (p < end) return "Too many Arguments, see help";
+  return NULL;
+}
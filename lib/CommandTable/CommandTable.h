@@ -0,0 +1,226 @@
+// Command table with a perfect hash, commands parsed in place
+//
+// - The commands are a constexpr array of name, argument types
+//   and handler; CommandTable finds a hash seed at compile time
+//   for which every command has a slot of its own, so a lookup
+//   is one hash and one compare, and the number of commands is
+//   only limited by COMMAND_MAX
+// - Names are matched ignoring case
+// - A command line is parsed where it is (e.g. the payload of an
+//   MQTT message, not terminated) into a CommandCall: command
+//   index and arguments, strings copied, so the call can be
+//   queued and executed later by another task
+// - Handlers write their response into a CommandReply over a
+//   buffer given by the caller, no heap allocation at all
+// - Only depends on <stdint.h>, so host side tools can use it as well
+
+#ifndef COMMANDTABLE_h
+#define COMMANDTABLE_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define COMMAND_MAX             255 // most commands in a table
+#define COMMAND_ARGS_MAX          2 // most arguments of a command
+#define COMMAND_ARG_SIZE         16 // longest string argument [characters]
+#define COMMAND_SEED_TRIES    10000 // hash seeds tried at compile time
+#define COMMAND_SLOT_FREE      0xff
+
+// Argument types (Command.args, one character per argument)
+#define COMMAND_ARG_UINT        'u' // unsigned integer, e.g. 42
+#define COMMAND_ARG_DOUBLE      'd' // number, e.g. 0.1
+#define COMMAND_ARG_STRING      's' // word or "quoted text"
+
+// Argument value
+typedef union {
+  uint64_t asUInt64;
+  double   asDouble;
+  char     asString[COMMAND_ARG_SIZE + 1];  // terminated
+} CommandArg;
+
+/************************************************************
+ * Response of a command, written into a buffer given by the
+ * caller
+ * - if the buffer is too small, the response is truncated
+ ************************************************************/
+class CommandReply {
+  public:
+    CommandReply(char *buf, size_t size);
+
+    void        reset(void);                                                // start a new response
+    void        add(const char *text);                                     // "text"
+    void        add(const char *text, size_t len);                         // len characters of text
+    void        addUInt(uint64_t value);                                   // 42
+    const char *c_str(void) const { return _buf; }                         // response, always terminated
+    size_t      length(void) const { return _len; }                        // length of response
+
+  protected:
+    char    *_buf;                        // output buffer
+    size_t   _size;                       // size of output buffer
+    size_t   _len;                        // characters written
+};
+
+typedef void (*CommandHandler)(const CommandArg *args, CommandReply &reply);
+
+// Command
+typedef struct {
+  const char     *name;                   // e.g. "period"
+  const char     *args;                   // argument types, e.g. "u", "sd", ""
+  CommandHandler  handler;
+} Command;
+
+// Parsed command line, see CommandTable::parse()
+typedef struct {
+  uint8_t    command;                     // index in the command table
+  CommandArg args[COMMAND_ARGS_MAX];
+} CommandCall;
+
+/************************************************************
+ * Hash of a command name (FNV-1a, lower case)
+ * @param[in] name name, need not be terminated
+ * @param[in] len  length of name
+ * @param[in] seed start value, chosen by CommandTable
+ ************************************************************/
+constexpr uint32_t commandHash(const char *name, size_t len, uint32_t seed) {
+  uint32_t h = seed;
+  for (size_t i = 0; i < len; i++) {
+    char c = name[i];
+    h ^= (uint8_t)(((c >= 'A') && (c <= 'Z')) ? (c | 0x20) : c);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/************************************************************
+ * Length of a terminated string, at compile time
+ ************************************************************/
+constexpr size_t commandLength(const char *s) {
+  size_t len = 0;
+  while (s[len]) len++;
+  return len;
+}
+
+/************************************************************
+ * Separator of names and arguments
+ ************************************************************/
+constexpr bool commandIsBlank(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+/************************************************************
+ * Number of slots for n commands: power of 2, at least 2 * n,
+ * so a seed without collisions is found after a few tries
+ ************************************************************/
+constexpr size_t commandSlots(size_t n) {
+  size_t slots = 1;
+  while (slots < 2 * n) slots <<= 1;
+  return slots;
+}
+
+// Parse arguments of a command (see CommandTable.cpp)
+const char *commandParseArgs(const char *types, const char *p, const char *end, CommandArg *args);
+bool commandNameEquals(const char *name, const char *p, size_t len);
+
+template <size_t N>
+class CommandTable {
+  public:
+    static constexpr size_t SLOTS = commandSlots(N);
+
+    constexpr CommandTable(const Command (&commands)[N]);
+
+    constexpr bool valid(void) const { return _valid; }                    // perfect hash found, check by static_assert
+    constexpr size_t size(void) const { return N; }                        // number of commands
+    const Command &operator[](size_t i) const { return _commands[i]; }
+    int         find(const char *name, size_t len) const;                  // index of command, -1 if unknown
+    const char *parse(const char *line, size_t len, CommandCall &call) const; // parse line, return error or NULL
+    void        execute(const CommandCall &call, CommandReply &reply) const; // call handler
+
+  protected:
+    const Command *_commands;
+    uint32_t       _seed = 0;
+    bool           _valid = false;
+    uint8_t        _slot[SLOTS] = {};     // index of the command, COMMAND_SLOT_FREE
+
+    constexpr bool place(uint32_t seed);
+};
+
+
+/************************************************************
+ * Build table at compile time
+ * - seeds are tried until every command has a slot of its own
+ * - duplicate names never get one: valid() is false
+ ************************************************************/
+template <size_t N>
+constexpr CommandTable<N>::CommandTable(const Command (&commands)[N]) : _commands(commands) {
+  static_assert((N > 0) && (N <= COMMAND_MAX), "number of commands out of range");
+  for (uint32_t i = 0; !_valid && (i < COMMAND_SEED_TRIES); i++) {
+    _seed = 2166136261u + i;
+    _valid = place(_seed);
+  }
+}
+
+
+/************************************************************
+ * Place all commands with the given seed
+ * @return false on a collision
+ ************************************************************/
+template <size_t N>
+constexpr bool CommandTable<N>::place(uint32_t seed) {
+  size_t s = 0;
+  for (s = 0; s < SLOTS; s++) _slot[s] = COMMAND_SLOT_FREE;
+  for (size_t i = 0; i < N; i++) {
+    s = commandHash(_commands[i].name, commandLength(_commands[i].name), seed) & (SLOTS - 1);
+    if (_slot[s] != COMMAND_SLOT_FREE) return false;
+    _slot[s] = (uint8_t)i;
+  }
+  return true;
+}
+
+
+/************************************************************
+ * Look up command
+ * @param[in] name name, need not be terminated
+ * @param[in] len  length of name
+ * @return    index of the command, -1 if unknown
+ ************************************************************/
+template <size_t N>
+int CommandTable<N>::find(const char *name, size_t len) const {
+  uint8_t i = _slot[commandHash(name, len, _seed) & (SLOTS - 1)];
+  if ((i == COMMAND_SLOT_FREE) || !commandNameEquals(_commands[i].name, name, len)) return -1;
+  return i;
+}
+
+
+/************************************************************
+ * Parse command line
+ * - "name arg arg", separated by blanks
+ * @param[in]  line command line, need not be terminated
+ * @param[in]  len  length of line
+ * @param[out] call command and arguments
+ * @return     NULL, or the error, e.g. "Unknown Command"
+ ************************************************************/
+template <size_t N>
+const char *CommandTable<N>::parse(const char *line, size_t len, CommandCall &call) const {
+  const char *end = line + len;
+  const char *name;
+  int i;
+  while ((line < end) && commandIsBlank(*line)) line++;
+  name = line;
+  while ((line < end) && !commandIsBlank(*line)) line++;
+  i = find(name, line - name);
+  if (i < 0) return "Unknown Command, see help";
+  call.command = (uint8_t)i;
+  return commandParseArgs(_commands[i].args, line, end, call.args);
+}
+
+
+/************************************************************
+ * Execute parsed command
+ ************************************************************/
+template <size_t N>
+void CommandTable<N>::execute(const CommandCall &call, CommandReply &reply) const {
+  reply.reset();
+  if (call.command < N) _commands[call.command].handler(call.args, reply);
+}
+
+#endif  // COMMANDTABLE_h
@@ -0,0 +1,11 @@
+// Bit reversal for the packets of a Davis Instrument wireless 
+// Integrated Sensor Suite (ISS)
+
+#include <DavisBitReverse.h>
+
+// Reversal table, generated by the compiler and placed in DRAM, 
+// so it can be used while flash cache is disabled
+DRAM_ATTR const DavisBitReverseTable DavisBitReverse::TABLE = davisBitReverseMakeTable();
+
+static_assert(davisBitReverseMakeTable().t[0x01] == 0x80, "bit reversal table broken");
+static_assert(davisBitReverseMakeTable().t[0xB2] == 0x4D, "bit reversal table broken");
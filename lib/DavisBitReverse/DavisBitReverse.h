@@ -0,0 +1,97 @@
+// Bit reversal for the packets of a Davis Instrument wireless 
+// Integrated Sensor Suite (ISS)
+//
+// - The data bytes come over the air from the ISS least significant 
+//   bit first, the RFM69 shifts them in most significant bit first
+// - Single bytes are reversed with a 256 byte table generated at 
+//   compile time (constexpr)
+// - Buffers are reversed 4 bytes at a time with word wide operations
+// - Only depends on <stdint.h>, so host side tools can use it as well
+
+#ifndef DAVISBITREVERSE_h
+#define DAVISBITREVERSE_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(ESP32)
+#include <esp_attr.h>
+#endif
+#ifndef DRAM_ATTR
+#define DRAM_ATTR
+#endif
+
+struct DavisBitReverseTable {
+  uint8_t t[256];
+};
+
+/************************************************************
+ * Generate reversal table at compile time
+ ************************************************************/
+constexpr DavisBitReverseTable davisBitReverseMakeTable(void) {
+  DavisBitReverseTable tab{};
+  for (int i = 0; i < 256; i++) {
+    uint8_t b = (uint8_t)i;
+    b = (uint8_t)(((b & 0b11110000) >> 4) | ((b & 0b00001111) << 4));
+    b = (uint8_t)(((b & 0b11001100) >> 2) | ((b & 0b00110011) << 2));
+    b = (uint8_t)(((b & 0b10101010) >> 1) | ((b & 0b01010101) << 1));
+    tab.t[i] = b;
+  }
+  return tab;
+}
+
+class DavisBitReverse {
+  public:
+    static const DavisBitReverseTable TABLE;                                // reversal table (DRAM, usable from ISR)
+
+    static uint8_t  reverse(uint8_t b) { return TABLE.t[b]; }              // reverse one byte
+    static uint32_t reverseWord(uint32_t w);                               // reverse each of the 4 bytes of a word
+    static void     reverseBuffer(uint8_t *buf, size_t len);                // reverse each byte of buffer, in place
+    static void     reverseCopy(uint8_t *dst, const uint8_t *src, size_t len); // reverse each byte of src into dst
+};
+
+/************************************************************
+ * Reverse bits of each byte in a 32 bit word
+ * - byte order is kept, only bits within each byte are swapped
+ ************************************************************/
+inline uint32_t DavisBitReverse::reverseWord(uint32_t w) {
+  w = ((w & 0xF0F0F0F0u) >> 4) | ((w & 0x0F0F0F0Fu) << 4);
+  w = ((w & 0xCCCCCCCCu) >> 2) | ((w & 0x33333333u) << 2);
+  w = ((w & 0xAAAAAAAAu) >> 1) | ((w & 0x55555555u) << 1);
+  return w;
+}
+
+/************************************************************
+ * Reverse bits of each byte of src into dst
+ * - 4 bytes per step, remaining bytes by table
+ * - src and dst may be the same buffer
+ * @param[out] dst destination buffer
+ * @param[in]  src source buffer
+ * @param[in]  len number of bytes
+ ************************************************************/
+inline void DavisBitReverse::reverseCopy(uint8_t *dst, const uint8_t *src, size_t len) {
+  uint32_t w;
+  while (len >= 4) {
+    memcpy(&w, src, 4);
+    w = reverseWord(w);
+    memcpy(dst, &w, 4);
+    src += 4;
+    dst += 4;
+    len -= 4;
+  }
+  while (len--) {
+    *dst++ = TABLE.t[*src++];
+  }
+}
+
+/************************************************************
+ * Reverse bits of each byte of buffer in place
+ * @param[in,out] buf buffer 
+ * @param[in]     len number of bytes
+ ************************************************************/
+inline void DavisBitReverse::reverseBuffer(uint8_t *buf, size_t len) {
+  reverseCopy(buf, buf, len);
+}
+
+#endif  // DAVISBITREVERSE_h
@@ -0,0 +1,162 @@
+// CRC16-CCITT engine for the packets of a Davis Instrument wireless 
+// Integrated Sensor Suite (ISS)
+
+#include <DavisCRC.h>
+
+// Lookup tables, generated by the compiler and placed in DRAM, 
+// so they can be used while flash cache is disabled
+DRAM_ATTR const DavisCrcTable DavisCRC::TABLE = davisCrcMakeTable();
+
+// Single bit syndromes sorted for binary search
+DRAM_ATTR const DavisSyndromeTable DavisCRC::SYNDROMES = davisCrcMakeSyndromes();
+
+// A single bit error must be identified unambiguously: 
+// all syndromes different and not 0 (checked at compile time)
+constexpr bool davisSyndromesUnique(const DavisSyndromeTable &tab) {
+  for (int i = 0; i < DAVIS_CRC_PACKET_BITS; i++) {
+    if (tab.s[i].syndrome == 0) return false;
+    if ((i > 0) && (tab.s[i - 1].syndrome == tab.s[i].syndrome)) return false;
+  }
+  return true;
+}
+static_assert(davisSyndromesUnique(davisCrcMakeSyndromes()), "single bit syndromes are not unique");
+
+// Self test: packet "80:02:E1:1E:1B:05:B5:B3" received from an ISS
+static constexpr uint8_t CRC_TEST_PACKET[DAVIS_CRC_PACKET_LEN] = { 0x80, 0x02, 0xE1, 0x1E, 0x1B, 0x05, 0xB5, 0xB3 };
+static_assert(DavisCRC::crc16Const(CRC_TEST_PACKET, DAVIS_CRC_DATA_LEN) == 0xB5B3, "CRC table does not match Davis CRC");
+
+
+/************************************************************
+ * Davis CRC calculation, bit by bit
+ * - from http://www.menie.org/georges/embedded/
+ * - changed to not support othe start value as 0
+ * @param[in] buf pointer to buffer 
+ * @param[in] len legth of buffer 
+ ************************************************************/
+uint16_t DavisCRC::crc16Bitwise(const uint8_t *buf, size_t len) {
+  uint16_t crc = 0;
+  while (len--) {
+    crc ^= (uint16_t)(*buf++ << 8);
+    for (int i = 0; i < 8; ++i) {
+      if (crc & 0x8000)
+        crc = (uint16_t)((crc << 1) ^ DAVIS_CRC_POLY);
+      else
+        crc = (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+
+/************************************************************
+ * CRC slice-by-4
+ * - processes 4 bytes with 4 independent table lookups
+ * - remaining bytes are processed with the byte table
+ * @param[in] buf pointer to buffer 
+ * @param[in] len legth of buffer 
+ ************************************************************/
+uint16_t DavisCRC::crc16Slice4(const uint8_t *buf, size_t len) {
+  uint16_t crc = 0;
+  while (len >= 4) {
+    crc = TABLE.t[3][(buf[0] ^ (crc >> 8)) & 0xff]
+        ^ TABLE.t[2][(buf[1] ^ crc) & 0xff]
+        ^ TABLE.t[1][buf[2]]
+        ^ TABLE.t[0][buf[3]];
+    buf += 4;
+    len -= 4;
+  }
+  while (len--) {
+    crc = (uint16_t)(crc << 8) ^ TABLE.t[0][((crc >> 8) ^ *buf++) & 0xff];
+  }
+  return crc;
+}
+
+
+/************************************************************
+ * Verify CRC of many packets (e.g. replay of captured data)
+ * - packets are stored consecutively, 8 bytes each
+ * - uses slice-by-4 regardless of DAVIS_CRC_ENGINE
+ * @param[in]  packets pointer to first packet
+ * @param[in]  count   number of packets
+ * @param[out] ok      result per packet (may be NULL)
+ * @return     number of packets with correct CRC
+ ************************************************************/
+size_t DavisCRC::checkBatch(const uint8_t *packets, size_t count, bool *ok) {
+  size_t good = 0;
+  for (size_t n = 0; n < count; n++, packets += DAVIS_CRC_PACKET_LEN) {
+    uint16_t crc = crc16Slice4(packets, DAVIS_CRC_DATA_LEN);
+    bool res = (crc == (uint16_t)((packets[6] << 8) | packets[7])) && (crc != 0);
+    if (ok) ok[n] = res;
+    if (res) good++;
+  }
+  return good;
+}
+
+
+/************************************************************
+ * Find position of single bit error
+ * @param[in] syndrome CRC(data) XOR received CRC
+ * @return    bit position (0 - 63), -1 if no single bit error
+ ************************************************************/
+static int findSyndrome(uint16_t syndrome) {
+  int lo = 0;
+  int hi = DAVIS_CRC_PACKET_BITS - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    uint16_t s = DavisCRC::SYNDROMES.s[mid].syndrome;
+    if (s == syndrome) return DavisCRC::SYNDROMES.s[mid].pos;
+    if (s < syndrome) lo = mid + 1; else hi = mid - 1;
+  }
+  return -1;
+}
+
+
+/************************************************************
+ * Correct Bit Errors
+ * - syndrome = CRC over data XOR received CRC
+ * - single bit error: syndrome found in table (unique, 
+ *   no two bit error has the same syndrome)
+ * - two bit errors (maxBits 2): for every first bit the 
+ *   remaining syndrome must be a single bit syndrome, the 
+ *   correction is only done if exactly one pair matches
+ * - the repaired packet must pass check() (CRC not 0)
+ * @param[in,out] packet  8 bytes, changed only if repaired
+ * @param[in]     maxBits 1: single bit, 2: up to two bits
+ * @return        number of bits flipped (0: CRC was correct), 
+ *                -1: not correctable
+ ************************************************************/
+int DavisCRC::correct(uint8_t *packet, int maxBits) {
+  uint16_t syndrome = crc16(packet, DAVIS_CRC_DATA_LEN) ^ (uint16_t)((packet[6] << 8) | packet[7]);
+  int posA = -1;
+  int posB = -1;
+  int bits = 0;
+  if (syndrome == 0) {
+    return check(packet) ? 0 : -1;
+  }
+  if (maxBits >= 1) {
+    posA = findSyndrome(syndrome);
+    if (posA >= 0) bits = 1;
+  }
+  if ((bits == 0) && (maxBits >= 2)) {
+    int found = 0;
+    for (int i = 0; i < DAVIS_CRC_PACKET_BITS; i++) {
+      int j = findSyndrome(syndrome ^ SYNDROMES.s[i].syndrome);
+      if (j > SYNDROMES.s[i].pos) {                                         // each pair once
+        posA = SYNDROMES.s[i].pos;
+        posB = j;
+        found++;
+      }
+    }
+    if (found != 1) return -1;                                              // none or ambiguous
+    bits = 2;
+  }
+  if (bits == 0) return -1;
+  packet[posA / 8] ^= (uint8_t)(0x80 >> (posA % 8));
+  if (posB >= 0) packet[posB / 8] ^= (uint8_t)(0x80 >> (posB % 8));
+  if (!check(packet)) {
+    packet[posA / 8] ^= (uint8_t)(0x80 >> (posA % 8));                    // undo
+    if (posB >= 0) packet[posB / 8] ^= (uint8_t)(0x80 >> (posB % 8));
+    return -1;
+  }
+  return bits;
+}
@@ -0,0 +1,173 @@
+// CRC16-CCITT engine for the packets of a Davis Instrument wireless 
+// Integrated Sensor Suite (ISS)
+//
+// - Polynomial 0x1021, start value 0, no final XOR, MSB first
+// - Computed over the first 6 bytes of a packet and compared 
+//   with bytes 6 (MSB) and 7 (LSB)
+// - Lookup tables are generated at compile time (constexpr)
+// - Bit errors can be corrected by syndrome lookup (see correct())
+// - Only depends on <stdint.h>, so host side tools can use it as well
+
+#ifndef DAVISCRC_h
+#define DAVISCRC_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(ESP32)
+#include <esp_attr.h>
+#endif
+#ifndef DRAM_ATTR
+#define DRAM_ATTR
+#endif
+
+// CRC engines, select ONE by defining DAVIS_CRC_ENGINE (e.g. in build_flags)
+#define DAVIS_CRC_BITWISE        0 // 8 iterations per byte, no table
+#define DAVIS_CRC_TABLE          1 // 1 lookup per byte, 256 entry table (512 Bytes)
+#define DAVIS_CRC_SLICE4         2 // 4 lookups per 4 bytes, 4 x 256 entry table (2 kBytes)
+#ifndef DAVIS_CRC_ENGINE
+#define DAVIS_CRC_ENGINE DAVIS_CRC_TABLE
+#endif
+
+// Bit error correction: 0: off, 1: single bit errors, 
+// 2: also two bit errors (NOT safe: Hamming distance of CRC16-CCITT over 64 bits is 4,
+//    so three bit errors may be "corrected" into a wrong packet, two bit patterns are ambiguous)
+#ifndef DAVIS_CRC_CORRECT_BITS
+#define DAVIS_CRC_CORRECT_BITS   1
+#endif
+
+#define DAVIS_CRC_POLY      0x1021 // CRC16-CCITT polynomial
+#define DAVIS_CRC_DATA_LEN       6 // number of bytes covered by the CRC
+#define DAVIS_CRC_PACKET_LEN     8 // packet length including CRC
+#define DAVIS_CRC_PACKET_BITS   64 // bit positions covered by the syndrome table
+
+// Lookup tables: t[0] is the classic byte table, t[k][i] is the CRC 
+// of byte i followed by k zero bytes (used by slice-by-4)
+struct DavisCrcTable {
+  uint16_t t[4][256];
+};
+
+/************************************************************
+ * Generate lookup tables at compile time
+ ************************************************************/
+constexpr DavisCrcTable davisCrcMakeTable(void) {
+  DavisCrcTable tab{};
+  for (int i = 0; i < 256; i++) {
+    uint16_t crc = (uint16_t)(i << 8);
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ DAVIS_CRC_POLY) : (uint16_t)(crc << 1);
+    }
+    tab.t[0][i] = crc;
+  }
+  for (int k = 1; k < 4; k++) {
+    for (int i = 0; i < 256; i++) {
+      uint16_t prev = tab.t[k - 1][i];
+      tab.t[k][i] = (uint16_t)((prev << 8) ^ tab.t[0][prev >> 8]);
+    }
+  }
+  return tab;
+}
+
+// Syndrome of a single bit error: CRC(data) XOR received CRC,
+// bit position: byte * 8 + bit (7: MSB), bytes 6 and 7 are the CRC itself
+struct DavisSyndrome {
+  uint16_t syndrome;
+  uint8_t  pos;
+};
+
+struct DavisSyndromeTable {
+  DavisSyndrome s[DAVIS_CRC_PACKET_BITS];                                   // sorted by syndrome
+};
+
+/************************************************************
+ * Generate syndrome table at compile time
+ * - the CRC is linear (start value 0, no final XOR), so the 
+ *   syndrome of a bit error does not depend on the data
+ ************************************************************/
+constexpr DavisSyndromeTable davisCrcMakeSyndromes(void) {
+  DavisSyndromeTable tab{};
+  DavisCrcTable crcTab = davisCrcMakeTable();
+  for (int pos = 0; pos < DAVIS_CRC_PACKET_BITS; pos++) {
+    int byteIdx = pos / 8;
+    uint8_t mask = (uint8_t)(0x80 >> (pos % 8));
+    uint16_t syn = 0;
+    if (byteIdx < DAVIS_CRC_DATA_LEN) {
+      for (int i = 0; i < DAVIS_CRC_DATA_LEN; i++) {
+        uint8_t b = (i == byteIdx) ? mask : 0;
+        syn = (uint16_t)(syn << 8) ^ crcTab.t[0][((syn >> 8) ^ b) & 0xff];
+      }
+    } else {
+      syn = (byteIdx == DAVIS_CRC_DATA_LEN) ? (uint16_t)(mask << 8) : mask;
+    }
+    // insertion sort
+    int j = pos;
+    while ((j > 0) && (tab.s[j - 1].syndrome > syn)) {
+      tab.s[j] = tab.s[j - 1];
+      j--;
+    }
+    tab.s[j].syndrome = syn;
+    tab.s[j].pos = (uint8_t)pos;
+  }
+  return tab;
+}
+
+class DavisCRC {
+  public:
+    static const DavisCrcTable TABLE;                                      // lookup tables (DRAM, usable from ISR)
+
+    static uint16_t crc16(const uint8_t *buf, size_t len);                  // CRC using engine DAVIS_CRC_ENGINE
+    static uint16_t crc16Bitwise(const uint8_t *buf, size_t len);           // reference implementation
+    static uint16_t crc16Table(const uint8_t *buf, size_t len);             // 1 table lookup per byte
+    static uint16_t crc16Slice4(const uint8_t *buf, size_t len);            // 4 bytes per step
+    static bool     check(const uint8_t *packet);                           // verify CRC of one 8 byte packet
+    static size_t   checkBatch(const uint8_t *packets, size_t count, bool *ok); // verify many consecutive 8 byte packets
+    static int      correct(uint8_t *packet, int maxBits = DAVIS_CRC_CORRECT_BITS); // repair bit errors, return bits flipped, -1: failed
+
+    static const DavisSyndromeTable SYNDROMES;                             // single bit syndromes (DRAM, usable from ISR)
+
+    // compile time CRC (for constants and self tests)
+    static constexpr uint16_t crc16Const(const uint8_t *buf, size_t len) {
+      uint16_t crc = 0;
+      for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)(crc << 8) ^ davisCrcMakeTable().t[0][((crc >> 8) ^ buf[i]) & 0xff];
+      }
+      return crc;
+    }
+};
+
+/************************************************************
+ * CRC using the engine selected by DAVIS_CRC_ENGINE
+ ************************************************************/
+inline uint16_t DavisCRC::crc16(const uint8_t *buf, size_t len) {
+#if DAVIS_CRC_ENGINE == DAVIS_CRC_BITWISE
+  return crc16Bitwise(buf, len);
+#elif DAVIS_CRC_ENGINE == DAVIS_CRC_SLICE4
+  return crc16Slice4(buf, len);
+#else
+  return crc16Table(buf, len);
+#endif
+}
+
+/************************************************************
+ * CRC using one table lookup per byte
+ ************************************************************/
+inline uint16_t DavisCRC::crc16Table(const uint8_t *buf, size_t len) {
+  uint16_t crc = 0;
+  while (len--) {
+    crc = (uint16_t)(crc << 8) ^ TABLE.t[0][((crc >> 8) ^ *buf++) & 0xff];
+  }
+  return crc;
+}
+
+/************************************************************
+ * Verify CRC of one packet
+ * - a CRC of 0 is rejected (empty packets)
+ * @param[in] packet 8 bytes: 6 data bytes, CRC MSB, CRC LSB
+ * @return    true if CRC is correct
+ ************************************************************/
+inline bool DavisCRC::check(const uint8_t *packet) {
+  uint16_t crc = crc16(packet, DAVIS_CRC_DATA_LEN);
+  return (crc == (uint16_t)((packet[6] << 8) | packet[7])) && (crc != 0);
+}
+
+#endif  // DAVISCRC_h
@@ -0,0 +1,195 @@
+// Decoder for the packets of a Davis Instrument wireless
+// Integrated Sensor Suite (ISS)
+
+#include <DavisDecoder.h>
+
+// Lookup tables, generated by the compiler and placed in DRAM
+DRAM_ATTR const DavisDecoderTables DavisDecoder::TABLES = davisDecoderMakeTables();
+
+static_assert(davisDecoderMakeTables().windSpeed[10] == 1609, "wind speed table broken");
+static_assert(davisDecoderMakeTables().windSpeed[250] == 40233, "wind speed table broken");
+static_assert(davisDecoderMakeTables().windDirection[0] == 180, "wind direction table broken");
+static_assert(davisDecoderMakeTables().windDirection[128] == 0, "wind direction table broken");
+static_assert(davisDecoderMakeTables().windDirection[255] == 180, "wind direction table broken");
+
+// Names of the fields, index: DAVIS_FIELD_xx
+static const char * const FIELD_NAMES[] = {
+  NULL, "GoldcapVoltage", "Rainrate", "SolarRadiation", "OutsideTemperature",
+  "GustSpeed", "OutsideHumidity", "RainClicks"
+};
+
+
+/************************************************************
+ * Decode many packets (e.g. replay of captured data)
+ * - packets are stored consecutively, 8 bytes each
+ * - CRC is not checked, see DavisCRC::checkBatch()
+ * @param[in]  packets pointer to first packet
+ * @param[in]  count   number of packets
+ * @param[out] m       measurement record per packet
+ * @return     number of packets with a known field
+ ************************************************************/
+size_t DavisDecoder::decodeBatch(const uint8_t *packets, size_t count, DavisMeasurement *m) {
+  size_t known = 0;
+  for (size_t n = 0; n < count; n++, packets += 8) {
+    decode(packets, m[n]);
+    if (m[n].field != DAVIS_FIELD_NONE) known++;
+  }
+  return known;
+}
+
+
+/************************************************************
+ * Format fixed point value with 2 decimals
+ * - same text as String(float) / dtostrf(value, 4, 2) of
+ *   value / 100, e.g. "-0.56", "21.00"
+ * - DAVIS_RAINRATE_INF is printed as "inf"
+ * @param[in]  value value [0.01]
+ * @param[out] buf   at least DAVIS_CENTI_STR_LEN bytes
+ * @return     length of text
+ ************************************************************/
+size_t DavisDecoder::formatCenti(int32_t value, char *buf) {
+  char tmp[DAVIS_CENTI_STR_LEN];
+  size_t len = 0;
+  size_t n = 0;
+  uint32_t v;
+  if (value == DAVIS_RAINRATE_INF) {
+    buf[0] = 'i';
+    buf[1] = 'n';
+    buf[2] = 'f';
+    buf[3] = 0;
+    return 3;
+  }
+  if (value < 0) {
+    buf[len++] = '-';
+    v = (uint32_t)0 - (uint32_t)value;
+  } else {
+    v = (uint32_t)value;
+  }
+  // digits in reverse order, at least "0.00"
+  tmp[n++] = (char)('0' + v % 10);
+  v /= 10;
+  tmp[n++] = (char)('0' + v % 10);
+  v /= 10;
+  tmp[n++] = '.';
+  do {
+    tmp[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  while (n) {
+    buf[len++] = tmp[--n];
+  }
+  buf[len] = 0;
+  return len;
+}
+
+
+/************************************************************
+ * Name of a field
+ * @param[in] field DAVIS_FIELD_xx
+ * @return    name used in the published JSON, NULL if none
+ ************************************************************/
+const char *DavisDecoder::fieldName(uint8_t field) {
+  if (field >= sizeof(FIELD_NAMES) / sizeof(FIELD_NAMES[0])) return NULL;
+  return FIELD_NAMES[field];
+}
+
+
+/************************************************************
+ * Message ID without known value (e.g. 3: unknown)
+ ************************************************************/
+void DavisDecoder::decodeNone(const uint8_t *data, DavisMeasurement &m) {
+  (void)data;
+  m.field = DAVIS_FIELD_NONE;
+  m.value = 0;
+}
+
+
+/************************************************************
+ * Goldcap charge status (MSG-ID 2)
+ * - 10 bit value [0.01 V]
+ ************************************************************/
+void DavisDecoder::decodeGoldcap(const uint8_t *data, DavisMeasurement &m) {
+  m.field = DAVIS_FIELD_GOLDCAP;
+  m.value = (data[3] << 2) + ((data[4] & 0xC0) >> 6);
+}
+
+
+/************************************************************
+ * Rain rate (MSG-ID 5)
+ * - ISS transmits the time between the last two clicks
+ * - byte 3 = 255: no rain
+ * - HIGH rain rate: Clicks per hour = 3600 / (VALUE/16)
+ * - LOW rain rate:  Clicks per hour = 3600 / VALUE
+ * - Rainrate [mm/h] = [Clicks/hour] * [Cupsize 0.2 mm]
+ * - [0.01 mm/h], rounded to nearest, ties down (like the 
+ *   float value printed with 2 decimals)
+ ************************************************************/
+void DavisDecoder::decodeRainRate(const uint8_t *data, DavisMeasurement &m) {
+  uint32_t rawrr;
+  uint32_t centi;
+  m.field = DAVIS_FIELD_RAINRATE;
+  if (data[3] == 255) {
+    m.value = 0;
+    return;
+  }
+  rawrr = data[3] + ((data[4] & 0x30) * 16);
+  if (rawrr == 0) {
+    m.value = DAVIS_RAINRATE_INF;
+    return;
+  }
+  // 57600 * 0.2 * 100 (HIGH), 3600 * 0.2 * 100 (LOW)
+  centi = ((data[4] & 0x40) == 0) ? 1152000u : 72000u;
+  m.value = (int32_t)((2 * centi + rawrr - 1) / (2 * rawrr));
+}
+
+
+/************************************************************
+ * Solar radiation (MSG-ID 7)
+ * - 10 bit value, scaled to [0.01]
+ ************************************************************/
+void DavisDecoder::decodeSolar(const uint8_t *data, DavisMeasurement &m) {
+  m.field = DAVIS_FIELD_SOLAR;
+  m.value = ((data[3] * 4) + ((data[4] & 0xC0) >> 6)) * 100;
+}
+
+
+/************************************************************
+ * Outside temperature (MSG-ID 8)
+ * - 16 bit value [0.1 °F], truncated to whole °F
+ * - [0.01 °C], rounded half away from zero
+ ************************************************************/
+void DavisDecoder::decodeTemperature(const uint8_t *data, DavisMeasurement &m) {
+  int32_t fahrenheit = ((data[3] * 256 + data[4]) / 160) - 32;
+  m.field = DAVIS_FIELD_TEMPERATURE;
+  m.value = (fahrenheit * 500 + ((fahrenheit < 0) ? -4 : 4)) / 9;
+}
+
+
+/************************************************************
+ * Gust speed (MSG-ID 9), maximum wind speed in last 10 minutes
+ * - [0.01 km/h], same table as wind speed
+ ************************************************************/
+void DavisDecoder::decodeGust(const uint8_t *data, DavisMeasurement &m) {
+  m.field = DAVIS_FIELD_GUST;
+  m.value = TABLES.windSpeed[data[3]];
+}
+
+
+/************************************************************
+ * Outside humidity (MSG-ID A)
+ * - 12 bit value [0.1 %rel], scaled to [0.01 %rel]
+ ************************************************************/
+void DavisDecoder::decodeHumidity(const uint8_t *data, DavisMeasurement &m) {
+  m.field = DAVIS_FIELD_HUMIDITY;
+  m.value = (((data[4] >> 4) << 8) | data[3]) * 10;
+}
+
+
+/************************************************************
+ * Rain counter (MSG-ID E)
+ * - 7 bit counter [clicks], wraps from 127 to 0
+ ************************************************************/
+void DavisDecoder::decodeRainClicks(const uint8_t *data, DavisMeasurement &m) {
+  m.field = DAVIS_FIELD_RAINCLICKS;
+  m.value = data[3] & 0x7F;
+}
@@ -0,0 +1,148 @@
+// Decoder for the packets of a Davis Instrument wireless
+// Integrated Sensor Suite (ISS)
+//
+// - Byte 0: message ID (high nibble), battery low (bit 3), transmitter ID (bits 0-2)
+// - Byte 1: wind speed, byte 2: wind direction (all packets)
+// - Bytes 3 and 4: value selected by the message ID
+// - Values are fixed point integers (no float), wind speed and
+//   direction are mapped by tables generated at compile time (constexpr)
+// - Message IDs are dispatched by a table of field decoders
+// - Printed with 2 decimals (formatCenti()), the values are the same
+//   as the float values printed by String(float) before
+// - Only depends on <stdint.h>, so host side tools can use it as well
+
+#ifndef DAVISDECODER_h
+#define DAVISDECODER_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(ESP32)
+#include <esp_attr.h>
+#endif
+#ifndef DRAM_ATTR
+#define DRAM_ATTR
+#endif
+
+// Message IDs (high nibble of byte 0)
+#define DAVIS_MSG_GOLDCAP       0x2 // goldcap charge status
+#define DAVIS_MSG_UNKNOWN3      0x3 // unknown, not used
+#define DAVIS_MSG_RAINRATE      0x5 // rain rate
+#define DAVIS_MSG_SOLAR         0x7 // solar radiation
+#define DAVIS_MSG_TEMPERATURE   0x8 // outside temperature
+#define DAVIS_MSG_GUST          0x9 // gust speed
+#define DAVIS_MSG_HUMIDITY      0xa // outside humidity
+#define DAVIS_MSG_RAINCLICKS    0xe // rain counter
+#define DAVIS_MSG_NUM            16 // size of dispatch table
+
+// Field decoded from bytes 3 and 4 (DavisMeasurement.field)
+#define DAVIS_FIELD_NONE          0 // message ID without known value
+#define DAVIS_FIELD_GOLDCAP       1
+#define DAVIS_FIELD_RAINRATE      2
+#define DAVIS_FIELD_SOLAR         3
+#define DAVIS_FIELD_TEMPERATURE   4
+#define DAVIS_FIELD_GUST          5
+#define DAVIS_FIELD_HUMIDITY      6
+#define DAVIS_FIELD_RAINCLICKS    7
+
+#define DAVIS_RAINRATE_INF  INT32_MAX // rain rate of a zero click interval (printed as "inf")
+#define DAVIS_CENTI_STR_LEN      16 // buffer size for formatCenti()
+
+// Measurement record of one packet, fixed point
+typedef struct {
+  uint8_t  txId;                    // transmitter ID (0-7)
+  uint8_t  msgId;                   // message ID (0x0 - 0xf)
+  bool     batteryLow;              // battery low bit of byte 0
+  uint8_t  field;                   // value decoded from bytes 3 and 4: DAVIS_FIELD_xx
+  int32_t  windSpeed;               // wind speed [0.01 km/h]
+  uint16_t windDirection;           // wind direction [°], 180 = South
+  int32_t  value;                   // value of field, unit see below
+  // DAVIS_FIELD_GOLDCAP:     goldcap charge status [0.01 V]
+  // DAVIS_FIELD_RAINRATE:    rain rate [0.01 mm/h], 0: no rain, DAVIS_RAINRATE_INF
+  // DAVIS_FIELD_SOLAR:       solar radiation [0.01]
+  // DAVIS_FIELD_TEMPERATURE: outside temperature [0.01 °C]
+  // DAVIS_FIELD_GUST:        gust speed [0.01 km/h]
+  // DAVIS_FIELD_HUMIDITY:    outside humidity [0.01 %rel]
+  // DAVIS_FIELD_RAINCLICKS:  rain counter [clicks] 0-127, NOT scaled
+} DavisMeasurement;
+
+// Decoder of bytes 3 and 4, one per message ID
+typedef void (*DavisFieldDecoder)(const uint8_t *data, DavisMeasurement &m);
+
+// Lookup tables for the values of bytes 1 and 2
+struct DavisDecoderTables {
+  uint16_t windSpeed[256];          // [0.01 km/h]
+  uint16_t windDirection[256];      // [°], 180 = South
+};
+
+/************************************************************
+ * Wind speed [mph] to [0.01 km/h]
+ * - 1 mph = 1.60934 km/h, rounded to nearest, ties down
+ *   (like the float value printed with 2 decimals)
+ ************************************************************/
+constexpr uint16_t davisMphToCentiKmh(uint32_t mph) {
+  return (uint16_t)((mph * 160934u + 499u) / 1000u);
+}
+
+/************************************************************
+ * Generate lookup tables at compile time
+ * - Wind direction: 0 - 255 mapped to 0 - 360°, truncated,
+ *   then rotated by 180°, so 180° = South
+ * - There is a dead zone on the wind vane. No values are
+ *   reported between 8 and 352 degrees inclusive. These values
+ *   correspond to received byte values of 1 and 255 respectively
+ *   See http://www.wxforum.net/index.php?topic=21967.50
+ ************************************************************/
+constexpr DavisDecoderTables davisDecoderMakeTables(void) {
+  DavisDecoderTables tab{};
+  for (uint32_t i = 0; i < 256; i++) {
+    tab.windSpeed[i] = davisMphToCentiKmh(i);
+    uint16_t dir = (uint16_t)(i * 360u / 255u);
+    tab.windDirection[i] = (dir >= 180) ? (uint16_t)(dir - 180) : (uint16_t)(dir + 180);
+  }
+  return tab;
+}
+
+class DavisDecoder {
+  public:
+    static const DavisDecoderTables TABLES;                                 // lookup tables (DRAM)
+
+    static void   decode(const uint8_t *data, DavisMeasurement &m);         // decode one packet (CRC already checked)
+    static size_t decodeBatch(const uint8_t *packets, size_t count, DavisMeasurement *m); // decode consecutive 8 byte packets
+    static size_t formatCenti(int32_t value, char *buf);                   // "-12.34", return length
+    static const char *fieldName(uint8_t field);                           // "OutsideTemperature", NULL if none
+
+  protected:
+    static void decodeNone(const uint8_t *data, DavisMeasurement &m);
+    static void decodeGoldcap(const uint8_t *data, DavisMeasurement &m);
+    static void decodeRainRate(const uint8_t *data, DavisMeasurement &m);
+    static void decodeSolar(const uint8_t *data, DavisMeasurement &m);
+    static void decodeTemperature(const uint8_t *data, DavisMeasurement &m);
+    static void decodeGust(const uint8_t *data, DavisMeasurement &m);
+    static void decodeHumidity(const uint8_t *data, DavisMeasurement &m);
+    static void decodeRainClicks(const uint8_t *data, DavisMeasurement &m);
+    static constexpr DavisFieldDecoder DECODERS[DAVIS_MSG_NUM] = {
+      decodeNone,        decodeNone,        decodeGoldcap,     decodeNone,      // 0x0 - 0x3
+      decodeNone,        decodeRainRate,    decodeNone,        decodeSolar,     // 0x4 - 0x7
+      decodeTemperature, decodeGust,        decodeHumidity,    decodeNone,      // 0x8 - 0xb
+      decodeNone,        decodeNone,        decodeRainClicks,  decodeNone       // 0xc - 0xf
+    };
+};
+
+/************************************************************
+ * Decode one packet
+ * - bytes 0 - 2 are decoded for all packets, bytes 3 and 4
+ *   by the decoder of the message ID
+ * @param[in]  data packet, bit order already reversed
+ * @param[out] m    measurement record
+ ************************************************************/
+inline void DavisDecoder::decode(const uint8_t *data, DavisMeasurement &m) {
+  m.txId = data[0] & 0x07;
+  m.msgId = data[0] >> 4;
+  m.batteryLow = (data[0] & 0x08) != 0;
+  m.windSpeed = TABLES.windSpeed[data[1]];
+  m.windDirection = TABLES.windDirection[data[2]];
+  DECODERS[m.msgId](data, m);
+}
+
+#endif  // DAVISDECODER_h
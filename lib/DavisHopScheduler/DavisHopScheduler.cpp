@@ -0,0 +1,225 @@
+// Predictive hop scheduler for the frequency hopped signals of Davis 
+// Instrument wireless transmitters
+
+#include <DavisHopScheduler.h>
+
+/************************************************************
+ * Nominal packet interval of a transmitter
+ * @param[in] txId transmitter ID (0 - 7)
+ * @return    (41 + ID) / 16 s in [us]
+ ************************************************************/
+uint32_t DavisHopScheduler::nominalPeriodUs(uint8_t txId) {
+  return (41 + (uint32_t)(txId & 0x07)) * 62500;
+}
+
+/************************************************************
+ * Reset
+ * - forget all transmitters and learned timing
+ ************************************************************/
+void DavisHopScheduler::reset(void) {
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    DavisHopTx &t = _tx[id];
+    t.locked = false;
+    t.channel = 0;
+    t.periods = 0;
+    t.lastRxUs = 0;
+    t.periodUs = nominalPeriodUs(id);
+    t.jitterUs = DAVIS_HOP_JITTER_INIT_US;
+  }
+  resetStats();
+  _target = -1;
+}
+
+/************************************************************
+ * Reset Statistics
+ ************************************************************/
+void DavisHopScheduler::resetStats(void) {
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    _tx[id].missed = 0;
+    _tx[id].skipped = 0;
+    _tx[id].lost = 0;
+  }
+}
+
+/************************************************************
+ * Set length of channel table 
+ * - transmitters hop one table entry per packet
+ ************************************************************/
+void DavisHopScheduler::setNumChannels(uint8_t numChannels) {
+  _numChannels = (numChannels > 0) ? numChannels : 1;
+}
+
+/************************************************************
+ * Packet with correct CRC received
+ * - the time since the last packet is n periods 
+ *   (n - 1 packets not received), the deviation is used 
+ *   to refine period and jitter (moving average, 1/8)
+ * - choose transmitter to be served next
+ * @param[in] txId    transmitter ID (low three bits of byte 0)
+ * @param[in] channel channel the packet was received on
+ * @param[in] rxUs    timestamp [us] when the packet has been received
+ * @return    true: listen on channel() until deadline()
+ ************************************************************/
+bool DavisHopScheduler::packetReceived(uint8_t txId, uint8_t channel, int64_t rxUs) {
+  DavisHopTx &t = _tx[txId & 0x07];
+  if (t.locked && (rxUs - t.lastRxUs < (int64_t)(DAVIS_HOP_MAX_MISSED + 2) * t.periodUs)) {
+    uint32_t deltaUs = (uint32_t)(rxUs - t.lastRxUs);
+    uint32_t n = (deltaUs + t.periodUs / 2) / t.periodUs;
+    if ((n >= 1) && (n <= DAVIS_HOP_MAX_MISSED + 1)) {
+      int32_t err = (int32_t)(deltaUs - n * t.periodUs);
+      int32_t nominal = (int32_t)nominalPeriodUs(txId);
+      int32_t period = (int32_t)t.periodUs + err / (int32_t)n / 8;
+      if (period < nominal - DAVIS_HOP_PERIOD_TOL_US) period = nominal - DAVIS_HOP_PERIOD_TOL_US;
+      if (period > nominal + DAVIS_HOP_PERIOD_TOL_US) period = nominal + DAVIS_HOP_PERIOD_TOL_US;
+      t.periodUs = (uint32_t)period;
+      uint32_t absErr = (err < 0) ? -err : err;
+      t.jitterUs = (uint32_t)((int32_t)t.jitterUs + ((int32_t)absErr - (int32_t)t.jitterUs) / 8);
+    }
+  }
+  t.lastRxUs = rxUs;
+  t.channel = channel;
+  t.periods = 0;
+  t.locked = true;
+  return plan(rxUs);
+}
+
+/************************************************************
+ * Window of the target closed without packet
+ * @param[in] nowUs timestamp [us]
+ * @return    true: listen on channel() until deadline(),
+ *            false: all transmitters lost
+ ************************************************************/
+bool DavisHopScheduler::packetMissed(int64_t nowUs) {
+  if (_target >= 0) {
+    DavisHopTx &t = _tx[_target];
+    t.missed++;
+    if (++t.periods > DAVIS_HOP_MAX_MISSED) {
+      t.locked = false;
+      t.lost++;
+    }
+  }
+  return plan(nowUs);
+}
+
+/************************************************************
+ * Plan
+ * - windows of other transmitters which closed meanwhile
+ *   are counted as skipped
+ * - target: transmitter with the earliest expected packet
+ ************************************************************/
+bool DavisHopScheduler::plan(int64_t nowUs) {
+  int64_t best = 0;
+  _target = -1;
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    DavisHopTx &t = _tx[id];
+    while (t.locked && (nowUs >= windowEnd(t))) {
+      t.skipped++;
+      if (++t.periods > DAVIS_HOP_MAX_MISSED) {
+        t.locked = false;
+        t.lost++;
+      }
+    }
+    if (t.locked) {
+      int64_t a = arrival(t) - nowUs;               // negative: window is open
+      if ((_target < 0) || (a < best)) {
+        best = a;
+        _target = id;
+      }
+    }
+  }
+  return _target >= 0;
+}
+
+/************************************************************
+ * Wait after expected arrival
+ * - 4 times mean jitter, at least DAVIS_HOP_WINDOW_MIN_US
+ * - grows with each period without packet, as the period 
+ *   error adds up
+ * @param[in] periods periods elapsed since last packet received
+ ************************************************************/
+uint32_t DavisHopScheduler::windowUs(const DavisHopTx &t, uint32_t periods) {
+  uint32_t w = 4 * t.jitterUs;
+  if (w < DAVIS_HOP_WINDOW_MIN_US) w = DAVIS_HOP_WINDOW_MIN_US;
+  return w + periods * DAVIS_HOP_WINDOW_PER_MISS;
+}
+
+/************************************************************
+ * Expected arrival of next packet
+ ************************************************************/
+int64_t DavisHopScheduler::arrival(const DavisHopTx &t) {
+  return t.lastRxUs + ((int64_t)t.periods + 1) * t.periodUs;
+}
+
+/************************************************************
+ * End of window of next packet
+ ************************************************************/
+int64_t DavisHopScheduler::windowEnd(const DavisHopTx &t) {
+  return arrival(t) + windowUs(t, t.periods);
+}
+
+/************************************************************
+ * Time when the next hop is due
+ * @return timestamp [us] when the window of the target closes
+ ************************************************************/
+int64_t DavisHopScheduler::deadline(void) {
+  return (_target >= 0) ? windowEnd(_tx[_target]) : 0;
+}
+
+/************************************************************
+ * Channel to listen on
+ * @return expected channel of the next packet of the target
+ ************************************************************/
+uint8_t DavisHopScheduler::channel(void) {
+  if (_target < 0) return 0;
+  const DavisHopTx &t = _tx[_target];
+  return (uint8_t)((t.channel + t.periods + 1) % _numChannels);
+}
+
+/************************************************************
+ * Hop due?
+ * @param[in] nowUs timestamp [us]
+ * @return    true if the packet of the target did not arrive 
+ *            within its window
+ ************************************************************/
+bool DavisHopScheduler::hopDue(int64_t nowUs) {
+  return (_target >= 0) && (nowUs >= deadline());
+}
+
+/************************************************************
+ * Packet expected?
+ * - the transmitter is followed, the packet arrived within 
+ *   the window (either side) of one of its next packets and 
+ *   on the channel that packet is sent on
+ * - for packets not proven by their CRC (repaired packets), 
+ *   does not change the schedule
+ * @param[in] txId    transmitter ID (low three bits of byte 0)
+ * @param[in] channel channel the packet was received on
+ * @param[in] rxUs    timestamp [us] when the packet has been received
+ * @return    true if expected
+ ************************************************************/
+bool DavisHopScheduler::expected(uint8_t txId, uint8_t channel, int64_t rxUs) {
+  const DavisHopTx &t = _tx[txId & 0x07];
+  if (!t.locked || (rxUs <= t.lastRxUs)) return false;
+  int64_t deltaUs = rxUs - t.lastRxUs;
+  int64_t n = (deltaUs + t.periodUs / 2) / t.periodUs;           // packet n after the last one received
+  if ((n < 1) || (n > DAVIS_HOP_MAX_MISSED + 1)) return false;
+  int64_t errUs = deltaUs - n * t.periodUs;
+  if (errUs < 0) errUs = -errUs;
+  if (errUs > windowUs(t, (uint32_t)(n - 1))) return false;
+  return channel == (uint8_t)((t.channel + n) % _numChannels);
+}
+
+/************************************************************
+ * Getters
+ ************************************************************/
+bool DavisHopScheduler::locked(void) {
+  return _target >= 0;
+}
+
+int8_t DavisHopScheduler::target(void) {
+  return _target;
+}
+
+const DavisHopTx &DavisHopScheduler::tx(uint8_t txId) {
+  return _tx[txId & 0x07];
+}
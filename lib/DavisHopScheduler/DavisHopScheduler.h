@@ -0,0 +1,69 @@
+// Predictive hop scheduler for the frequency hopped signals of Davis 
+// Instrument wireless transmitters (ISS, anemometer transmitter, 
+// temperature/humidity stations)
+//
+// - A transmitter sends every (41 + ID) / 16 seconds, ID is the 
+//   transmitter ID (low three bits of the first payload byte)
+// - Each transmitter hops through the channel table on its own, 
+//   one channel per packet
+// - Period and arrival phase are learned per transmitter from the 
+//   timestamps of received packets (esp_timer_get_time() [us], 
+//   taken by the receive ISR at PayloadReady)
+// - One receiver serves up to 8 transmitters: it always listens on 
+//   the expected channel of the transmitter whose packet is due next 
+//   and hops on as soon as that packet arrived or its window closed
+
+#ifndef DAVISHOPSCHEDULER_h
+#define DAVISHOPSCHEDULER_h
+
+#include <stdint.h>
+
+#define DAVIS_HOP_MAX_TX              8 // transmitter IDs 0 - 7
+#define DAVIS_HOP_MAX_MISSED         25 // after this number of missed packets a transmitter is lost
+#define DAVIS_HOP_WINDOW_MIN_US   20000 // minimum time [us] to wait after expected arrival
+#define DAVIS_HOP_WINDOW_PER_MISS  2000 // additional wait [us] per missed packet (period uncertainty)
+#define DAVIS_HOP_PERIOD_TOL_US   10000 // learned period may differ this much [us] from nominal period
+#define DAVIS_HOP_JITTER_INIT_US   5000 // arrival jitter [us] assumed before learning
+
+// Hop state of one transmitter
+typedef struct {
+  bool     locked;                      // packets of this transmitter are expected
+  uint8_t  channel;                     // channel of last packet received
+  uint8_t  periods;                     // periods elapsed since last packet received
+  int64_t  lastRxUs;                    // timestamp [us] of last packet received
+  uint32_t periodUs;                    // learned packet interval [us]
+  uint32_t jitterUs;                    // mean arrival deviation [us]
+  uint32_t missed;                      // windows listened to without packet
+  uint32_t skipped;                     // windows not listened to, other transmitter served
+  uint32_t lost;                        // how often the transmitter has been lost
+} DavisHopTx;
+
+class DavisHopScheduler {
+  public:
+    DavisHopScheduler() { _numChannels = 1; reset(); }
+    void     reset(void);                                                   // forget all transmitters
+    void     resetStats(void);                                              // reset missed/skipped/lost counters
+    void     setNumChannels(uint8_t numChannels);                           // length of channel table
+    bool     packetReceived(uint8_t txId, uint8_t channel, int64_t rxUs);   // learn from packet with correct CRC, plan next
+    bool     hopDue(int64_t nowUs);                                         // true if expected packet did not arrive
+    bool     packetMissed(int64_t nowUs);                                   // window closed without packet, plan next
+    bool     locked(void);                                                  // at least one transmitter is followed
+    bool     expected(uint8_t txId, uint8_t channel, int64_t rxUs);         // packet on the channel and in the window of a followed transmitter
+    int8_t   target(void);                                                  // transmitter served next, -1: none
+    uint8_t  channel(void);                                                 // channel to listen on for target
+    int64_t  deadline(void);                                                // time [us] when target window closes
+    const DavisHopTx &tx(uint8_t txId);                                     // state of one transmitter
+    static uint32_t nominalPeriodUs(uint8_t txId);                          // (41 + ID) / 16 s in [us]
+
+  protected:
+    bool     plan(int64_t nowUs);                                           // advance closed windows, choose target
+    uint32_t windowUs(const DavisHopTx &t, uint32_t periods);               // wait after expected arrival, periods without packet
+    int64_t  arrival(const DavisHopTx &t);                                  // time [us] of next expected packet
+    int64_t  windowEnd(const DavisHopTx &t);                                // time [us] when window of next packet closes
+
+    DavisHopTx _tx[DAVIS_HOP_MAX_TX];                                       // per transmitter state
+    int8_t   _target;                                                       // transmitter served next, -1: none
+    uint8_t  _numChannels;                                                  // length of channel table
+};
+
+#endif  // DAVISHOPSCHEDULER_h
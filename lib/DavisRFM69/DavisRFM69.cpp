@@ -13,16 +13,94 @@
 #include <DavisRFM69.h>
 #include <RFM69registers.h>
 #include <SPI.h>
+#include <esp_timer.h>
 
-volatile byte DavisRFM69::_data[DAVIS_PACKET_LEN];                 // packet receive buffer
+static const SPISettings RF69_SPI_SETTINGS(RF69_SPI_CLOCK, MSBFIRST, SPI_MODE0);
+
+/************************************************************
+ * Frequency Tables
+ * - packed FRF words (FRF_MSB << 16 | FRF_MID << 8 | FRF_LSB) 
+ *   in the order Davis uses them for frequency hopping
+ * - kept in DRAM, retuning does not wait for the flash cache
+ ************************************************************/
+DRAM_ATTR static constexpr uint32_t FRF_US[] = {
+  0xE3DA7C, 0xE19871, 0xE3FA92, 0xE6BD01, 0xE4BB4D, 0xE29956,
+  0xE77DBC, 0xE59C0E, 0xE339E6, 0xE61C81, 0xE45AE8, 0xE1F8D6,
+  0xE53BBF, 0xE71D5F, 0xE39A3C, 0xE23900, 0xE4FB77, 0xE65CB2,
+  0xE2D990, 0xE7BDEE, 0xE43AD2, 0xE1D8AA, 0xE55BCD, 0xE6DD34,
+  0xE35A0A, 0xE79DD9, 0xE27941, 0xE49B28, 0xE5DC40, 0xE73D74,
+  0xE1B89C, 0xE3BA60, 0xE67CC8, 0xE4DB62, 0xE2B97A, 0xE57BE2,
+  0xE7DE12, 0xE63C9D, 0xE319C9, 0xE41AB6, 0xE5BC2B, 0xE218EB,
+  0xE6FD42, 0xE51BA3, 0xE37A2E, 0xE5FC64, 0xE25916, 0xE69CEC,
+  0xE2F9AC, 0xE47B0C, 0xE75D98
+};
+
+DRAM_ATTR static constexpr uint32_t FRF_EU[] = {
+  0xD90445, 0xD91304, 0xD921C2, 0xD90BA4, 0xD91A63
+};
+
+static_assert(sizeof(FRF_US) / sizeof(FRF_US[0]) == 51, "North American table has 51 channels");
+static_assert(sizeof(FRF_EU) / sizeof(FRF_EU[0]) == 5, "European table has 5 channels");
+static_assert(sizeof(FRF_US) / sizeof(FRF_US[0]) <= DAVIS_FREQ_TABLE_MAX, "DAVIS_FREQ_TABLE_MAX too small");
+static_assert(DAVIS_FREQ_TABLE_MAX <= 64, "_offsetLearned holds one bit per channel");
+
+// Region table, index: DAVIS_REGION_xx
+static const struct {
+  const char     *name;
+  const uint32_t *frf;
+  byte            length;
+} REGIONS[DAVIS_REGION_NUM] = {
+  { "US", FRF_US, sizeof(FRF_US) / sizeof(FRF_US[0]) },
+  { "EU", FRF_EU, sizeof(FRF_EU) / sizeof(FRF_EU[0]) }
+};
+
+DavisPacket   DavisRFM69::_ring[DAVIS_RING_SIZE];                  // packet ring between service() and main loop
+volatile byte DavisRFM69::_ringHead = 0;                           // free running write index
+volatile byte DavisRFM69::_ringTail = 0;                           // free running read index
+volatile byte DavisRFM69::_ringHighWater = 0;                      // maximum number of packets waiting
+volatile uint32_t DavisRFM69::_ringOverflows = 0;                  // packets dropped because ring was full
 volatile byte DavisRFM69::_channel = 0;                            // actual channel
-volatile bool DavisRFM69::_hasCrcError = false;                      // current packet has been read
-volatile bool DavisRFM69::_packetReceived = false;                 // packet has been received
-volatile int  DavisRFM69::_rssi;                                   // RSSI measured immediately after payload reception
+const uint32_t * volatile DavisRFM69::_frf = REGIONS[DAVIS_REGION_DEFAULT].frf; // frequency table of selected region
+volatile byte DavisRFM69::_numChannels = REGIONS[DAVIS_REGION_DEFAULT].length; // length of frequency table
+byte          DavisRFM69::_region = DAVIS_REGION_DEFAULT;          // selected region
+int32_t       DavisRFM69::_offset[DAVIS_FREQ_TABLE_MAX];           // per channel frequency offset [1/16 step]
+uint64_t      DavisRFM69::_offsetLearned = 0;                      // bit per channel: _offset is valid
+int16_t       DavisRFM69::_correction = 0;                         // offset applied to FRF of actual channel [step]
+volatile uint32_t DavisRFM69::_chPackets[DAVIS_FREQ_TABLE_MAX];    // packets with correct CRC per channel
+volatile uint32_t DavisRFM69::_chCrcErrors[DAVIS_FREQ_TABLE_MAX];  // packets with CRC error per channel
+DavisPacketHandler DavisRFM69::_packetHandler = NULL;              // called by service() after each packet
+DavisIrqHandler DavisRFM69::_irqHandler = NULL;                    // called from ISR, wakes the task calling service()
+portMUX_TYPE  DavisRFM69::_irqMux = portMUX_INITIALIZER_UNLOCKED;  // guards _irqPending and _irqUs
+volatile bool DavisRFM69::_irqPending = false;                     // PayloadReady signaled, not yet serviced
+volatile int64_t DavisRFM69::_irqUs = 0;                           // esp_timer_get_time() [us] of the last PayloadReady
+DavisPacketHandler DavisRFM69::_correctionFilter = NULL;           // accepts or rejects repaired packets
+byte          DavisRFM69::_shadow[RF69_SHADOW_SIZE];               // last value written to each register
+byte          DavisRFM69::_shadowValid[(RF69_SHADOW_SIZE + 7) / 8]; // shadow entry is valid
+volatile uint32_t DavisRFM69::_shadowMismatches = 0;               // shadow entries found different from chip
 volatile byte DavisRFM69::_mode;                                   // current transceiver state
 
 DavisRFM69* DavisRFM69::selfPointer;
 
+/************************************************************
+ * Registers kept in the shadow cache
+ * - configuration registers, only changed by this driver
+ * - not: FIFO, status/flag registers and registers with 
+ *   self clearing trigger bits 
+ ************************************************************/
+static bool isShadowed(byte addr) {
+  switch (addr) {
+    case REG_FIFO:
+    case REG_OSC1:
+    case REG_AFCFEI:
+    case REG_RSSICONFIG:
+    case REG_IRQFLAGS1:
+    case REG_IRQFLAGS2:
+    case REG_TEMP1:
+      return false;
+  }
+  return addr < RF69_SHADOW_SIZE;
+}
+
 /************************************************************
  * Init receiver 
  ************************************************************/
@@ -89,11 +167,13 @@ void DavisRFM69::init(void) {
     {255, 0}
   };
   
-  // init SPI
+  byte run[16];                     // config values of consecutive registers
+  byte runAddr = 0;                  // first register of run
+  byte runLen = 0;                   // number of registers in run
+  
+  // init SPI (mode, bit order and clock are set per transaction)
   pinMode(_slaveSelectPin, OUTPUT);
-  SPI.setDataMode(SPI_MODE0);
-  SPI.setBitOrder(MSBFIRST);
-  SPI.setClockDivider(SPI_CLOCK_DIV2); //max speed, except on Due which can run at system clock speed
+  digitalWrite(_slaveSelectPin, HIGH);
   SPI.begin();
 
   // sync
@@ -104,9 +184,15 @@ void DavisRFM69::init(void) {
      writeReg(REG_SYNCVALUE1, 0x55); 
   } while (readReg(REG_SYNCVALUE1) != 0x55);
 
-  // send config
-  for (byte i = 0; CONFIG[i][0] != 255; i++) {
-    writeReg(CONFIG[i][0], CONFIG[i][1]);
+  // send config, consecutive registers are written as one burst
+  for (byte i = 0; ; i++) {
+    if ((runLen > 0) && ((CONFIG[i][0] != runAddr + runLen) || (runLen == sizeof(run)))) {
+      writeBurst(runAddr, run, runLen);
+      runLen = 0;
+    }
+    if (CONFIG[i][0] == 255) break;
+    if (runLen == 0) runAddr = CONFIG[i][0];
+    run[runLen++] = CONFIG[i][1];
   }
   
   // Standby
@@ -125,23 +211,99 @@ void DavisRFM69::init(void) {
 
 
 /************************************************************
- * RFM Receive Packet Interrupt Handler 
- * - read RSSI
- * - get data received to _data Buffer
+ * Service Radio (task context)
+ * - the ISR only takes the timestamp of PayloadReady and 
+ *   wakes the task (see isr0, setIrqHandler), all SPI access
+ *   is done by this task: SPI.beginTransaction() takes a 
+ *   mutex and must not be called from an ISR
+ * - must be called by the task that does all other radio 
+ *   calls as well, so no lock is needed around the bus
+ * @return true if a signaled packet has been read
  ************************************************************/
-void DavisRFM69::interruptHandler(void) {
-  _rssi = readRSSI();  // Read up front when it is most likely the carrier is still up  
-  if (_mode == RF69_MODE_RX && (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY)) {    
+bool DavisRFM69::service(void) {
+  int64_t t;
+  bool pending;
+  portENTER_CRITICAL(&_irqMux);
+  pending = _irqPending;
+  t = _irqUs;
+  _irqPending = false;
+  portEXIT_CRITICAL(&_irqMux);
+  if (!pending) {
+    return false;
+  }
+  readPacket(t);
+  return true;
+}
+
+
+/************************************************************
+ * Read Packet
+ * - read RSSI and IRQ flags in one burst (0x24 - 0x28)
+ * - get data received in one FIFO burst and verify CRC
+ * - store packet to the next free ring slot 
+ *   (counted as overflow if the main loop did not keep up)
+ * - re-arm receiver without waiting for the main loop:
+ *   - CRC OK:    hop to next channel
+ *   - CRC Error: listen again on same channel
+ * - call packet handler (if set)
+ * @param[in] timestampUs time PayloadReady was signaled [us]
+ ************************************************************/
+void DavisRFM69::readPacket(int64_t timestampUs) {
+  DavisPacket pkt;
+  byte *buf = pkt.data;
+  byte regs[REG_IRQFLAGS2 - REG_AFCMSB + 1];
+  // AFC/FEI, RSSI (read up front when it is most likely the carrier is still up), 
+  // DIO mapping and IRQ flags in one burst
+  readBurst(REG_AFCMSB, regs, sizeof(regs));
+  int rssi = -regs[REG_RSSIVALUE - REG_AFCMSB] >> 1;
+  if (_mode == RF69_MODE_RX && (regs[REG_IRQFLAGS2 - REG_AFCMSB] & RF_IRQFLAGS2_PAYLOADREADY)) {    
     setMode(RF69_MODE_STANDBY);        
-    select();    // Select RFM69 module, disable interrupts
     // get data received
-    SPI.transfer(REG_FIFO & 0x7f);
-    for (byte i = 0; i < DAVIS_PACKET_LEN; i++){
-      _data[i] = reverseBits(SPI.transfer(0));      
-    } 
-    _packetReceived = true;    
-    _hasCrcError = false;
-    unselect();  // Unselect RFM69 module, enable interrupts
+    readBurst(REG_FIFO, buf, DAVIS_PACKET_LEN);
+    DavisBitReverse::reverseBuffer(buf, DAVIS_PACKET_LEN);   // ISS sends LSB first
+    pkt.rssi = rssi;
+    pkt.channel = _channel;
+    pkt.crcOk = DavisCRC::check(buf);
+    pkt.corrected = 0;
+    pkt.timestampUs = timestampUs;
+    pkt.afc = (int16_t)((regs[REG_AFCMSB - REG_AFCMSB] << 8) | regs[REG_AFCLSB - REG_AFCMSB]);
+    #if DAVIS_CRC_CORRECT_BITS
+    // repair bit errors, the filter may reject the repaired packet
+    if (!pkt.crcOk) {
+      int bits = DavisCRC::correct(buf);
+      if (bits > 0) {
+        pkt.corrected = (byte)bits;
+        pkt.crcOk = (_correctionFilter == NULL) || _correctionFilter(pkt);
+      }
+    }
+    #endif
+    if (pkt.crcOk) {
+      trackOffset(_channel, pkt.afc);
+      _chPackets[_channel]++;
+    } else {
+      _chCrcErrors[_channel]++;
+    }
+    // store to ring, head is published after the slot has been written
+    byte head = _ringHead;
+    byte level = head - _ringTail;
+    if (level < DAVIS_RING_SIZE) {
+      _ring[head & (DAVIS_RING_SIZE - 1)] = pkt;
+      __sync_synchronize();
+      _ringHead = head + 1;
+      if (level + 1 > _ringHighWater) _ringHighWater = level + 1;
+    } else {
+      _ringOverflows++;
+    }
+    // re-arm receiver: handler chooses next channel, 
+    // default: hop on correct packet, stay on channel else
+    if (_packetHandler && _packetHandler(pkt)) {
+      return;
+    }
+    if (pkt.crcOk) {
+      hop();
+    } else {
+      receiveBegin();
+    }
   }  
 }
 
@@ -149,17 +311,171 @@ void DavisRFM69::interruptHandler(void) {
 /************************************************************
  * Set Channel 
  * - and activate receiver
+ * - FRF is written in one burst (see setFrequency)
+ * - the frequency offset learned for this channel is added 
+ *   (DAVISRFM69_AFC_TRACKING 1), so the receiver is centered
+ *   on the transmitter before AFC kicks in
  ************************************************************/
 void DavisRFM69::setChannel(byte channel) {
+  if (channel >= _numChannels) channel = 0;
   _channel = channel;
-  if (_channel > DAVIS_FREQ_TABLE_LENGTH - 1) _channel = 0;
-  writeReg(REG_FRFMSB, pgm_read_byte(&FRF[_channel][0]));
-  writeReg(REG_FRFMID, pgm_read_byte(&FRF[_channel][1]));
-  writeReg(REG_FRFLSB, pgm_read_byte(&FRF[_channel][2]));
+  #if DAVISRFM69_AFC_TRACKING
+  int32_t offset = _offset[channel];
+  _correction = (int16_t)((offset + (offset < 0 ? -8 : 8)) / 16);
+  #endif
+  setFrequency(_frf[channel] + _correction);
   receiveBegin();
 }
 
 
+/************************************************************
+ * Track Frequency Offset of a Channel
+ * - called by readPacket() for each packet with correct CRC
+ * - AFC holds the frequency error measured on the preamble,
+ *   relative to the FRF used (which includes _correction)
+ * - moving average (1/8), first packet on a channel is 
+ *   taken over directly, limited to RF69_AFC_MAX_HZ
+ * @param[in] channel channel the packet was received on
+ * @param[in] afc     AFC value [61 Hz steps]
+ ************************************************************/
+void DavisRFM69::trackOffset(byte channel, int16_t afc) {
+  const int32_t limit = (int32_t)RF69_AFC_MAX_HZ * 256 / 15625 * 16;
+  int32_t measured = ((int32_t)_correction + afc) * 16;
+  int32_t offset = _offset[channel];
+  if (!(_offsetLearned & (1ULL << channel))) {
+    offset = measured;
+    _offsetLearned |= (1ULL << channel);
+  } else {
+    offset += (measured - offset) / 8;
+  }
+  if (offset > limit) offset = limit;
+  if (offset < -limit) offset = -limit;
+  _offset[channel] = offset;
+}
+
+
+/************************************************************
+ * Select Frequency Region
+ * - takes effect with the next setChannel() / hop()
+ * - receiver is set to standby and a packet signaled but not
+ *   read yet is dropped, so no packet of the old region is 
+ *   read (and its offset tracked) with the new table
+ * - the ISR does not use the table, offsets or channel, all 
+ *   of them are only used by the task (see service)
+ * @param[in] region DAVIS_REGION_US, DAVIS_REGION_EU
+ * @return    false if region is unknown (selection unchanged)
+ ************************************************************/
+bool DavisRFM69::setRegion(byte region) {
+  if (region >= DAVIS_REGION_NUM) {
+    return false;
+  }
+  setMode(RF69_MODE_STANDBY);
+  portENTER_CRITICAL(&_irqMux);
+  _irqPending = false;
+  portEXIT_CRITICAL(&_irqMux);
+  _region = region;
+  _frf = REGIONS[region].frf;
+  _numChannels = REGIONS[region].length;
+  if (_channel >= _numChannels) _channel = 0;
+  for (byte ch = 0; ch < DAVIS_FREQ_TABLE_MAX; ch++) {
+    _offset[ch] = 0;
+    _chPackets[ch] = 0;
+    _chCrcErrors[ch] = 0;
+  }
+  _offsetLearned = 0;
+  _correction = 0;
+  return true;
+}
+
+
+/************************************************************
+ * region
+ * @return selected frequency region
+ ************************************************************/
+byte DavisRFM69::region(void) {
+  return _region;
+}
+
+
+/************************************************************
+ * numChannels
+ * @return length of frequency table of selected region
+ ************************************************************/
+byte DavisRFM69::numChannels(void) {
+  return _numChannels;
+}
+
+
+/************************************************************
+ * channelOffsetHz
+ * @param[in] channel channel of selected region
+ * @return    learned frequency offset [Hz]
+ ************************************************************/
+int32_t DavisRFM69::channelOffsetHz(byte channel) {
+  return (channel < _numChannels) ? RF69_FSTEP_HZ(_offset[channel] / 16) : 0;
+}
+
+
+/************************************************************
+ * channelPackets
+ * @param[in] channel channel of selected region
+ * @return    packets with correct CRC received on channel
+ ************************************************************/
+uint32_t DavisRFM69::channelPackets(byte channel) {
+  return (channel < _numChannels) ? _chPackets[channel] : 0;
+}
+
+
+/************************************************************
+ * channelCrcErrors
+ * @param[in] channel channel of selected region
+ * @return    packets with CRC error received on channel
+ ************************************************************/
+uint32_t DavisRFM69::channelCrcErrors(byte channel) {
+  return (channel < _numChannels) ? _chCrcErrors[channel] : 0;
+}
+
+
+/************************************************************
+ * Receiver Flags
+ * - carrier detection while scanning channels
+ * - flags are cleared by setChannel() / hop()
+ * - SPI read: task context only, like all other calls except
+ *   the ISR (see service)
+ * @return RF69_RX_RSSI: RSSI above REG_RSSITHRESH, 
+ *         RF69_RX_SYNC: sync word detected
+ ************************************************************/
+byte DavisRFM69::rxFlags(void) {
+  byte flags = 0;
+  byte irq = readReg(REG_IRQFLAGS1);
+  if (irq & RF_IRQFLAGS1_RSSI) flags |= RF69_RX_RSSI;
+  if (irq & RF_IRQFLAGS1_SYNCADDRESSMATCH) flags |= RF69_RX_SYNC;
+  return flags;
+}
+
+
+/************************************************************
+ * Reset per Channel Packet Counters
+ * - learned frequency offsets are kept
+ ************************************************************/
+void DavisRFM69::resetChannelStats(void) {
+  for (byte ch = 0; ch < DAVIS_FREQ_TABLE_MAX; ch++) {
+    _chPackets[ch] = 0;
+    _chCrcErrors[ch] = 0;
+  }
+}
+
+
+/************************************************************
+ * regionName
+ * @param[in] region DAVIS_REGION_xx
+ * @return    "US", "EU", NULL if region is unknown
+ ************************************************************/
+const char *DavisRFM69::regionName(byte region) {
+  return (region < DAVIS_REGION_NUM) ? REGIONS[region].name : NULL;
+}
+
+
 /************************************************************
  * Hop to next Channel and activate receiver 
  ************************************************************/
@@ -169,132 +485,156 @@ void DavisRFM69::hop(void) {
 
 
 /************************************************************
- * Reverse bits in a byte
- * - The data bytes come over the air from the ISS have 
- *   least significant bit first. 
- * - from http://www.ocf.berkeley.edu/~wwu/cgi-bin/yabb/YaBB.cgi?board=riddles_cs;action=display;num=1103355188
- * @param[in] b value to be reversed
- * @return    reversed value
+ * Take oldest Packet from Ring
+ * - must only be called from one consumer (main loop)
+ * @param[out] packet copy of the received packet
+ * @return     false if no packet is waiting
  ************************************************************/
-byte DavisRFM69::data(byte index) {
-  byte v;
-  if ((index < 0) || (index > 7)) {
-    // no valid index
-    v = 0xff;
-  } else {
-    v = _data[index];
+bool DavisRFM69::receivePacket(DavisPacket &packet) {
+  byte tail = _ringTail;
+  if (tail == _ringHead) {
+    return false;
   }
-  return(v);
+  __sync_synchronize();
+  packet = _ring[tail & (DAVIS_RING_SIZE - 1)];
+  __sync_synchronize();
+  _ringTail = tail + 1;
+  return true;
 }
 
 /************************************************************
- * Reverse bits in a byte
- * - The data bytes come over the air from the ISS have 
- *   least significant bit first. 
- * - from http://www.ocf.berkeley.edu/~wwu/cgi-bin/yabb/YaBB.cgi?board=riddles_cs;action=display;num=1103355188
- * @param[in] b value to be reversed
- * @return    reversed value
+ * Set IRQ Handler
+ * - called from interrupt context when PayloadReady has been
+ *   signaled, must be in IRAM and must not use SPI
+ * - wakes the task that calls service()
+ * @param[in] handler function to be called, NULL: none
  ************************************************************/
-byte DavisRFM69::reverseBits(byte b) {
-  b = ((b & 0b11110000) >>4 ) | ((b & 0b00001111) << 4);
-  b = ((b & 0b11001100) >>2 ) | ((b & 0b00110011) << 2);
-  b = ((b & 0b10101010) >>1 ) | ((b & 0b01010101) << 1);
-  return(b);
+void DavisRFM69::setIrqHandler(DavisIrqHandler handler) {
+  _irqHandler = handler;
 }
 
 /************************************************************
- * get CRC16
- * @return CRC value for packet in receive buffer 
+ * Set Packet Handler
+ * - handler is called by service() after each packet, the 
+ *   receiver is in standby
+ * - handler may re-arm the receiver (setChannel()) and 
+ *   return true, else the default applies: hop after a 
+ *   correct packet, stay on channel after a CRC error
+ * - must be short and must not use the radio ring
+ * @param[in] handler function to be called, NULL: none
  ************************************************************/
-uint16_t DavisRFM69::crc16(void) {
-  // First 6 Bate 
-  // unsigned int crc;
-  // crc = compute_crc16(_data, 6);
-  return compute_crc16(_data, 6);
+void DavisRFM69::setPacketHandler(DavisPacketHandler handler) {
+  _packetHandler = handler;
 }
 
 /************************************************************
- * rssi
- * @return RSSI measured immediately after payload reception
+ * Set Correction Filter
+ * - called by service() for each packet repaired 
+ *   by CRC bit error correction (DAVIS_CRC_CORRECT_BITS)
+ * - returns false to reject the packet (it is then handled 
+ *   like a packet with CRC error), e.g. if its transmitter
+ *   is not expected
+ * @param[in] filter function to be called, NULL: accept all
  ************************************************************/
-int DavisRFM69::rssi(void) {  
-  return _rssi;
+void DavisRFM69::setCorrectionFilter(DavisPacketHandler filter) {
+  _correctionFilter = filter;
 }
 
 /************************************************************
- * channel
- * @return current channel
+ * packetsPending
+ * @return number of packets waiting in ring
  ************************************************************/
-byte DavisRFM69::channel(void) {  
-  return _channel;
+byte DavisRFM69::packetsPending(void) {
+  return (byte)(_ringHead - _ringTail);
 }
 
+/************************************************************
+ * ringHighWater
+ * @return maximum number of packets waiting in ring
+ ************************************************************/
+byte DavisRFM69::ringHighWater(void) {
+  return _ringHighWater;
+}
 
+/************************************************************
+ * ringOverflows
+ * @return number of packets dropped because ring was full
+ ************************************************************/
+uint32_t DavisRFM69::ringOverflows(void) {
+  return _ringOverflows;
+}
 
 /************************************************************
- * Davis CRC calculation
- * - from http://www.menie.org/georges/embedded/
- * - changed to not support othe start value as 0
- * @param[in] buf pointer to buffer 
- * @param[in] len legth of buffer 
+ * reset ring high water mark and overflow counter
  ************************************************************/
-uint16_t DavisRFM69::compute_crc16(volatile byte *buf, byte len){  
-  unsigned int crc = 0;
-  while (len--) {
-    int i;
-    crc ^= *(char *)buf++ << 8;
-    for( i = 0; i < 8; ++i ) {
-      if( crc & 0x8000 )
-        crc = (crc << 1) ^ 0x1021;
-      else
-        crc = crc << 1;
-    }
-  }
-  return crc;
+void DavisRFM69::resetRingStats(void) {
+  _ringHighWater = 0;
+  _ringOverflows = 0;
+}
+
+/************************************************************
+ * get CRC16
+ * @param[in] packet received packet
+ * @return CRC value computed over the first 6 bytes of packet
+ ************************************************************/
+uint16_t DavisRFM69::crc16(const DavisPacket &packet) {
+  return DavisCRC::crc16(packet.data, DAVIS_CRC_DATA_LEN);
+}
+
+/************************************************************
+ * channel
+ * @return current channel
+ ************************************************************/
+byte DavisRFM69::channel(void) {  
+  return _channel;
 }
 
 
+
 /************************************************************
  * Write Frequency
  * - Write FRF to RFM69 Register
  * - the 3 FRF Bytes are stored in one uint32_t value
+ * - MSB, MID, LSB written in one burst, the chip takes 
+ *   over the new frequency on the LSB write
  * @param[in] FRF value to be written
  ************************************************************/
 void DavisRFM69::setFrequency(uint32_t FRF) {
-  writeReg(REG_FRFMSB, FRF >> 16);
-  writeReg(REG_FRFMID, FRF >> 8);
-  writeReg(REG_FRFLSB, FRF);
+  const byte buf[3] = { (byte)(FRF >> 16), (byte)(FRF >> 8), (byte)FRF };
+  writeBurst(REG_FRFMSB, buf, sizeof(buf));
 }
 
 
 /************************************************************
  * Set RFM69 Mode  
  * - TX and SYNTH not needed to receive data from ISS
+ * - REG_OPMODE is taken from shadow cache, so a mode change
+ *   is a single register write
  * @param[in] mode  New mode, can be RX, STANDBY, SLEEP
  ************************************************************/
 void DavisRFM69::setMode(byte mode) {  
   if (mode == _mode) return;
-  _mode = mode;  
-  switch (_mode) {
+  switch (mode) {
     case RF69_MODE_TX:
       // Not supported      
-      // writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_TRANSMITTER);      
+      // updateReg(REG_OPMODE, (_shadow[REG_OPMODE] & 0xE3) | RF_OPMODE_TRANSMITTER);      
       break;
     case RF69_MODE_RX:
-      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_RECEIVER);      
+      updateReg(REG_OPMODE, (_shadow[REG_OPMODE] & 0xE3) | RF_OPMODE_RECEIVER);      
       break;
     case RF69_MODE_SYNTH:
       // Not supported
-      // writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_SYNTHESIZER);
+      // updateReg(REG_OPMODE, (_shadow[REG_OPMODE] & 0xE3) | RF_OPMODE_SYNTHESIZER);
       break;
     case RF69_MODE_STANDBY:
-      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_STANDBY);
+      updateReg(REG_OPMODE, (_shadow[REG_OPMODE] & 0xE3) | RF_OPMODE_STANDBY);
       break;
     case RF69_MODE_SLEEP:
-      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_SLEEP);
+      updateReg(REG_OPMODE, (_shadow[REG_OPMODE] & 0xE3) | RF_OPMODE_SLEEP);
       break;
     default: return;
   }
+  _mode = mode;  
   // we are using packet mode, so this check is not really needed
   // but waiting for mode ready is necessary when going from sleep because the FIFO may not be immediately available from previous mode
   while (_mode == RF69_MODE_SLEEP && (readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // Wait for ModeReady
@@ -309,99 +649,184 @@ void DavisRFM69::sleep(void) {
 
 /************************************************************
  * Packet Receive ISR
+ * - no SPI access here: take the timestamp (see 
+ *   DavisPacket.timestampUs) and wake the task, which reads
+ *   the packet by service()
  ************************************************************/
-void DavisRFM69::isr0(void) { 
-  selfPointer->interruptHandler(); 
+void IRAM_ATTR DavisRFM69::isr0(void) { 
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL_ISR(&_irqMux);
+  _irqUs = now;
+  _irqPending = true;
+  portEXIT_CRITICAL_ISR(&_irqMux);
+  if (_irqHandler) {
+    _irqHandler();
+  }
 }
 
 
 /************************************************************
  * Activate Receiver 
+ * - already receiving (hop without packet): restart receiver,
+ *   so it locks on the new frequency and no stale FIFO 
+ *   content can block it (avoid RX deadlocks)
+ * - no register is read, values are taken from shadow cache
  ************************************************************/
 void DavisRFM69::receiveBegin(void) {
-  _packetReceived = false;
-  if (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY){
-    writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+  if (_mode == RF69_MODE_RX) {
+    writeReg(REG_PACKETCONFIG2, (_shadow[REG_PACKETCONFIG2] & 0xFB) | RF_PACKET2_RXRESTART); 
+    _shadow[REG_PACKETCONFIG2] &= 0xFB;                               // RXRESTART bit always reads 0
   }
   // set DIO0 to "PAYLOADREADY" in receive mode
-  writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_01);                 
+  updateReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_01);                 
   setMode(RF69_MODE_RX);
 }
 
 /************************************************************
- * receiveDone
+ * read from RFM Register
  ************************************************************
- * @return  true if packet received since last channel hop
+ * @param[in] addr  address of register
+ * @return          registervalue 
  ************************************************************/
-bool DavisRFM69::receiveDone(void) {
-  return _packetReceived;
+byte DavisRFM69::readReg(byte addr) {
+  select();
+  SPI.transfer(addr & 0x7F);
+  byte regval = SPI.transfer(0);
+  unselect();
+  return regval;
 }
 
+
 /************************************************************
- * mark current packet has CRC Error
-  ************************************************************/
-void DavisRFM69::markCrcError(void) {
-  _hasCrcError = true;
+ * burst read from RFM Registers
+ ************************************************************
+ * - register address is auto incremented by the RFM69, 
+ *   except for REG_FIFO which returns consecutive FIFO bytes
+ * @param[in]  addr  address of first register
+ * @param[out] buf   buffer for register values
+ * @param[in]  len   number of registers to read
+ ************************************************************/
+void DavisRFM69::readBurst(byte addr, byte *buf, byte len) {
+  memset(buf, 0, len);
+  select();
+  SPI.transfer(addr & 0x7F);
+  SPI.transfer(buf, len);
+  unselect();
 }
- 
+
+
 /************************************************************
- * get CRC Error State of current packet 
+ * write to RFM Register
+ ************************************************************
+ * @param[in] addr  address of register
+ * @param[in] value value tha ha to be written
  ************************************************************/
-boolean DavisRFM69::getCrcError() {
-  return _hasCrcError;
+void DavisRFM69::writeReg(byte addr, byte value) {
+  select();
+  SPI.transfer(addr | 0x80);
+  SPI.transfer(value);
+  unselect();
+  if (isShadowed(addr)) {
+    _shadow[addr] = value;
+    _shadowValid[addr >> 3] |= (1 << (addr & 7));
+  }
 }
 
 
 /************************************************************
- * Read actual RSSI
+ * update RFM Register
  ************************************************************
- * @return          RSSI value
+ * - write only if value differs from shadow cache 
+ *   (or register is not in shadow cache)
+ * - DAVISRFM69_VERIFY_SHADOW: check skipped writes against chip
+ * @param[in] addr  address of register
+ * @param[in] value value tha ha to be written
  ************************************************************/
-int DavisRFM69::readRSSI(void) {
-  int rssi;  
-  rssi = -readReg(REG_RSSIVALUE);
-  rssi >>= 1;
-  return rssi;
+void DavisRFM69::updateReg(byte addr, byte value) {
+  if (isShadowed(addr) && (_shadowValid[addr >> 3] & (1 << (addr & 7))) && (_shadow[addr] == value)) {
+    #if DAVISRFM69_VERIFY_SHADOW
+    verifyReg(addr);
+    #endif
+    return;
+  }
+  writeReg(addr, value);
 }
 
 
 /************************************************************
- * read from RFM Register
+ * verify shadowed RFM Register
  ************************************************************
+ * - read register and compare with shadow cache
+ * - on mismatch: count and take over value from chip
  * @param[in] addr  address of register
- * @return          registervalue 
  ************************************************************/
-byte DavisRFM69::readReg(byte addr) {
-  select();
-  SPI.transfer(addr & 0x7F);
-  byte regval = SPI.transfer(0);
-  unselect();
-  return regval;
+void DavisRFM69::verifyReg(byte addr) {
+  byte value;
+  if (!isShadowed(addr) || !(_shadowValid[addr >> 3] & (1 << (addr & 7)))) return;
+  value = readReg(addr);
+  if (value != _shadow[addr]) {
+    _shadowMismatches++;
+    _shadow[addr] = value;
+  }
 }
 
 
 /************************************************************
- * write to RFM Register
+ * verify shadow cache
  ************************************************************
- * @param[in] addr  address of register
- * @param[in] value value tha ha to be written
+ * - compare all valid shadow entries with chip
+ * @return number of mismatches found 
  ************************************************************/
-void DavisRFM69::writeReg(byte addr, byte value) {
+uint16_t DavisRFM69::verifyShadow(void) {
+  uint32_t before = _shadowMismatches;
+  for (byte addr = 0; addr < RF69_SHADOW_SIZE; addr++) {
+    verifyReg(addr);
+  }
+  return (uint16_t)(_shadowMismatches - before);
+}
+
+
+/************************************************************
+ * shadowMismatches
+ * @return number of shadow entries found different from chip
+ ************************************************************/
+uint32_t DavisRFM69::shadowMismatches(void) {
+  return _shadowMismatches;
+}
+
+
+/************************************************************
+ * burst write to RFM Registers
+ ************************************************************
+ * @param[in] addr  address of first register
+ * @param[in] buf   values to be written
+ * @param[in] len   number of registers to write
+ ************************************************************/
+void DavisRFM69::writeBurst(byte addr, const byte *buf, byte len) {
   select();
   SPI.transfer(addr | 0x80);
-  SPI.transfer(value);
+  SPI.writeBytes(buf, len);
   unselect();
+  if (addr == REG_FIFO) return;                                         // FIFO address is not incremented
+  for (byte i = 0; i < len; i++, addr++) {
+    if (isShadowed(addr)) {
+      _shadow[addr] = buf[i];
+      _shadowValid[addr >> 3] |= (1 << (addr & 7));
+    }
+  }
 }
 
 
 /************************************************************
  * SPI select RFM69
  ************************************************************
- * - disable Interrupts
+ * - task context only, never called from an ISR (see service)
+ * - begin SPI transaction (bus settings and lock taken once, 
+ *   not per transferred byte)
  * - Select RFM (SS: low) 
  ************************************************************/
 void DavisRFM69::select() {
-  noInterrupts();
+  SPI.beginTransaction(RF69_SPI_SETTINGS);
   digitalWrite(_slaveSelectPin, LOW);
 }
 
@@ -410,11 +835,11 @@ void DavisRFM69::select() {
  * SPI unselect RFM69
  ************************************************************
  * - Unselect RFM (SS: high) 
- * - enable Interrupts
+ * - end SPI transaction
  ************************************************************/
 void DavisRFM69::unselect() {
   digitalWrite(_slaveSelectPin, HIGH);
-  interrupts();
+  SPI.endTransaction();
 }
 
 
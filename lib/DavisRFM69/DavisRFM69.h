@@ -13,27 +13,63 @@
 #ifndef DAVISRFM69_h
 #define DAVISRFM69_h
 
-// Uncomment ONE AND ONLY ONE of the four #define's below.  This determines the
-// frequency table the code will use.  Note that only the US (actually North
-// America) and EU frequencies are defined at this time.  Australia and New
-// Zealand are placeholders.  Note however that the frequencies for AU and NZ
-// are not known at this time.
-//#define DAVIS_FREQS_US
-#define DAVIS_FREQS_EU
-//#define DAVIS_FREQS_AU
-//#define DAVIS_FREQS_NZ
+// Frequency region is selected at runtime (see setRegion()).  Only the US 
+// (actually North America) and EU frequencies are known at this time, the 
+// frequencies for Australia and New Zealand are not known.
+#define DAVIS_REGION_US       0 // North America, 51 channels
+#define DAVIS_REGION_EU       1 // Europe, 5 channels
+#define DAVIS_REGION_NUM      2 // number of known regions
+#ifndef DAVIS_REGION_DEFAULT
+#define DAVIS_REGION_DEFAULT DAVIS_REGION_EU // region used until another one is selected
+#endif
+#define DAVIS_FREQ_TABLE_MAX 51 // longest frequency table (US), max 64
 
 #include <Arduino.h>            //assumes Arduino IDE v1.0 or greater
+#include <SPI.h>
+#include <DavisCRC.h>
+#include <DavisBitReverse.h>
 
 #define DAVIS_PACKET_LEN      8 // ISS has fixed packet lengths of eight bytes, including CRC
+#define DAVIS_PAYLOAD_AIRTIME_US 3333 // 8 payload bytes at 19.2 kbps: sync word detected this long before PayloadReady
+#define DAVIS_RING_SIZE      16 // Packet slots between service() and main loop (power of two, max 128)
 #define RF69_PIN_CS           5 // SS connected to this pin:   ESP32 GPIO 5
 #define RF69_PIN_IRQ          2 // DIO0 connected to this pin: ESP32 GPIO 2
+#define RF69_SPI_CLOCK  8000000 // SPI clock [Hz], RFM69 supports up to 10 MHz
+#define RF69_SHADOW_SIZE   0x72 // registers 0x00 - 0x71 (REG_TESTAFC) kept in shadow cache
+#ifndef DAVISRFM69_VERIFY_SHADOW
+#define DAVISRFM69_VERIFY_SHADOW 0 // 1: read back each register served from shadow cache and count mismatches
+#endif
+#ifndef DAVISRFM69_AFC_TRACKING
+#define DAVISRFM69_AFC_TRACKING 1 // 1: apply per channel frequency offset learned from AFC to FRF
+#endif
+#define RF69_AFC_MAX_HZ   15000 // limit of per channel frequency offset [Hz]
+#define RF69_FSTEP_HZ(steps) ((int32_t)(steps) * 15625 / 256) // frequency synthesizer steps (61.035 Hz) to Hz
+#define RF69_RX_RSSI       0x01 // rxFlags(): RSSI above threshold since receiver start
+#define RF69_RX_SYNC       0x02 // rxFlags(): sync word detected since receiver start
 #define RF69_MODE_SLEEP       0 // XTAL OFF
 #define RF69_MODE_STANDBY     1 // XTAL ON
 #define RF69_MODE_SYNTH       2 // PLL ON
 #define RF69_MODE_RX          3 // RX MODE
 #define RF69_MODE_TX          4 // TX MODE
 
+// Packet record handed over from the radio task (service()) to the main loop
+typedef struct {
+  byte     data[DAVIS_PACKET_LEN];  // payload, bit order already reversed
+  int      rssi;                    // RSSI measured immediately after payload reception
+  byte     channel;                 // channel the packet has been received on
+  boolean  crcOk;                   // CRC has been verified by service() (after correction)
+  byte     corrected;               // bits repaired by CRC error correction, 0: received as sent
+  int64_t  timestampUs;             // esp_timer_get_time() [us] when PayloadReady was signaled
+  int16_t  afc;                     // AFC correction measured on this packet [61 Hz steps], relative to FRF used
+} DavisPacket;
+
+// Handler called by service() for every packet (see setPacketHandler)
+// returns true if it has re-armed the receiver (e.g. setChannel())
+typedef bool (*DavisPacketHandler)(const DavisPacket &packet);
+
+// Handler called from the receive interrupt (see setIrqHandler), must be in IRAM
+typedef void (*DavisIrqHandler)(void);
+
 class DavisRFM69 {
   public:    
     // constructor
@@ -41,130 +77,85 @@ class DavisRFM69 {
       _slaveSelectPin = slaveSelectPin;
       _interruptPin = interruptPin;            
       _mode = RF69_MODE_STANDBY;
-      _packetReceived = false;
-      _hasCrcError = false;
     }    
     // functions
-    uint16_t crc16(void);                                                   // get crc value from last received packet    
+    uint16_t crc16(const DavisPacket &packet);                              // get crc value of a received packet    
     byte channel(void);                                                     // get actual channel 
-    byte data(byte index);                                                  // read byte of receiver data
-    bool receiveDone();                                                     // getter for _packetReceived       
-    void markCrcError(void);                                                // mark current packet has CRC Error
-    boolean getCrcError(void);                                              // get CRC Error State of current packet 
+    bool receivePacket(DavisPacket &packet);                                // take oldest packet from ring, false if empty
+    byte packetsPending(void);                                              // number of packets waiting in ring
+    byte ringHighWater(void);                                               // maximum number of packets waiting in ring
+    uint32_t ringOverflows(void);                                           // number of packets dropped because ring was full
+    void resetRingStats(void);                                              // reset ring high water mark and overflow counter
+    uint16_t verifyShadow(void);                                            // compare shadow cache with chip, return mismatches
+    uint32_t shadowMismatches(void);                                        // number of mismatches found so far
+    bool service(void);                                                     // read packet signaled by the ISR, false if none
+    void setIrqHandler(DavisIrqHandler handler);                            // handler called from ISR: wake task calling service()
+    void setPacketHandler(DavisPacketHandler handler);                      // handler called by service() after each packet
+    void setCorrectionFilter(DavisPacketHandler filter);                    // filter called by service() for repaired packets
     void setChannel(byte channel);                                          // set current channel
+    bool setRegion(byte region);                                            // select frequency table, false if unknown
+    byte region(void);                                                      // selected frequency region
+    byte numChannels(void);                                                 // length of selected frequency table
+    static const char *regionName(byte region);                             // "US", "EU", NULL if unknown
+    int32_t channelOffsetHz(byte channel);                                  // learned frequency offset of channel [Hz]
+    uint32_t channelPackets(byte channel);                                  // packets with correct CRC on channel
+    uint32_t channelCrcErrors(byte channel);                                // packets with CRC error on channel
+    void resetChannelStats(void);                                           // reset per channel packet counters
+    byte rxFlags(void);                                                     // signal detected since receiver start: RF69_RX_xx (task only)
     void hop();                                                             // hot to next channel        
     void init();                                                            // initialize the chip                
     byte readTemperature(byte calFactor=0);                                 // get CMOS temperature (8bit)    
     void rcCalibration(); //calibrate the internal RC oscillator for use in wide temperature variations - see datasheet section [4.3.5. RC Timer Accuracy]    
     void readAllRegs();                                                     // allow debugging registers    
-    int  rssi();                                                            // get RSSI measured immediately after payload reception
     void sleep();                                                           // Switch Mode to Sleep
     void standby();                                                         // Switch Mode to Standby
   
   protected:
     // vars    
-    static volatile byte _data[DAVIS_PACKET_LEN];  // receive buffer    
+    static DavisPacket   _ring[DAVIS_RING_SIZE];   // packet ring, filled by service(), drained by main loop
+    static volatile byte _ringHead;                // free running write index (service() only)
+    static volatile byte _ringTail;                // free running read index (main loop only)
+    static volatile byte _ringHighWater;           // maximum number of packets waiting in ring
+    static volatile uint32_t _ringOverflows;       // packets dropped because ring was full
     static volatile byte _channel;                 // actual channel 
-    static volatile bool _hasCrcError;               // received packet has been transfered to the user
-    static volatile bool _packetReceived;          // a Packet has been received    
-    static volatile int  _rssi;                    // RSSI measured immediately after payload reception
+    static const uint32_t * volatile _frf;         // frequency table of selected region (packed FRF words)
+    static volatile byte _numChannels;             // length of frequency table
+    static byte _region;                           // selected region
+    static int32_t _offset[DAVIS_FREQ_TABLE_MAX];  // per channel frequency offset [1/16 step], moving average of AFC
+    static uint64_t _offsetLearned;                // bit per channel: _offset holds a measurement
+    static int16_t _correction;                    // offset applied to FRF of actual channel [step]
+    static volatile uint32_t _chPackets[DAVIS_FREQ_TABLE_MAX];   // packets with correct CRC per channel
+    static volatile uint32_t _chCrcErrors[DAVIS_FREQ_TABLE_MAX]; // packets with CRC error per channel
+    static DavisPacketHandler _packetHandler;      // called by service() after each packet
+    static DavisIrqHandler _irqHandler;            // called from ISR, wakes the task calling service()
+    static portMUX_TYPE _irqMux;                   // guards _irqPending and _irqUs
+    static volatile bool _irqPending;              // PayloadReady signaled, not yet serviced
+    static volatile int64_t _irqUs;                // esp_timer_get_time() [us] of the last PayloadReady
+    static DavisPacketHandler _correctionFilter;   // accepts or rejects repaired packets
+    static byte _shadow[RF69_SHADOW_SIZE];         // last value written to each register
+    static byte _shadowValid[(RF69_SHADOW_SIZE + 7) / 8]; // bit set: _shadow holds the register value
+    static volatile uint32_t _shadowMismatches;    // shadow entries found different from chip
     static volatile byte _mode;                                             // mode (sleep, Standby, Synth, RX or TX) 
     byte _slaveSelectPin;
     byte _interruptPin;    
     // functions    
-    uint16_t compute_crc16(volatile byte *buf, byte len);                   // calculate the crc value 
     static DavisRFM69* selfPointer;
-    int  readRSSI();                                                        // get RSSI
-    void virtual interruptHandler();
+    void virtual readPacket(int64_t timestampUs);
     static void isr0();
-    byte readReg(byte addr);void receiveBegin();
-    byte reverseBits(byte b);
+    byte readReg(byte addr);
+    void readBurst(byte addr, byte *buf, byte len);                         // read consecutive registers in one transaction
+    void receiveBegin();
     void select();
     void setFrequency(uint32_t FRF);                                        // set Frequency 
     void setMode(byte mode);    
+    void trackOffset(byte channel, int16_t afc);                            // learn frequency offset of channel
     void unselect();    
+    void updateReg(byte addr, byte val);                                    // write register only if shadow differs
+    void verifyReg(byte addr);                                              // compare one shadowed register with chip
     void writeReg(byte addr, byte val);
+    void writeBurst(byte addr, const byte *buf, byte len);                  // write consecutive registers in one transaction
 };
 
-// FRF_MSB, FRF_MID, and FRF_LSB for the 51 North American channels & 5 European channels.
-// used by Davis in frequency hopping
-
-#ifdef DAVIS_FREQS_US
-#warning ** USING NORTH AMERICAN FREQUENCY TABLE **
-#define DAVIS_FREQ_TABLE_LENGTH 51
-static const uint8_t FRF[DAVIS_FREQ_TABLE_LENGTH][3] =
-{
-  {0xE3, 0xDA, 0x7C},
-  {0xE1, 0x98, 0x71},
-  {0xE3, 0xFA, 0x92},
-  {0xE6, 0xBD, 0x01},
-  {0xE4, 0xBB, 0x4D},
-  {0xE2, 0x99, 0x56},
-  {0xE7, 0x7D, 0xBC},
-  {0xE5, 0x9C, 0x0E},
-  {0xE3, 0x39, 0xE6},
-  {0xE6, 0x1C, 0x81},
-  {0xE4, 0x5A, 0xE8},
-  {0xE1, 0xF8, 0xD6},
-  {0xE5, 0x3B, 0xBF},
-  {0xE7, 0x1D, 0x5F},
-  {0xE3, 0x9A, 0x3C},
-  {0xE2, 0x39, 0x00},
-  {0xE4, 0xFB, 0x77},
-  {0xE6, 0x5C, 0xB2},
-  {0xE2, 0xD9, 0x90},
-  {0xE7, 0xBD, 0xEE},
-  {0xE4, 0x3A, 0xD2},
-  {0xE1, 0xD8, 0xAA},
-  {0xE5, 0x5B, 0xCD},
-  {0xE6, 0xDD, 0x34},
-  {0xE3, 0x5A, 0x0A},
-  {0xE7, 0x9D, 0xD9},
-  {0xE2, 0x79, 0x41},
-  {0xE4, 0x9B, 0x28},
-  {0xE5, 0xDC, 0x40},
-  {0xE7, 0x3D, 0x74},
-  {0xE1, 0xB8, 0x9C},
-  {0xE3, 0xBA, 0x60},
-  {0xE6, 0x7C, 0xC8},
-  {0xE4, 0xDB, 0x62},
-  {0xE2, 0xB9, 0x7A},
-  {0xE5, 0x7B, 0xE2},
-  {0xE7, 0xDE, 0x12},
-  {0xE6, 0x3C, 0x9D},
-  {0xE3, 0x19, 0xC9},
-  {0xE4, 0x1A, 0xB6},
-  {0xE5, 0xBC, 0x2B},
-  {0xE2, 0x18, 0xEB},
-  {0xE6, 0xFD, 0x42},
-  {0xE5, 0x1B, 0xA3},
-  {0xE3, 0x7A, 0x2E},
-  {0xE5, 0xFC, 0x64},
-  {0xE2, 0x59, 0x16},
-  {0xE6, 0x9C, 0xEC},
-  {0xE2, 0xF9, 0xAC},
-  {0xE4, 0x7B, 0x0C},
-  {0xE7, 0x5D, 0x98}
-};
-#elif defined (DAVIS_FREQS_EU)
-// #warning ** USING EUROPEAN FREQUENCY TABLE **
-#define DAVIS_FREQ_TABLE_LENGTH 5
-// static const uint8_t __attribute__ ((progmem)) FRF[DAVIS_FREQ_TABLE_LENGTH][3] =
-static const uint8_t FRF[DAVIS_FREQ_TABLE_LENGTH][3] =
-{
-  {0xD9, 0x04, 0x45},
-  {0xD9, 0x13, 0x04},
-  {0xD9, 0x21, 0xC2},
-  {0xD9, 0x0B, 0xA4},
-  {0xD9, 0x1A, 0x63}
-};
-#elif defined (DAVIS_FREQS_AU)
-#error ** ERROR DAVIS FREQS FOR AU ARE NOT KNOWN AT THIS TIME. ONLY US & EU DEFINED **
-#elif defined (DAVIS_FREQS_NZ)
-#error ** ERROR DAVIS FREQS FOR NZ ARE NOT KNOWN AT THIS TIME. ONLY US & EU DEFINED **
-#else
-#error ** ERROR DAVIS_FREQS MUST BE DEFINED AS ONE OF _US, _EU, _AZ, or NZ **
-#endif  // DAVIS_FREQS
 
 // For the packet stats structure used in response to the RXCHECK command
 
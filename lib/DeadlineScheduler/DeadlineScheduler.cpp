@@ -0,0 +1,111 @@
+// Deadline scheduler for the jobs of one task
+
+#include <DeadlineScheduler.h>
+
+
+/************************************************************
+ * Register job
+ * @param[in] job      function to run
+ * @param[in] period   time between runs, 0: run once at the
+ *                     deadline given by at()
+ * @param[in] deadline first run, SCHED_NEVER: not scheduled
+ * @return    id of the job, SCHED_NONE if the table is full
+ ************************************************************/
+uint8_t DeadlineScheduler::add(SchedulerJob job, int64_t period, int64_t deadline) {
+  uint8_t id;
+  if (_count >= SCHED_JOBS_MAX) return SCHED_NONE;
+  id = _count++;
+  _job[id] = job;
+  _period[id] = (period > 0) ? period : 0;
+  _deadline[id] = SCHED_NEVER;
+  at(id, deadline);
+  return id;
+}
+
+
+/************************************************************
+ * Schedule job
+ * - a job already scheduled is moved to the new deadline
+ * @param[in] id       id of the job
+ * @param[in] deadline next run, SCHED_NEVER: cancel
+ ************************************************************/
+void DeadlineScheduler::at(uint8_t id, int64_t deadline) {
+  if (id >= _count) return;
+  if (_deadline[id] != SCHED_NEVER) unlink(id);
+  _deadline[id] = deadline;
+  if (deadline != SCHED_NEVER) link(id);
+}
+
+
+/************************************************************
+ * Deadline of a job
+ * @return SCHED_NEVER if not scheduled
+ ************************************************************/
+int64_t DeadlineScheduler::deadline(uint8_t id) const {
+  return (id < _count) ? _deadline[id] : SCHED_NEVER;
+}
+
+
+/************************************************************
+ * Earliest deadline of all jobs
+ * @return SCHED_NEVER if no job is scheduled
+ ************************************************************/
+int64_t DeadlineScheduler::next(void) const {
+  return (_head != SCHED_NONE) ? _deadline[_head] : SCHED_NEVER;
+}
+
+
+/************************************************************
+ * Run due jobs, earliest deadline first
+ * - periodic jobs are scheduled again before they run, so a
+ *   job may change its own deadline by at()
+ * - each call runs at most as many jobs as are registered, a
+ *   job scheduled again at or before now by another job runs
+ *   with the next call
+ * @param[in] now current time
+ * @return    number of jobs run
+ ************************************************************/
+uint8_t DeadlineScheduler::run(int64_t now) {
+  uint8_t id;
+  uint8_t n = 0;
+  int64_t d;
+  while ((n < _count) && (_head != SCHED_NONE) && (_deadline[_head] <= now)) {
+    id = _head;
+    unlink(id);
+    if (_period[id]) {
+      d = _deadline[id] + _period[id];
+      if (d <= now) d = now + _period[id];            // fell behind: skip missed runs
+      _deadline[id] = d;
+      link(id);
+    } else {
+      _deadline[id] = SCHED_NEVER;
+    }
+    _job[id]();
+    n++;
+  }
+  return n;
+}
+
+
+/************************************************************
+ * Insert job into the list, ordered by deadline, then by id
+ ************************************************************/
+void DeadlineScheduler::link(uint8_t id) {
+  uint8_t *p = &_head;
+  while ((*p != SCHED_NONE) && 
+         ((_deadline[*p] < _deadline[id]) || ((_deadline[*p] == _deadline[id]) && (*p < id)))) {
+    p = &_next[*p];
+  }
+  _next[id] = *p;
+  *p = id;
+}
+
+
+/************************************************************
+ * Remove job from the list
+ ************************************************************/
+void DeadlineScheduler::unlink(uint8_t id) {
+  uint8_t *p = &_head;
+  while ((*p != SCHED_NONE) && (*p != id)) p = &_next[*p];
+  if (*p == id) *p = _next[id];
+}
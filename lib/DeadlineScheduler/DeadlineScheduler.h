@@ -0,0 +1,47 @@
+// Deadline scheduler for the jobs of one task
+//
+// - Jobs are registered once (fixed table, no heap) and kept in
+//   a list ordered by deadline, so the next deadline is known at
+//   once and the task can sleep until then
+// - Periodic jobs are scheduled again by their period from their
+//   deadline, so they do not drift; if the task fell behind by
+//   more than a period, the missed runs are skipped
+// - Jobs without period run once at the deadline given by at(),
+//   e.g. a deadline taken from other state (hop, batch flush)
+// - Jobs due at the same time run in the order they were added
+// - Time is given by the caller (e.g. esp_timer_get_time() [us])
+// - Only depends on <stdint.h>, so host side tools can use it as well
+
+#ifndef DEADLINESCHEDULER_h
+#define DEADLINESCHEDULER_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SCHED_JOBS_MAX            8 // most jobs of a scheduler
+#define SCHED_NONE             0xff // no job (end of list, table full)
+#define SCHED_NEVER       INT64_MAX // deadline of a job not scheduled
+
+typedef void (*SchedulerJob)(void);
+
+class DeadlineScheduler {
+  public:
+    uint8_t  add(SchedulerJob job, int64_t period, int64_t deadline = SCHED_NEVER); // register job (period 0: once), return id, SCHED_NONE if full
+    void     at(uint8_t id, int64_t deadline);                             // (re)schedule job, SCHED_NEVER: cancel
+    int64_t  deadline(uint8_t id) const;                                    // deadline of job, SCHED_NEVER if not scheduled
+    int64_t  next(void) const;                                              // earliest deadline, SCHED_NEVER if none
+    uint8_t  run(int64_t now);                                              // run due jobs, return number of jobs run
+
+  protected:
+    SchedulerJob _job[SCHED_JOBS_MAX];
+    int64_t  _period[SCHED_JOBS_MAX];
+    int64_t  _deadline[SCHED_JOBS_MAX];
+    uint8_t  _next[SCHED_JOBS_MAX];      // list ordered by deadline
+    uint8_t  _head = SCHED_NONE;         // job with the earliest deadline
+    uint8_t  _count = 0;                 // jobs registered
+
+    void link(uint8_t id);
+    void unlink(uint8_t id);
+};
+
+#endif  // DEADLINESCHEDULER_h
@@ -0,0 +1,113 @@
+// Compact (CBOR) layout of the ISS messages (topics ISS/1 - ISS/8)
+//
+// - One CBOR map per message, keyed by the small integers below
+//   instead of the JSON member names; key ISS_KEY_VERSION comes
+//   first and holds ISS_CBOR_VERSION
+// - Values as in the JSON message, but:
+//   - fixed point values as decimal fractions 4([-decimals, value])
+//   - "Payload" as byte string (8 bytes instead of 23 characters)
+//   - "Receiver Status" as index of ISS_RECEIVER_STATUS_NAMES
+// - Shared by the gateway and the host side decoder (tools/iss_decode),
+//   which turns a message back into the JSON message
+// - Keys are only added at the end; ISS_CBOR_VERSION changes when
+//   the meaning of a key changes
+
+#ifndef ISSCBOR_h
+#define ISSCBOR_h
+
+#include <stdint.h>
+
+#define ISS_CBOR_VERSION          1
+
+// Keys (member order of the JSON message)
+#define ISS_KEY_VERSION           0 // layout version, not part of the JSON message
+#define ISS_KEY_WINDSPEED         1
+#define ISS_KEY_WINDDIRECTION     2
+#define ISS_KEY_BATTWARNING       3
+#define ISS_KEY_PAYLOAD           4
+#define ISS_KEY_CHANNEL           5
+#define ISS_KEY_RSSI              6
+#define ISS_KEY_RXTIME            7
+#define ISS_KEY_SYNCTIME          8
+#define ISS_KEY_TIMESTAMP         9
+#define ISS_KEY_CORRECTED        10
+#define ISS_KEY_MSGID            11
+#define ISS_KEY_GOLDCAP          12
+#define ISS_KEY_RAINRATE         13
+#define ISS_KEY_SOLAR            14
+#define ISS_KEY_TEMPERATURE      15
+#define ISS_KEY_GUSTSPEED        16
+#define ISS_KEY_HUMIDITY         17
+#define ISS_KEY_RAINCLICKS       18
+#define ISS_KEY_RAINCLICKS_DAY   19
+#define ISS_KEY_RAINCLICKS_SUM   20
+#define ISS_KEY_MILLIS           21
+#define ISS_KEY_SINCE_LAST_RX    22
+#define ISS_KEY_PACKETS          23
+#define ISS_KEY_CRC_ERRORS       24
+#define ISS_KEY_CRC_CORRECTED    25
+#define ISS_KEY_AUTO_HOPS        26
+#define ISS_KEY_BLACKOUTS        27
+#define ISS_KEY_LONGEST_BLACKOUT 28
+#define ISS_KEY_STREAK           29
+#define ISS_KEY_STREAK_MAX       30
+#define ISS_KEY_RX_STATUS        31
+#define ISS_KEY_NUM              32
+
+// How a value is turned back into JSON
+#define ISS_FIELD_PLAIN           0 // as decoded
+#define ISS_FIELD_HEX             1 // byte string as "80:00:b2"
+#define ISS_FIELD_RX_STATUS       2 // index of ISS_RECEIVER_STATUS_NAMES
+
+// Receiver Status (ISS_KEY_RX_STATUS)
+#define ISS_RX_STATUS_OK          0 // less than 3 Packets missed
+#define ISS_RX_STATUS_WARNING     1 // 4 to 20 Packets missed
+#define ISS_RX_STATUS_ERROR       2 // more than one Minute without Data
+#define ISS_RX_STATUS_NUM         3
+const char * const ISS_RECEIVER_STATUS_NAMES[ISS_RX_STATUS_NUM] = {
+  "OK",
+  "Warning (4 to 20 Packets missed)",
+  "Error (more than one Minute without Data)"
+};
+
+// Member names of the JSON message, index: ISS_KEY_xx
+typedef struct {
+  const char *name;
+  uint8_t     format;                       // ISS_FIELD_xx
+} IssCborField;
+const IssCborField ISS_CBOR_FIELDS[ISS_KEY_NUM] = {
+  { "Version",                          ISS_FIELD_PLAIN     },
+  { "WindSpeed",                        ISS_FIELD_PLAIN     },
+  { "WindDirection",                    ISS_FIELD_PLAIN     },
+  { "BattWarning",                      ISS_FIELD_PLAIN     },
+  { "Payload",                          ISS_FIELD_HEX       },
+  { "Channel",                          ISS_FIELD_PLAIN     },
+  { "RSSI",                             ISS_FIELD_PLAIN     },
+  { "RxTime",                           ISS_FIELD_PLAIN     },
+  { "SyncTime",                         ISS_FIELD_PLAIN     },
+  { "Timestamp",                        ISS_FIELD_PLAIN     },
+  { "Corrected",                        ISS_FIELD_PLAIN     },
+  { "msgID",                            ISS_FIELD_PLAIN     },
+  { "GoldcapVoltage",                   ISS_FIELD_PLAIN     },
+  { "Rainrate",                         ISS_FIELD_PLAIN     },
+  { "SolarRadiation",                   ISS_FIELD_PLAIN     },
+  { "OutsideTemperature",               ISS_FIELD_PLAIN     },
+  { "GustSpeed",                        ISS_FIELD_PLAIN     },
+  { "OutsideHumidity",                  ISS_FIELD_PLAIN     },
+  { "RainClicks",                       ISS_FIELD_PLAIN     },
+  { "RainClicksDay",                    ISS_FIELD_PLAIN     },
+  { "RainClicksSum",                    ISS_FIELD_PLAIN     },
+  { "millis",                           ISS_FIELD_PLAIN     },
+  { "Time before Last Packet received", ISS_FIELD_PLAIN     },
+  { "Packets received",                 ISS_FIELD_PLAIN     },
+  { "CRC-Errors",                       ISS_FIELD_PLAIN     },
+  { "CRC-Corrected",                    ISS_FIELD_PLAIN     },
+  { "Automatic Hops",                   ISS_FIELD_PLAIN     },
+  { "Blackouts",                        ISS_FIELD_PLAIN     },
+  { "Longest Blackout",                 ISS_FIELD_PLAIN     },
+  { "Receive Streak",                   ISS_FIELD_PLAIN     },
+  { "Longest Receive Streak",           ISS_FIELD_PLAIN     },
+  { "Receiver Status",                  ISS_FIELD_RX_STATUS }
+};
+
+#endif  // ISSCBOR_h
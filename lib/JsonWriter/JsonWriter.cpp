@@ -0,0 +1,314 @@
+// Streaming JSON writer over a fixed buffer
+
+#include <JsonWriter.h>
+#include <string.h>
+
+// Digit pairs, generated by the compiler
+static constexpr JsonDigitPairs DIGITS = jsonMakeDigitPairs();
+
+static_assert(jsonMakeDigitPairs().d[0] == '0', "digit pair table broken");
+static_assert(jsonMakeDigitPairs().d[2 * 42 + 1] == '2', "digit pair table broken");
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+
+/************************************************************
+ * Constructor
+ * @param[in] buf  output buffer, owned by the caller
+ * @param[in] size size of buffer (including terminating 0)
+ ************************************************************/
+JsonWriter::JsonWriter(char *buf, size_t size) {
+  _buf = buf;
+  _size = size;
+  reset();
+}
+
+
+/************************************************************
+ * Start a new document
+ ************************************************************/
+void JsonWriter::reset(void) {
+  _len = 0;
+  _overflow = (_size == 0);
+  _depth = 0;
+  if (_size) _buf[0] = 0;
+}
+
+
+/************************************************************
+ * Append one character
+ * - stops at the first character not fitting into the buffer
+ ************************************************************/
+void JsonWriter::put(char c) {
+  if (_overflow) return;
+  if (_len + 1 >= _size) {
+    _overflow = true;
+    return;
+  }
+  _buf[_len++] = c;
+  _buf[_len] = 0;
+}
+
+
+/************************************************************
+ * Append characters
+ * - nothing is appended if they do not fit completely
+ ************************************************************/
+void JsonWriter::put(const char *s, size_t len) {
+  if (_overflow) return;
+  if (_len + len >= _size) {
+    _overflow = true;
+    return;
+  }
+  memcpy(_buf + _len, s, len);
+  _len += len;
+  _buf[_len] = 0;
+}
+
+
+/************************************************************
+ * Append a string in quotes
+ * - '"', '\' and control characters are escaped
+ ************************************************************/
+void JsonWriter::putString(const char *s) {
+  put('"');
+  while (s && *s) {
+    // copy characters not needing an escape in one go
+    const char *start = s;
+    while (*s && (*s != '"') && (*s != '\\') && ((uint8_t)*s >= 0x20)) s++;
+    put(start, (size_t)(s - start));
+    if (!*s) break;
+    char esc[6] = { '\\', *s, 0, 0, 0, 0 };
+    size_t len = 2;
+    if ((uint8_t)*s < 0x20) {
+      esc[1] = 'u';
+      esc[2] = '0';
+      esc[3] = '0';
+      esc[4] = HEX_DIGITS[(uint8_t)*s >> 4];
+      esc[5] = HEX_DIGITS[*s & 0x0f];
+      len = 6;
+    }
+    put(esc, len);
+    s++;
+  }
+  put('"');
+}
+
+
+/************************************************************
+ * Start next member
+ * - comma if the enclosing object or array has members already
+ * @param[in] key name of member, NULL: array element or top level
+ ************************************************************/
+void JsonWriter::member(const char *key) {
+  if (_depth > 0) {
+    if (_members[_depth - 1]) put(',');
+    _members[_depth - 1] = true;
+  }
+  if (key) {
+    putString(key);
+    put(':');
+  }
+}
+
+
+/************************************************************
+ * Begin / end object and array
+ * @param[in] key name of member, NULL: array element or top level
+ ************************************************************/
+void JsonWriter::beginObject(const char *key) {
+  member(key);
+  put('{');
+  if (_depth < JSON_WRITER_MAX_DEPTH) {
+    _members[_depth++] = false;
+  } else {
+    _overflow = true;
+  }
+}
+
+void JsonWriter::endObject(void) {
+  put('}');
+  if (_depth) _depth--;
+}
+
+void JsonWriter::beginArray(const char *key) {
+  member(key);
+  put('[');
+  if (_depth < JSON_WRITER_MAX_DEPTH) {
+    _members[_depth++] = false;
+  } else {
+    _overflow = true;
+  }
+}
+
+void JsonWriter::endArray(void) {
+  put(']');
+  if (_depth) _depth--;
+}
+
+
+/************************************************************
+ * Add numbers
+ * @param[in] key   name of member, NULL: array element
+ * @param[in] value value
+ ************************************************************/
+void JsonWriter::addInt(const char *key, int32_t value) {
+  addInt64(key, value);
+}
+
+void JsonWriter::addUInt(const char *key, uint32_t value) {
+  char num[JSON_WRITER_NUM_LEN];
+  member(key);
+  put(num, formatUInt64(value, num));
+}
+
+void JsonWriter::addInt64(const char *key, int64_t value) {
+  char num[JSON_WRITER_NUM_LEN];
+  member(key);
+  put(num, formatInt64(value, num));
+}
+
+
+/************************************************************
+ * Add fixed point number
+ * @param[in] key      name of member, NULL: array element
+ * @param[in] value    value [10^-decimals], e.g. 2150
+ * @param[in] decimals number of decimals, e.g. 2: 21.50
+ ************************************************************/
+void JsonWriter::addFixed(const char *key, int32_t value, uint8_t decimals) {
+  char num[JSON_WRITER_NUM_LEN];
+  member(key);
+  put(num, formatFixed(value, decimals, num));
+}
+
+
+/************************************************************
+ * Add string, escaped
+ * @param[in] key   name of member, NULL: array element
+ * @param[in] value text (NULL: empty string)
+ ************************************************************/
+void JsonWriter::addString(const char *key, const char *value) {
+  member(key);
+  putString(value);
+}
+
+
+/************************************************************
+ * Add bytes as string of hex digits, e.g. "80:00:b2"
+ * @param[in] key  name of member, NULL: array element
+ * @param[in] data bytes
+ * @param[in] len  number of bytes
+ * @param[in] sep  separator between bytes, 0: none
+ ************************************************************/
+void JsonWriter::addHex(const char *key, const uint8_t *data, size_t len, char sep) {
+  member(key);
+  put('"');
+  for (size_t i = 0; i < len; i++) {
+    char hex[3] = { HEX_DIGITS[data[i] >> 4], HEX_DIGITS[data[i] & 0x0f], sep };
+    put(hex, (sep && (i < len - 1)) ? 3 : 2);
+  }
+  put('"');
+}
+
+
+/************************************************************
+ * Add null
+ * @param[in] key name of member, NULL: array element
+ ************************************************************/
+void JsonWriter::addNull(const char *key) {
+  member(key);
+  put("null", 4);
+}
+
+
+/************************************************************
+ * Format unsigned integer
+ * - two digits per division, 32 bit divisions while possible
+ * @param[in]  value value
+ * @param[out] buf   at least JSON_WRITER_NUM_LEN bytes
+ * @return     length of text (buf is terminated)
+ ************************************************************/
+size_t JsonWriter::formatUInt64(uint64_t value, char *buf) {
+  char tmp[JSON_WRITER_NUM_LEN];
+  char *p = tmp + sizeof(tmp);
+  while (value > 0xFFFFFFFFu) {
+    uint32_t pair = (uint32_t)(value % 100);
+    value /= 100;
+    *--p = DIGITS.d[2 * pair + 1];
+    *--p = DIGITS.d[2 * pair];
+  }
+  uint32_t v = (uint32_t)value;
+  while (v >= 100) {
+    uint32_t pair = v % 100;
+    v /= 100;
+    *--p = DIGITS.d[2 * pair + 1];
+    *--p = DIGITS.d[2 * pair];
+  }
+  if (v >= 10) {
+    *--p = DIGITS.d[2 * v + 1];
+    *--p = DIGITS.d[2 * v];
+  } else {
+    *--p = (char)('0' + v);
+  }
+  size_t len = (size_t)(tmp + sizeof(tmp) - p);
+  memcpy(buf, p, len);
+  buf[len] = 0;
+  return len;
+}
+
+
+/************************************************************
+ * Format signed integer
+ * @param[in]  value value
+ * @param[out] buf   at least JSON_WRITER_NUM_LEN bytes
+ * @return     length of text (buf is terminated)
+ ************************************************************/
+size_t JsonWriter::formatInt64(int64_t value, char *buf) {
+  if (value < 0) {
+    buf[0] = '-';
+    return 1 + formatUInt64((uint64_t)0 - (uint64_t)value, buf + 1);
+  }
+  return formatUInt64((uint64_t)value, buf);
+}
+
+
+/************************************************************
+ * Format fixed point number
+ * - always at least one digit before the decimal point,
+ *   e.g. -5, 2: "-0.05"
+ * @param[in]  value    value [10^-decimals]
+ * @param[in]  decimals number of decimals (max 9)
+ * @param[out] buf      at least JSON_WRITER_NUM_LEN bytes
+ * @return     length of text (buf is terminated)
+ ************************************************************/
+size_t JsonWriter::formatFixed(int32_t value, uint8_t decimals, char *buf) {
+  char digits[JSON_WRITER_NUM_LEN];
+  size_t len = 0;
+  uint32_t v;
+  if (decimals > 9) decimals = 9;
+  if (value < 0) {
+    buf[len++] = '-';
+    v = (uint32_t)0 - (uint32_t)value;
+  } else {
+    v = (uint32_t)value;
+  }
+  size_t n = formatUInt64(v, digits);
+  if (n <= decimals) {
+    // leading zeros: "0.0..."
+    buf[len++] = '0';
+    buf[len++] = '.';
+    for (size_t i = n; i < decimals; i++) buf[len++] = '0';
+    memcpy(buf + len, digits, n);
+    len += n;
+  } else {
+    memcpy(buf + len, digits, n - decimals);
+    len += n - decimals;
+    if (decimals) {
+      buf[len++] = '.';
+      memcpy(buf + len, digits + n - decimals, decimals);
+      len += decimals;
+    }
+  }
+  buf[len] = 0;
+  return len;
+}
@@ -0,0 +1,76 @@
+// Streaming JSON writer over a fixed buffer
+//
+// - Renders objects and arrays into a buffer given by the caller,
+//   no heap allocation at all
+// - Commas between members are inserted automatically
+// - Integers are formatted two digits at a time (constexpr table),
+//   fixed point values with a given number of decimals
+// - If the buffer is too small, writing stops, overflow() is set
+//   and the buffer holds the (truncated) text written so far
+// - Only depends on <stdint.h>, so host side tools can use it as well
+
+#ifndef JSONWRITER_h
+#define JSONWRITER_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define JSON_WRITER_MAX_DEPTH     8 // maximum nesting of objects and arrays
+#define JSON_WRITER_NUM_LEN      24 // buffer size for formatInt() / formatFixed()
+
+// Digit pairs "00" - "99" for integer formatting
+struct JsonDigitPairs {
+  char d[200];
+};
+
+/************************************************************
+ * Generate digit pair table at compile time
+ ************************************************************/
+constexpr JsonDigitPairs jsonMakeDigitPairs(void) {
+  JsonDigitPairs tab{};
+  for (int i = 0; i < 100; i++) {
+    tab.d[2 * i] = (char)('0' + i / 10);
+    tab.d[2 * i + 1] = (char)('0' + i % 10);
+  }
+  return tab;
+}
+
+class JsonWriter {
+  public:
+    JsonWriter(char *buf, size_t size);
+
+    void        reset(void);                                                // start a new document
+    void        beginObject(const char *key = NULL);                       // "{" (key: member of enclosing object)
+    void        endObject(void);                                           // "}"
+    void        beginArray(const char *key = NULL);                        // "["
+    void        endArray(void);                                            // "]"
+    void        addInt(const char *key, int32_t value);                    // 42, -7
+    void        addUInt(const char *key, uint32_t value);                  // 4294967295
+    void        addInt64(const char *key, int64_t value);                  // e.g. esp_timer_get_time()
+    void        addFixed(const char *key, int32_t value, uint8_t decimals); // value / 10^decimals: 2150, 2 -> 21.50
+    void        addString(const char *key, const char *value);             // "text", escaped
+    void        addHex(const char *key, const uint8_t *data, size_t len, char sep); // "80:00:b2"
+    void        addNull(const char *key);                                  // null
+    const char *c_str(void) const { return _buf; }                         // rendered text, always terminated
+    size_t      length(void) const { return _len; }                        // length of rendered text
+    bool        overflow(void) const { return _overflow; }                 // buffer was too small
+
+    static size_t formatUInt64(uint64_t value, char *buf);                 // decimal, return length
+    static size_t formatInt64(int64_t value, char *buf);                   // decimal with sign, return length
+    static size_t formatFixed(int32_t value, uint8_t decimals, char *buf); // "-0.05", return length
+
+  protected:
+    char    *_buf;                        // output buffer
+    size_t   _size;                       // size of output buffer
+    size_t   _len;                        // characters written
+    bool     _overflow;                   // buffer was too small
+    uint8_t  _depth;                      // nesting level
+    bool     _members[JSON_WRITER_MAX_DEPTH]; // level has members already (comma needed)
+
+    void put(char c);
+    void put(const char *s, size_t len);
+    void putString(const char *s);
+    void member(const char *key);         // comma and key of next member
+};
+
+#endif  // JSONWRITER_h
@@ -0,0 +1,299 @@
+// MQTT 3.1.1 session on a connection set up by MqttTransport
+
+#include <MqttSession.h>
+
+#define RX_TYPE    0 // waiting for the first byte of a packet
+#define RX_LENGTH  1 // remaining length
+#define RX_BODY    2 // variable header and payload, into the buffer
+#define RX_SKIP    3 // packet longer than the buffer, discarded
+
+#define PKT_PUBLISH    0x30
+#define PKT_PUBACK     0x40
+#define PKT_SUBSCRIBE  0x82
+#define PKT_PINGREQ    0xC0
+#define PKT_PINGRESP   0xD0
+
+#define HEADER_MAX        5 // fixed header: type and up to 4 bytes remaining length
+#define REM_MAX  0x0fffffff // longest remaining length
+
+
+/************************************************************
+ * Take over the session
+ * - the CONNACK has been accepted (MqttTransport::pollConnack())
+ * @param[in] keepAlive [s] as sent in the CONNECT, 0: no pings
+ ************************************************************/
+void MqttSession::begin(uint16_t keepAlive) {
+  _state = MQTT_SESSION_CONNECTED;
+  _keepAliveMs = (uint32_t)keepAlive * 1000;
+  _lastIn = millis();
+  _lastOut = _lastIn;
+  _pingOutstanding = false;
+  _publishFailed = false;
+  _rxStep = RX_TYPE;
+}
+
+
+/************************************************************
+ * Forget the session, the connection is closed by the owner
+ ************************************************************/
+void MqttSession::end(void) {
+  _state = MQTT_SESSION_DISCONNECTED;
+  _rxStep = RX_TYPE;
+}
+
+
+/************************************************************
+ * Session up and connection open
+ * - notices a closed connection (MQTT_SESSION_LOST)
+ ************************************************************/
+bool MqttSession::connected(void) {
+  if (_state != MQTT_SESSION_CONNECTED) return false;
+  if (!_client.connected()) {
+    lost(MQTT_SESSION_LOST);
+    return false;
+  }
+  return true;
+}
+
+
+/************************************************************
+ * Subscribe, QoS 0
+ * - the SUBACK is not waited for
+ * @param[in] topic topic filter
+ * @return false if not connected, topic too long or write failed
+ ************************************************************/
+bool MqttSession::subscribe(const char *topic) {
+  uint8_t buf[HEADER_MAX + 4 + MQTT_SESSION_TOPIC_MAX + 1];
+  size_t tl = strlen(topic);
+  size_t n;
+  if (!connected() || (tl > MQTT_SESSION_TOPIC_MAX)) return false;
+  if (++_nextMsgId == 0) _nextMsgId = 1;
+  n = putHeader(buf, PKT_SUBSCRIBE, 2 + 2 + tl + 1);
+  buf[n++] = (uint8_t)(_nextMsgId >> 8);
+  buf[n++] = (uint8_t)_nextMsgId;
+  buf[n++] = (uint8_t)(tl >> 8);
+  buf[n++] = (uint8_t)tl;
+  memcpy(buf + n, topic, tl);
+  n += tl;
+  buf[n++] = 0;                                      // requested QoS
+  return send(buf, n);
+}
+
+
+/************************************************************
+ * Begin PUBLISH, QoS 0
+ * - writes fixed header and topic, the payload follows by
+ *   write(), exactly len bytes
+ * @param[in] topic topic
+ * @param[in] len payload length [bytes]
+ * @param[in] retain retain flag
+ * @return false if not connected, topic too long or write failed
+ ************************************************************/
+bool MqttSession::beginPublish(const char *topic, size_t len, bool retain) {
+  uint8_t buf[HEADER_MAX + 2 + MQTT_SESSION_TOPIC_MAX];
+  size_t tl = strlen(topic);
+  size_t n;
+  if (!connected() || (tl > MQTT_SESSION_TOPIC_MAX) || (len > REM_MAX - 2 - tl)) return false;
+  n = putHeader(buf, PKT_PUBLISH | (retain ? 0x01 : 0x00), 2 + tl + len);
+  buf[n++] = (uint8_t)(tl >> 8);
+  buf[n++] = (uint8_t)tl;
+  memcpy(buf + n, topic, tl);
+  n += tl;
+  _publishFailed = !send(buf, n);
+  return !_publishFailed;
+}
+
+
+/************************************************************
+ * Payload of the PUBLISH begun by beginPublish()
+ * @return bytes written
+ ************************************************************/
+size_t MqttSession::write(const uint8_t *buf, size_t len) {
+  size_t n = _client.write(buf, len);
+  if (n == len) {
+    _lastOut = millis();
+  } else {
+    _publishFailed = true;
+  }
+  return n;
+}
+
+
+/************************************************************
+ * End PUBLISH
+ * @return false if the header or a part of the payload could
+ *         not be written
+ ************************************************************/
+bool MqttSession::endPublish(void) {
+  return !_publishFailed;
+}
+
+
+/************************************************************
+ * Keep alive and incoming packets, never waits
+ * - PINGREQ after keepAlive without a packet sent or received,
+ *   no packet received another keepAlive later: connection
+ *   closed (MQTT_SESSION_TIMEOUT)
+ * - reads the bytes available only, a packet may be assembled
+ *   over several calls; complete packets see dispatch()
+ * @return false if not connected
+ ************************************************************/
+bool MqttSession::loop(void) {
+  uint8_t scratch[64];
+  uint32_t now = millis();
+  int avail;
+  int n;
+  if (!connected()) return false;
+  // keep alive
+  if (_keepAliveMs && ((now - _lastIn > _keepAliveMs) || (now - _lastOut > _keepAliveMs))) {
+    if (_pingOutstanding) {
+      lost(MQTT_SESSION_TIMEOUT);
+      return false;
+    }
+    const uint8_t ping[] = { PKT_PINGREQ, 0x00 };
+    if (!send(ping, sizeof(ping))) {
+      lost(MQTT_SESSION_LOST);
+      return false;
+    }
+    _lastIn = now;
+    _pingOutstanding = true;
+  }
+  // incoming bytes
+  while ((_state == MQTT_SESSION_CONNECTED) && ((avail = _client.available()) > 0)) {
+    switch (_rxStep) {
+      case RX_TYPE:
+        n = _client.read();
+        if (n < 0) return true;
+        _rxType = (uint8_t)n;
+        _rxLen = 0;
+        _rxShift = 0;
+        _rxPos = 0;
+        _rxStep = RX_LENGTH;
+        break;
+      case RX_LENGTH:
+        n = _client.read();
+        if (n < 0) return true;
+        _rxLen |= (uint32_t)(n & 0x7f) << _rxShift;
+        _rxShift += 7;
+        if (n & 0x80) {
+          if (_rxShift >= 28) lost(MQTT_SESSION_LOST);   // more than 4 bytes: malformed
+        } else if (_rxLen == 0) {
+          _rxStep = RX_TYPE;
+          dispatch();
+        } else {
+          _rxStep = (_rxLen <= _bufSize) ? RX_BODY : RX_SKIP;
+        }
+        break;
+      case RX_BODY:
+        if ((uint32_t)avail > _rxLen - _rxPos) avail = (int)(_rxLen - _rxPos);
+        n = _client.read(_buf + _rxPos, (size_t)avail);
+        if (n <= 0) return true;
+        _rxPos += (uint32_t)n;
+        if (_rxPos == _rxLen) {
+          _rxStep = RX_TYPE;
+          dispatch();
+        }
+        break;
+      case RX_SKIP:
+        if ((uint32_t)avail > _rxLen - _rxPos) avail = (int)(_rxLen - _rxPos);
+        if (avail > (int)sizeof(scratch)) avail = sizeof(scratch);
+        n = _client.read(scratch, (size_t)avail);
+        if (n <= 0) return true;
+        _rxPos += (uint32_t)n;
+        if (_rxPos == _rxLen) {
+          _rxStep = RX_TYPE;
+          _lastIn = millis();
+          _dropped++;
+        }
+        break;
+    }
+  }
+  return _state == MQTT_SESSION_CONNECTED;
+}
+
+
+/************************************************************
+ * Packet received completely (in the buffer)
+ * - PUBLISH: topic terminated in place (moved by 2 bytes over
+ *   its length), handed to the callback with the payload;
+ *   QoS 1 acknowledged, QoS 2 ignored (never subscribed)
+ * - PINGREQ answered, PINGRESP ends the ping outstanding
+ * - SUBACK and all others ignored
+ ************************************************************/
+void MqttSession::dispatch(void) {
+  uint8_t qos = (_rxType >> 1) & 0x03;
+  uint32_t tl;
+  uint32_t pos;
+  uint16_t msgId = 0;
+  _lastIn = millis();
+  switch (_rxType & 0xf0) {
+    case PKT_PUBLISH:
+      if ((_rxLen < 2) || (qos > 1)) break;
+      tl = ((uint32_t)_buf[0] << 8) | _buf[1];
+      pos = 2 + tl;
+      if (qos) {
+        if (pos + 2 > _rxLen) break;
+        msgId = (uint16_t)((_buf[pos] << 8) | _buf[pos + 1]);
+        pos += 2;
+      }
+      if (pos > _rxLen) break;
+      memmove(_buf, _buf + 2, tl);
+      _buf[tl] = 0;
+      if (_callback) _callback((char *)_buf, _buf + pos, _rxLen - pos);
+      if (qos) {
+        const uint8_t ack[] = { PKT_PUBACK, 0x02, (uint8_t)(msgId >> 8), (uint8_t)msgId };
+        if (!send(ack, sizeof(ack))) lost(MQTT_SESSION_LOST);
+      }
+      break;
+    case PKT_PINGREQ: {
+        const uint8_t pong[] = { PKT_PINGRESP, 0x00 };
+        if (!send(pong, sizeof(pong))) lost(MQTT_SESSION_LOST);
+      }
+      break;
+    case PKT_PINGRESP:
+      _pingOutstanding = false;
+      break;
+    default:
+      break;
+  }
+}
+
+
+/************************************************************
+ * Fixed header: packet type and remaining length
+ * @return length of the header [bytes] (2 - 5)
+ ************************************************************/
+size_t MqttSession::putHeader(uint8_t *buf, uint8_t type, uint32_t rem) {
+  size_t n = 0;
+  uint8_t b;
+  buf[n++] = type;
+  do {
+    b = rem & 0x7f;
+    rem >>= 7;
+    if (rem) b |= 0x80;
+    buf[n++] = b;
+  } while (rem);
+  return n;
+}
+
+
+/************************************************************
+ * Write a packet (or its first part) in one piece
+ * @return false if not written completely
+ ************************************************************/
+bool MqttSession::send(const uint8_t *buf, size_t len) {
+  if (_client.write(buf, len) != len) return false;
+  _lastOut = millis();
+  return true;
+}
+
+
+/************************************************************
+ * Session lost: close connection
+ * @param[in] state MQTT_SESSION_TIMEOUT or MQTT_SESSION_LOST
+ ************************************************************/
+void MqttSession::lost(int8_t state) {
+  _state = state;
+  _rxStep = RX_TYPE;
+  _client.stop();
+}
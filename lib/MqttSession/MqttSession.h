@@ -0,0 +1,74 @@
+// MQTT 3.1.1 session on a connection set up by MqttTransport
+//
+// - MqttTransport opens the TCP connection and does the handshake
+//   (CONNECT, CONNACK) without blocking; begin() takes over the
+//   session once the CONNACK has been accepted, there is no
+//   connect() here
+// - Publishes QoS 0, streamed: beginPublish(), write(), endPublish()
+// - Subscribes QoS 0; incoming PUBLISH packets (QoS 0, QoS 1 is
+//   acknowledged) are handed to the callback
+// - loop() never waits: incoming packets are assembled from the
+//   bytes available, over as many calls as needed
+// - Keep alive: PINGREQ after keepAlive without traffic, the
+//   connection is closed (MQTT_SESSION_TIMEOUT) if nothing has
+//   been received another keepAlive later
+// - Receive buffer given by the owner, no heap; longer packets are
+//   skipped (counted by dropped())
+
+#ifndef MQTTSESSION_h
+#define MQTTSESSION_h
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define MQTT_SESSION_TIMEOUT      -4 // no answer to PINGREQ
+#define MQTT_SESSION_LOST         -3 // connection closed, malformed packet or write failed
+#define MQTT_SESSION_DISCONNECTED -1 // not started or ended by end()
+#define MQTT_SESSION_CONNECTED     0 // session up
+
+#define MQTT_SESSION_TOPIC_MAX   128 // longest topic published or subscribed [bytes]
+
+typedef void (*MqttSessionCallback)(char *topic, uint8_t *payload, unsigned int length);
+
+class MqttSession {
+  public:
+    MqttSession(Client &client, uint8_t *buf, size_t bufSize) : _client(client), _buf(buf), _bufSize(bufSize) {}
+    void     setCallback(MqttSessionCallback cb) { _callback = cb; }
+    void     begin(uint16_t keepAlive);                            // CONNACK accepted: session up, keepAlive [s] as sent in CONNECT
+    void     end(void);                                            // forget session (connection closed by the owner)
+    bool     connected(void);                                      // session up and connection open
+    int8_t   state(void) const { return _state; }                  // MQTT_SESSION_xx
+    uint32_t dropped(void) const { return _dropped; }              // incoming packets longer than the buffer
+    bool     subscribe(const char *topic);                         // SUBSCRIBE QoS 0, false on error
+    bool     beginPublish(const char *topic, size_t len, bool retain); // PUBLISH QoS 0 header, false on error
+    size_t   write(const uint8_t *buf, size_t len);                // payload of the PUBLISH begun
+    bool     endPublish(void);                                     // false if a part of the PUBLISH failed
+    bool     loop(void);                                           // keep alive, incoming packets; false if not connected
+
+  protected:
+    Client              &_client;
+    uint8_t             *_buf;                 // incoming packet (variable header and payload)
+    size_t               _bufSize;
+    MqttSessionCallback  _callback = NULL;
+    int8_t               _state = MQTT_SESSION_DISCONNECTED;
+    uint32_t             _keepAliveMs = 0;
+    uint32_t             _lastIn = 0;          // [ms] last packet received
+    uint32_t             _lastOut = 0;         // [ms] last packet sent
+    bool                 _pingOutstanding = false;
+    bool                 _publishFailed = false;
+    uint16_t             _nextMsgId = 0;
+    uint32_t             _dropped = 0;
+    // incoming packet being assembled
+    uint8_t              _rxStep = 0;          // RX_xx, see MqttSession.cpp
+    uint8_t              _rxType = 0;          // first byte of the fixed header
+    uint32_t             _rxLen = 0;           // remaining length
+    uint8_t              _rxShift = 0;         // bit position of the next 7 bits of the remaining length
+    uint32_t             _rxPos = 0;           // bytes of the remaining length received
+
+    bool   send(const uint8_t *buf, size_t len);
+    size_t putHeader(uint8_t *buf, uint8_t type, uint32_t rem);
+    void   lost(int8_t state);
+    void   dispatch(void);
+};
+
+#endif  // MQTTSESSION_h
@@ -0,0 +1,315 @@
+// Non-blocking TCP transport for the MQTT connection
+
+#include <MqttTransport.h>
+#include <lwip/dns.h>
+#include <lwip/sockets.h>
+#include <lwip/tcpip.h>
+
+#define DNS_PENDING  0
+#define DNS_FOUND    1
+#define DNS_FAILED   2
+
+
+MqttTransport *MqttTransport::_dnsOwner = NULL;
+uint32_t MqttTransport::_dnsSeq = 0;
+static portMUX_TYPE dnsMux = portMUX_INITIALIZER_UNLOCKED;   // guards the lookup state shared with the lwIP thread
+
+
+/************************************************************
+ * Start connecting
+ * - DNS lookup in the lwIP thread (see dnsStart), continued 
+ *   by pollConnect()
+ * @param[in] host name or IP address of the broker, must stay
+ *                 valid while resolving
+ * @param[in] port TCP port
+ * @return    false if the lookup could not be started
+ ************************************************************/
+bool MqttTransport::beginConnect(const char *host, uint16_t port) {
+  uint32_t tag;
+  stop();
+  _port = port;
+  _host = host;
+  portENTER_CRITICAL(&dnsMux);
+  if (++_dnsSeq == 0) _dnsSeq = 1;                   // 0: no lookup
+  tag = _dnsSeq;
+  _dnsTag = tag;
+  _dnsDone = DNS_PENDING;
+  _dnsOwner = this;
+  portEXIT_CRITICAL(&dnsMux);
+  _state = MQTT_TRANSPORT_RESOLVING;
+  if (tcpip_callback(&MqttTransport::dnsStart, (void *)(uintptr_t)tag) != ERR_OK) {
+    stop();
+    return false;
+  }
+  return true;
+}
+
+
+/************************************************************
+ * Start DNS lookup (lwIP thread)
+ * - dns_gethostbyname() must not be called from another task
+ * - answered at once for IP addresses and cached names
+ * - skipped if the lookup has been given up meanwhile
+ * @param[in] arg tag of the lookup
+ ************************************************************/
+void MqttTransport::dnsStart(void *arg) {
+  uint32_t tag = (uint32_t)(uintptr_t)arg;
+  const char *host = NULL;
+  ip_addr_t addr;
+  err_t err;
+  portENTER_CRITICAL(&dnsMux);
+  if (_dnsOwner && (_dnsOwner->_dnsTag == tag)) host = _dnsOwner->_host;
+  portEXIT_CRITICAL(&dnsMux);
+  if (!host) return;
+  err = dns_gethostbyname(host, &addr, &MqttTransport::dnsFound, arg);
+  if (err == ERR_OK) {
+    dnsFound(host, &addr, arg);
+  } else if (err != ERR_INPROGRESS) {
+    dnsFound(host, NULL, arg);
+  }
+}
+
+
+/************************************************************
+ * DNS lookup finished (lwIP thread)
+ * - answer of a lookup given up (tag differs) is ignored
+ * @param[in] arg tag of the lookup
+ ************************************************************/
+void MqttTransport::dnsFound(const char *name, const ip_addr_t *addr, void *arg) {
+  uint32_t tag = (uint32_t)(uintptr_t)arg;
+  MqttTransport *t;
+  (void)name;
+  portENTER_CRITICAL(&dnsMux);
+  t = _dnsOwner;
+  if (t && (t->_dnsTag == tag)) {
+    if (addr && IP_IS_V4(addr)) {
+      t->_dnsAddr = ip4_addr_get_u32(ip_2_ip4(addr));
+      t->_dnsDone = DNS_FOUND;
+    } else {
+      t->_dnsDone = DNS_FAILED;
+    }
+    t->_dnsTag = 0;
+  }
+  portEXIT_CRITICAL(&dnsMux);
+}
+
+
+/************************************************************
+ * Continue connecting, never waits
+ * - DNS lookup done: start non-blocking TCP connect
+ * - TCP connect done: hand socket over to a WiFiClient
+ * @return 1: connected, 0: pending, -1: failed (connection
+ *         closed, start again with beginConnect())
+ ************************************************************/
+int8_t MqttTransport::pollConnect(void) {
+  struct sockaddr_in sa;
+  fd_set wset;
+  struct timeval tv = { 0, 0 };
+  int err = 0;
+  socklen_t errLen = sizeof(err);
+  switch (_state) {
+    case MQTT_TRANSPORT_RESOLVING:
+      if (_dnsDone == DNS_PENDING) return 0;
+      if (_dnsDone == DNS_FAILED) break;
+      _fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      if (_fd < 0) break;
+      fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+      memset(&sa, 0, sizeof(sa));
+      sa.sin_family = AF_INET;
+      sa.sin_port = htons(_port);
+      sa.sin_addr.s_addr = _dnsAddr;
+      if ((lwip_connect(_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) && (errno != EINPROGRESS)) break;
+      _state = MQTT_TRANSPORT_CONNECTING;
+      return 0;
+    case MQTT_TRANSPORT_CONNECTING:
+      FD_ZERO(&wset);
+      FD_SET(_fd, &wset);
+      if (select(_fd + 1, NULL, &wset, NULL, &tv) == 0) return 0;
+      if ((getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &errLen) < 0) || (err != 0)) break;
+      // blocking again, as sockets opened by WiFiClient::connect()
+      fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) & ~O_NONBLOCK);
+      _client = WiFiClient(_fd);
+      _client.setNoDelay(true);
+      _fd = -1;
+      _state = MQTT_TRANSPORT_CONNECTED;
+      return 1;
+    case MQTT_TRANSPORT_CONNECTED:
+      if (_client.connected()) return 1;
+      break;
+    default:
+      break;
+  }
+  stop();
+  return -1;
+}
+
+
+/************************************************************
+ * Append string with length prefix (MQTT UTF-8 string)
+ * @return false if it does not fit
+ ************************************************************/
+static bool putString(uint8_t *buf, size_t &len, const char *s) {
+  size_t n = strlen(s);
+  if ((n > 0xffff) || (len + 2 + n > MQTT_TRANSPORT_CONNECT_MAX)) return false;
+  buf[len++] = (uint8_t)(n >> 8);
+  buf[len++] = (uint8_t)n;
+  memcpy(buf + len, s, n);
+  len += n;
+  return true;
+}
+
+
+/************************************************************
+ * Send CONNECT (MQTT 3.1.1)
+ * - written in one piece, never waits for the answer
+ * - user NULL: no user and no password, pass NULL: no password
+ * - willTopic NULL: no LastWill
+ * @return false if not connected or the packet is too long
+ ************************************************************/
+bool MqttTransport::sendConnect(const char *id, const char *user, const char *pass,
+                                const char *willTopic, uint8_t willQos, bool willRetain, const char *willMessage,
+                                bool cleanSession, uint16_t keepAlive) {
+  uint8_t buf[MQTT_TRANSPORT_CONNECT_MAX];
+  size_t len = 3;                                    // room for fixed header (remaining length < 16384)
+  size_t start;
+  size_t rem;
+  uint8_t flags = cleanSession ? 0x02 : 0x00;
+  if (willTopic) {
+    flags |= 0x04 | ((willQos & 0x03) << 3) | (willRetain ? 0x20 : 0x00);
+  }
+  if (user) {
+    flags |= 0x80;
+    if (pass) flags |= 0x40;
+  }
+  // variable header: protocol name, level 4, flags, keep alive [s]
+  const uint8_t header[] = { 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, flags, (uint8_t)(keepAlive >> 8), (uint8_t)keepAlive };
+  memcpy(buf + len, header, sizeof(header));
+  len += sizeof(header);
+  // payload
+  if (!putString(buf, len, id)) return false;
+  if (willTopic && (!putString(buf, len, willTopic) || !putString(buf, len, willMessage ? willMessage : ""))) return false;
+  if (user && (!putString(buf, len, user) || (pass && !putString(buf, len, pass)))) return false;
+  // fixed header: CONNECT, remaining length (1 or 2 bytes)
+  rem = len - 3;
+  if (rem < 128) {
+    start = 1;
+    buf[2] = (uint8_t)rem;
+  } else {
+    start = 0;
+    buf[1] = (uint8_t)((rem & 0x7f) | 0x80);
+    buf[2] = (uint8_t)(rem >> 7);
+  }
+  buf[start] = 0x10;
+  if (!connected()) return false;
+  return _client.write(buf + start, len - start) == len - start;
+}
+
+
+/************************************************************
+ * Check for CONNACK, never waits
+ * @return 1: accepted, 0: pending, -1: refused (see 
+ *         connackCode()), not a CONNACK or connection closed
+ ************************************************************/
+int8_t MqttTransport::pollConnack(void) {
+  if (!connected()) return -1;
+  if (_client.available() < MQTT_TRANSPORT_CONNACK_LEN) return 0;
+  if (_client.read(_connack, MQTT_TRANSPORT_CONNACK_LEN) != MQTT_TRANSPORT_CONNACK_LEN) return -1;
+  if ((_connack[0] != 0x20) || (_connack[1] != 0x02)) return -1;
+  return (_connack[3] == 0) ? 1 : -1;
+}
+
+
+/************************************************************
+ * Client: blocking connects are refused
+ * - never called (MqttSession takes over a connection set up
+ *   by beginConnect()), parameters unused
+ ************************************************************/
+int MqttTransport::connect(IPAddress, uint16_t) {
+  return 0;
+}
+
+int MqttTransport::connect(const char *, uint16_t) {
+  return 0;
+}
+
+int MqttTransport::connect(IPAddress, uint16_t, int32_t) {
+  return 0;
+}
+
+int MqttTransport::connect(const char *, uint16_t, int32_t) {
+  return 0;
+}
+
+
+/************************************************************
+ * Client: write
+ ************************************************************/
+size_t MqttTransport::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t MqttTransport::write(const uint8_t *buf, size_t size) {
+  if (_state != MQTT_TRANSPORT_CONNECTED) return 0;
+  return _client.write(buf, size);
+}
+
+
+/************************************************************
+ * Client: read
+ ************************************************************/
+int MqttTransport::available(void) {
+  if (_state != MQTT_TRANSPORT_CONNECTED) return 0;
+  return _client.available();
+}
+
+int MqttTransport::read(void) {
+  if (_state != MQTT_TRANSPORT_CONNECTED) return -1;
+  return _client.read();
+}
+
+int MqttTransport::read(uint8_t *buf, size_t size) {
+  if (_state != MQTT_TRANSPORT_CONNECTED) return -1;
+  return _client.read(buf, size);
+}
+
+int MqttTransport::peek(void) {
+  if (_state != MQTT_TRANSPORT_CONNECTED) return -1;
+  return _client.peek();
+}
+
+void MqttTransport::flush(void) {
+  if (_state == MQTT_TRANSPORT_CONNECTED) _client.flush();
+}
+
+
+/************************************************************
+ * Client: close connection
+ * - a running DNS lookup is given up, its answer ignored
+ ************************************************************/
+void MqttTransport::stop(void) {
+  portENTER_CRITICAL(&dnsMux);
+  _dnsTag = 0;
+  portEXIT_CRITICAL(&dnsMux);
+  _client.stop();
+  closeSocket();
+  _state = MQTT_TRANSPORT_IDLE;
+}
+
+
+/************************************************************
+ * Client: connection state
+ ************************************************************/
+uint8_t MqttTransport::connected(void) {
+  return (_state == MQTT_TRANSPORT_CONNECTED) && _client.connected();
+}
+
+
+/************************************************************
+ * Close socket of a pending TCP connect
+ ************************************************************/
+void MqttTransport::closeSocket(void) {
+  if (_fd >= 0) {
+    close(_fd);
+    _fd = -1;
+  }
+}
@@ -0,0 +1,79 @@
+// Non-blocking TCP transport for the MQTT connection
+//
+// - A blocking connect() resolves the broker, opens the TCP
+//   connection and waits for the CONNACK, for seconds when the
+//   broker is not reachable
+// - Here the connection is set up in steps which never wait:
+//   beginConnect() starts the DNS lookup, pollConnect() continues
+//   with a non-blocking TCP connect and reports when it is up
+// - The DNS lookup runs in the lwIP thread (tcpip_callback()), each
+//   lookup has a tag, so the answer of an earlier lookup (given up
+//   by stop() or a new beginConnect()) is ignored; one lookup at a
+//   time for all transports (one broker connection)
+// - The MQTT handshake is done here as well: sendConnect() writes the
+//   CONNECT packet, pollConnack() reads and checks the CONNACK
+// - Once the CONNACK is accepted, MqttSession takes over the
+//   connection; the Client calls are forwarded to a WiFiClient
+
+#ifndef MQTTTRANSPORT_h
+#define MQTTTRANSPORT_h
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <lwip/ip_addr.h>
+
+#define MQTT_TRANSPORT_IDLE       0 // no connection
+#define MQTT_TRANSPORT_RESOLVING  1 // DNS lookup running
+#define MQTT_TRANSPORT_CONNECTING 2 // TCP connect running
+#define MQTT_TRANSPORT_CONNECTED  3 // TCP connection up
+
+#define MQTT_TRANSPORT_CONNECT_MAX 256 // longest CONNECT packet [bytes] (client ID, will, user, password)
+#define MQTT_TRANSPORT_CONNACK_LEN   4 // CONNACK packet [bytes]
+
+class MqttTransport : public Client {
+  public:
+    bool    beginConnect(const char *host, uint16_t port); // start DNS lookup and TCP connect, false on error
+    int8_t  pollConnect(void);                              // 1: connected, 0: pending, -1: failed
+    bool    sendConnect(const char *id, const char *user, const char *pass,
+                        const char *willTopic, uint8_t willQos, bool willRetain, const char *willMessage,
+                        bool cleanSession, uint16_t keepAlive); // write CONNECT packet, false on error
+    int8_t  pollConnack(void);                              // 1: accepted, 0: pending, -1: refused or closed
+    uint8_t connackCode(void) const { return _connack[3]; } // return code of the last CONNACK
+    uint8_t state(void) const { return _state; }            // MQTT_TRANSPORT_IDLE ... CONNECTED
+
+    // Client, blocking connects are refused (see beginConnect()),
+    // never called: MqttSession does not connect
+    int     connect(IPAddress, uint16_t);
+    int     connect(const char *, uint16_t);
+    int     connect(IPAddress, uint16_t, int32_t);
+    int     connect(const char *, uint16_t, int32_t);
+    size_t  write(uint8_t b);
+    size_t  write(const uint8_t *buf, size_t size);
+    int     available(void);
+    int     read(void);
+    int     read(uint8_t *buf, size_t size);
+    int     peek(void);
+    void    flush(void);
+    void    stop(void);
+    uint8_t connected(void);
+    operator bool(void) { return connected(); }
+
+  protected:
+    WiFiClient        _client;             // TCP connection, once connected
+    int               _fd = -1;            // socket while connecting
+    uint8_t           _state = MQTT_TRANSPORT_IDLE;
+    uint16_t          _port = 0;
+    const char       *_host = NULL;        // broker, must stay valid while resolving
+    uint32_t          _dnsTag = 0;         // tag of the running lookup, 0: none
+    volatile uint8_t  _dnsDone = 0;        // 0: pending, 1: found, 2: failed (set by lwIP thread)
+    volatile uint32_t _dnsAddr = 0;        // IPv4 address found (network byte order)
+    uint8_t           _connack[MQTT_TRANSPORT_CONNACK_LEN] = {}; // last CONNACK received
+
+    static MqttTransport *_dnsOwner;       // transport of the running lookup
+    static uint32_t   _dnsSeq;             // last tag given out
+    static void dnsStart(void *arg);        // lwIP thread: start lookup
+    static void dnsFound(const char *name, const ip_addr_t *addr, void *arg); // lwIP callback
+    void closeSocket(void);
+};
+
+#endif  // MQTTTRANSPORT_h
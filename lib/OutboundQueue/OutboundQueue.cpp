@@ -0,0 +1,215 @@
+// Store-and-forward queue for messages which could not be published
+
+#include <OutboundQueue.h>
+
+
+/************************************************************
+ * Mount LittleFS and open flash log
+ * - LittleFS is formatted if it can not be mounted
+ * - a log with other layout (magic, number of slots) is
+ *   discarded
+ * @return false if flash log is not usable (RAM only)
+ ************************************************************/
+bool OutboundQueue::begin(void) {
+  LogHeader hdr;
+  _flashReady = false;
+  if (OUTBOUND_FLASH_SLOTS == 0) return false;
+  if (!LittleFS.begin(true)) return false;
+  if (LittleFS.exists(OUTBOUND_LOG_FILE)) {
+    _log = LittleFS.open(OUTBOUND_LOG_FILE, "r+");
+  }
+  if (_log && (_log.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr)) &&
+      (hdr.magic == OUTBOUND_LOG_MAGIC) && (hdr.slots == OUTBOUND_FLASH_SLOTS) &&
+      (hdr.head - hdr.tail <= OUTBOUND_FLASH_SLOTS)) {
+    _flashHead = hdr.head;
+    _flashTail = hdr.tail;
+  } else {
+    // new or incompatible log
+    if (_log) _log.close();
+    _log = LittleFS.open(OUTBOUND_LOG_FILE, "w+");
+    if (!_log) return false;
+    _flashHead = 0;
+    _flashTail = 0;
+  }
+  _flashReady = sync();
+  updateHighWater();
+  return _flashReady;
+}
+
+
+/************************************************************
+ * Add record
+ * - to RAM, if there is space and the flash log is empty
+ * - else to flash log (oldest record overwritten if full)
+ * - without flash log the oldest RAM record is dropped if full
+ * @param[in] rec     record header (len: payload length)
+ * @param[in] payload payload, rec.len bytes
+ * @return    false if the record has been dropped
+ ************************************************************/
+bool OutboundQueue::push(const OutboundRecord &rec, const char *payload) {
+  if (rec.len > OUTBOUND_PAYLOAD_MAX) {
+    _stats.dropped++;
+    return false;
+  }
+  _stats.enqueued++;
+  if ((flashCount() == 0) && (ramCount() >= OUTBOUND_RAM_SLOTS) && !_flashReady) {
+    _ramTail++;                                     // RAM only: drop oldest
+    _stats.dropped++;
+  }
+  if ((flashCount() == 0) && (ramCount() < OUTBOUND_RAM_SLOTS)) {
+    Slot &slot = _ram[_ramHead % OUTBOUND_RAM_SLOTS];
+    slot.rec = rec;
+    memcpy(slot.payload, payload, rec.len);
+    _ramHead++;
+    updateHighWater();
+    return true;
+  }
+  if (!pushFlash(rec, payload)) {
+    _stats.dropped++;
+    return false;
+  }
+  updateHighWater();
+  return true;
+}
+
+
+/************************************************************
+ * Append record to flash log
+ * - synced after OUTBOUND_SYNC_RECORDS changes or by poll()
+ ************************************************************/
+bool OutboundQueue::pushFlash(const OutboundRecord &rec, const char *payload) {
+  if (!_flashReady) return false;
+  if (flashCount() >= OUTBOUND_FLASH_SLOTS) {
+    _flashTail++;                                   // overwrite oldest
+    _stats.dropped++;
+  }
+  if (!_log.seek(slotOffset(_flashHead)) ||
+      (_log.write((const uint8_t *)&rec, sizeof(rec)) != sizeof(rec)) ||
+      (_log.write((const uint8_t *)payload, rec.len) != rec.len)) {
+    return false;
+  }
+  _flashHead++;
+  changed();
+  return true;
+}
+
+
+/************************************************************
+ * Copy oldest record
+ * - RAM records are always older than flash records
+ * @param[out] rec     record header
+ * @param[out] payload buffer for payload
+ * @param[in]  bufSize size of buffer
+ * @return     false if queue is empty or the record could not
+ *             be read (it is dropped then)
+ ************************************************************/
+bool OutboundQueue::peek(OutboundRecord &rec, char *payload, size_t bufSize) {
+  while (size() > 0) {
+    if (ramCount() > 0) {
+      const Slot &slot = _ram[_ramTail % OUTBOUND_RAM_SLOTS];
+      if (slot.rec.len <= bufSize) {
+        rec = slot.rec;
+        memcpy(payload, slot.payload, rec.len);
+        return true;
+      }
+    } else if (_log.seek(slotOffset(_flashTail)) &&
+               (_log.read((uint8_t *)&rec, sizeof(rec)) == sizeof(rec)) &&
+               (rec.len <= bufSize) && (rec.len <= OUTBOUND_PAYLOAD_MAX) &&
+               (_log.read((uint8_t *)payload, rec.len) == rec.len)) {
+      return true;
+    }
+    // unreadable record
+    removeOldest();
+    _stats.dropped++;
+  }
+  return false;
+}
+
+
+/************************************************************
+ * Remove oldest record (after it has been published)
+ ************************************************************/
+void OutboundQueue::pop(void) {
+  if (removeOldest()) _stats.forwarded++;
+}
+
+
+/************************************************************
+ * Remove oldest record
+ * @return false if queue was empty
+ ************************************************************/
+bool OutboundQueue::removeOldest(void) {
+  if (ramCount() > 0) {
+    _ramTail++;
+  } else if (flashCount() > 0) {
+    _flashTail++;
+    changed();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+
+/************************************************************
+ * Reset counters, queued records are kept
+ ************************************************************/
+void OutboundQueue::resetStats(void) {
+  memset(&_stats, 0, sizeof(_stats));
+  updateHighWater();
+}
+
+
+/************************************************************
+ * Sync flash log, if it has changed and the last sync is
+ * OUTBOUND_SYNC_MS ago
+ * - called periodically by the task using the queue
+ ************************************************************/
+void OutboundQueue::poll(void) {
+  if (_flashReady && _unsynced && (millis() - _syncedMs >= OUTBOUND_SYNC_MS)) {
+    sync();
+  }
+}
+
+
+/************************************************************
+ * Write position of flash log to its header and flush the
+ * file (records written since the last sync included)
+ * @return false on write error
+ ************************************************************/
+bool OutboundQueue::sync(void) {
+  LogHeader hdr = { OUTBOUND_LOG_MAGIC, OUTBOUND_FLASH_SLOTS, _flashHead, _flashTail };
+  _unsynced = 0;
+  _syncedMs = millis();
+  if (!_log.seek(0) || (_log.write((const uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr))) {
+    return false;
+  }
+  _log.flush();
+  return true;
+}
+
+
+/************************************************************
+ * Count a push or pop of the flash log, sync after 
+ * OUTBOUND_SYNC_RECORDS
+ ************************************************************/
+void OutboundQueue::changed(void) {
+  if (++_unsynced >= OUTBOUND_SYNC_RECORDS) sync();
+}
+
+
+/************************************************************
+ * File offset of a flash slot
+ * @param[in] index free running index
+ ************************************************************/
+size_t OutboundQueue::slotOffset(uint32_t index) {
+  return sizeof(LogHeader) + (size_t)(index % (OUTBOUND_FLASH_SLOTS ? OUTBOUND_FLASH_SLOTS : 1)) * sizeof(Slot);
+}
+
+
+/************************************************************
+ * Track maximum number of queued records
+ ************************************************************/
+void OutboundQueue::updateHighWater(void) {
+  if (size() > _stats.highWater) _stats.highWater = size();
+}
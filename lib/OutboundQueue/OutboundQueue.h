@@ -0,0 +1,102 @@
+// Store-and-forward queue for messages which could not be published
+//
+// - Bounded FIFO of records in RAM, spilling to a ring log on flash
+//   (LittleFS) when RAM is full
+// - Records keep the time they have been created, so they can be
+//   forwarded with their original timestamp
+// - While the flash log holds records, new records are appended to
+//   it as well, so the order of all records is kept
+// - When the flash log is full, its oldest record is overwritten
+//   (counted as dropped)
+// - The position of the flash log is stored in its header, records
+//   survive a reboot
+// - The header is written and the file flushed lazily, after
+//   OUTBOUND_SYNC_RECORDS pushes or pops or by poll() after
+//   OUTBOUND_SYNC_MS, not for every record (LittleFS commits data
+//   and header together on flush): a reset loses the records
+//   pushed since the last sync, and forwards again the records
+//   removed since then (at least once)
+
+#ifndef OUTBOUNDQUEUE_h
+#define OUTBOUNDQUEUE_h
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#ifndef OUTBOUND_RAM_SLOTS
+#define OUTBOUND_RAM_SLOTS        8 // records kept in RAM
+#endif
+#ifndef OUTBOUND_FLASH_SLOTS
+#define OUTBOUND_FLASH_SLOTS    256 // records kept in flash log, 0: RAM only
+#endif
+#define OUTBOUND_PAYLOAD_MAX    1000 // longest payload [bytes], longer records are dropped
+#define OUTBOUND_LOG_FILE  "/outbox.log" // flash log: header followed by OUTBOUND_FLASH_SLOTS records
+#define OUTBOUND_LOG_MAGIC 0x4F425131 // "OBQ1", changes when layout changes
+#define OUTBOUND_SYNC_RECORDS    16 // sync flash log after this many pushes or pops
+#define OUTBOUND_SYNC_MS       1000 // sync flash log by poll() at the latest after [ms]
+
+// Record header
+typedef struct {
+  uint8_t  topic;                   // topic ID of the publisher
+  uint16_t len;                     // payload length [bytes]
+  uint32_t bootId;                  // random ID of the boot the record has been created in
+  int64_t  uptimeMs;                // [ms] since boot when created
+  int64_t  epochMs;                 // [ms] since 1970-01-01 UTC when created, 0: clock was not set
+} OutboundRecord;
+
+// Statistics
+typedef struct {
+  uint32_t enqueued;                // records added
+  uint32_t forwarded;               // records removed after successful publish
+  uint32_t dropped;                 // records lost (queue full, payload too long, flash error)
+  uint32_t highWater;               // maximum number of queued records
+} OutboundStats;
+
+class OutboundQueue {
+  public:
+    bool     begin(void);                                                   // mount LittleFS and open flash log, false: RAM only
+    bool     push(const OutboundRecord &rec, const char *payload);           // add record, false if dropped
+    bool     peek(OutboundRecord &rec, char *payload, size_t bufSize);      // copy oldest record, false if empty
+    void     pop(void);                                                     // remove oldest record (after publish)
+    void     poll(void);                                                    // sync flash log if due, call periodically
+    bool     sync(void);                                                    // write header and flush flash log now
+    uint32_t size(void) const { return ramCount() + flashCount(); }         // number of queued records
+    uint32_t ramCount(void) const { return _ramHead - _ramTail; }           // records in RAM
+    uint32_t flashCount(void) const { return _flashHead - _flashTail; }     // records in flash log
+    bool     flashReady(void) const { return _flashReady; }                 // flash log is usable
+    const OutboundStats &stats(void) const { return _stats; }
+    void     resetStats(void);                                              // reset counters (queued records are kept)
+
+  protected:
+    // slot as stored in RAM and flash
+    typedef struct {
+      OutboundRecord rec;
+      char           payload[OUTBOUND_PAYLOAD_MAX];
+    } Slot;
+    // header of flash log
+    typedef struct {
+      uint32_t magic;
+      uint32_t slots;
+      uint32_t head;                // free running write index
+      uint32_t tail;                // free running read index
+    } LogHeader;
+
+    Slot     _ram[OUTBOUND_RAM_SLOTS];
+    uint32_t _ramHead = 0;          // free running write index
+    uint32_t _ramTail = 0;          // free running read index
+    File     _log;                  // flash log, open while _flashReady
+    bool     _flashReady = false;
+    uint32_t _flashHead = 0;        // free running write index
+    uint32_t _flashTail = 0;        // free running read index
+    uint32_t _unsynced = 0;         // pushes and pops to flash log since last sync
+    uint32_t _syncedMs = 0;         // [ms] millis() of last sync
+    OutboundStats _stats = {};
+
+    bool pushFlash(const OutboundRecord &rec, const char *payload);
+    bool removeOldest(void);
+    void changed(void);
+    size_t slotOffset(uint32_t index);
+    void updateHighWater(void);
+};
+
+#endif  // OUTBOUNDQUEUE_h
@@ -0,0 +1,141 @@
+// Swinging door compression of one measurement series
+
+#include <SwingingDoor.h>
+
+
+/************************************************************
+ * Set parameters, takes effect with the next point
+ * @param[in] deviation largest error of an interpolated
+ *                      point, 0: only exactly linear points
+ *                      are dropped
+ * @param[in] maxSpan   longest time between archived points
+ ************************************************************/
+void SwingingDoor::configure(int32_t deviation, int64_t maxSpan) {
+  _deviation = (deviation < 0) ? 0 : deviation;
+  _maxSpan = (maxSpan > 0) ? maxSpan : INT64_MAX;
+}
+
+
+/************************************************************
+ * Forget series, the next point is archived
+ ************************************************************/
+void SwingingDoor::reset(void) {
+  _started = false;
+  _held = false;
+}
+
+
+/************************************************************
+ * Reset counters, the series is kept
+ ************************************************************/
+void SwingingDoor::resetStats(void) {
+  _inputs = 0;
+  _archived = 0;
+  _sse = 0;
+}
+
+
+/************************************************************
+ * Add point
+ * - time must increase from point to point
+ * @param[in]  t   time
+ * @param[in]  v   value
+ * @param[out] out points to archive, oldest first
+ *                 (SDT_OUT_MAX)
+ * @param[in]  gap value must not be interpolated (e.g. not a
+ *                 number): held point and this point are
+ *                 archived, the series starts again
+ * @return     number of points in out
+ ************************************************************/
+uint8_t SwingingDoor::add(int64_t t, int32_t v, SdtPoint *out, bool gap) {
+  SdtPoint p = { t, v };
+  uint8_t n = 0;
+  double tau, slope, minSlope, maxSlope;
+  _inputs++;
+  if (gap || !_started) {
+    if (_held) {
+      archiveHeld();
+      out[n++] = _p;
+    }
+    out[n++] = p;
+    _archived++;
+    _a = p;
+    _started = !gap;
+    _held = false;
+    return n;
+  }
+  if (!_held) {
+    open(p);
+    return 0;
+  }
+  // the line to the point must pass all held points within the
+  // deviation (slope between the doors), else the held point
+  // ends the segment
+  tau = (t > _a.t) ? (double)(t - _a.t) : 1.0;
+  slope = ((double)v - _a.v) / tau;
+  if ((slope < _slopeMin) || (slope > _slopeMax) || (t - _a.t > _maxSpan)) {
+    archiveHeld();
+    out[n++] = _p;
+    _a = _p;
+    open(p);
+    return n;
+  }
+  // narrow the doors to the slopes reaching the point within
+  // the deviation
+  minSlope = slope - (double)_deviation / tau;
+  maxSlope = slope + (double)_deviation / tau;
+  if (minSlope > _slopeMin) _slopeMin = minSlope;
+  if (maxSlope < _slopeMax) _slopeMax = maxSlope;
+  _p = p;
+  _sdd += ((double)v - _a.v) * ((double)v - _a.v);
+  _sdt += ((double)v - _a.v) * tau;
+  _stt += tau * tau;
+  return 0;
+}
+
+
+/************************************************************
+ * Archive held point, e.g. when compression is switched off
+ * - the series goes on from this point
+ * @param[out] out point to archive
+ * @return     false if there is no held point
+ ************************************************************/
+bool SwingingDoor::flush(SdtPoint &out) {
+  if (!_held) return false;
+  archiveHeld();
+  out = _p;
+  _a = _p;
+  _held = false;
+  return true;
+}
+
+
+/************************************************************
+ * Open doors at the last archived point, p is held
+ ************************************************************/
+void SwingingDoor::open(const SdtPoint &p) {
+  double tau = (p.t > _a.t) ? (double)(p.t - _a.t) : 1.0;
+  double d = (double)p.v - _a.v;
+  _slopeMin = (d - _deviation) / tau;
+  _slopeMax = (d + _deviation) / tau;
+  _sdd = d * d;
+  _sdt = d * tau;
+  _stt = tau * tau;
+  _p = p;
+  _held = true;
+}
+
+
+/************************************************************
+ * Held point is archived: add squared errors of the segment
+ * - the points since the last archived point are interpolated
+ *   on the line to the held point with slope s, their errors
+ *   d - s * t sum up to sdd - 2 * s * sdt + s^2 * stt
+ ************************************************************/
+void SwingingDoor::archiveHeld(void) {
+  double tau = (_p.t > _a.t) ? (double)(_p.t - _a.t) : 1.0;
+  double s = ((double)_p.v - _a.v) / tau;
+  double e = _sdd - 2 * s * _sdt + s * s * _stt;
+  if (e > 0) _sse += e;
+  _archived++;
+}
@@ -0,0 +1,64 @@
+// Swinging door compression of one measurement series
+//
+// - Points (time, value) are fed in one by one; only the points
+//   needed to reconstruct the series by linear interpolation
+//   within +/- deviation are archived (returned by add())
+// - The first point is archived, then the last point before the
+//   "doors" (the range of slopes keeping all points since the last
+//   archived point within the deviation) close, i.e. the line from
+//   the last archived point to a new point would miss a held point
+//   by more than the deviation
+// - So every dropped point is reconstructed within the deviation
+// - A point is archived after maxSpan at the latest, so flat lines
+//   still produce a point now and then
+// - Gaps (values which must not be interpolated) end the series:
+//   the held point and the gap point are archived
+// - The squared reconstruction error of all points is summed
+//   exactly from three running sums per segment, no points are
+//   buffered
+// - Only depends on <stdint.h>, so host side tools can use it as well
+
+#ifndef SWINGINGDOOR_h
+#define SWINGINGDOOR_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SDT_OUT_MAX               2 // most points archived by one add()
+
+// Point of a series
+typedef struct {
+  int64_t t;                        // time, e.g. [us]
+  int32_t v;                        // value, e.g. fixed point
+} SdtPoint;
+
+class SwingingDoor {
+  public:
+    void     configure(int32_t deviation, int64_t maxSpan);                 // error bound [value], longest span between archived points [time]
+    void     reset(void);                                                   // forget series, the next point is archived
+    uint8_t  add(int64_t t, int32_t v, SdtPoint *out, bool gap = false);   // add point, return number of points to archive (out[SDT_OUT_MAX])
+    bool     flush(SdtPoint &out);                                          // archive held point, false if there is none
+    uint32_t inputs(void) const { return _inputs; }                         // points added
+    uint32_t archived(void) const { return _archived; }                     // points archived
+    double   sse(void) const { return _sse; }                               // sum of squared errors of the interpolated points [value^2]
+    void     resetStats(void);
+
+  protected:
+    int32_t  _deviation = 0;
+    int64_t  _maxSpan = INT64_MAX;
+    bool     _started = false;      // _a valid
+    bool     _held = false;         // _p valid
+    SdtPoint _a;                    // last archived point
+    SdtPoint _p;                    // last point, not archived yet
+    double   _slopeMin;             // lower door: smallest slope passing all held points
+    double   _slopeMax;             // upper door: largest slope passing all held points
+    double   _sdd, _sdt, _stt;      // sums of d*d, d*t, t*t of the held points relative to _a
+    uint32_t _inputs = 0;
+    uint32_t _archived = 0;
+    double   _sse = 0;
+
+    void open(const SdtPoint &p);
+    void archiveHeld(void);
+};
+
+#endif  // SWINGINGDOOR_h
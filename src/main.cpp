@@ -21,7 +21,13 @@
  * - MQTT Connect (Provide TOPIC in platformio.ini)
  * - OTA Update (needs a UDP connection from ESP to IDE-PC)
  * - Monitor Wfi & MQTT and reconnect on error
+ *   (non-blocking state machine, see monitorConnections())
+ * - Radio on one core (loop), Network (WiFi, MQTT, OTA) in 
+ *   its own task on the other core, see networkTask()
  * - Send different States every 10s, 30s or 60s
+ * - Event driven: loop() sleeps until the next deadline 
+ *   (DeadlineScheduler) or until woken by the radio ISR, 
+ *   a command or the network task
  * - Accept and Parse commands over MQTT
  * - Automatic increment Version 
  *   - incrementafter upload to Production target
@@ -35,10 +41,11 @@
 #include <WiFi.h>                // Wifi
 #include <WiFiUdp.h>             // Wifi / OTA
 #include <WiFiClient.h>          // Wifi 
-#include <PubSubClient.h>        // MQTT  
+#include <esp_timer.h>           // Microsecond Timestamps
 #include <ESPmDNS.h>             // for OTA-Update
 #include <ArduinoOTA.h>          // for OTA-Update
-#include <CommandParser.h>       // To Parse MQTT Commands
+#include <CommandTable.h>        // To Parse MQTT Commands (needed by prototypes.h)
+#include <Preferences.h>         // Settings in Non-volatile Storage (NVS)
 #include <SimpleTime.h>          // Time Conversions 
 // Own Project Files
 #include <prototypes.h>          // Prototypes 
@@ -48,6 +55,18 @@
 // Project Libraries
 #include <SPI.h>
 #include <DavisRFM69.h>   // C:\Users\vandusen\Documents\VSCode\ESP32-Davis-Gateway\include\DavisRFM69.h
+#include <DavisHopScheduler.h>
+#include <DavisDecoder.h>
+#include <JsonWriter.h>
+#include <CborWriter.h>
+#include <IssCbor.h>
+#include <OutboundQueue.h>
+#include <SwingingDoor.h>
+#include <DeadlineScheduler.h>
+#include <MqttTransport.h>
+#include <MqttSession.h>
+#include <sys/time.h>             // Wall Clock (SNTP)
+#include <freertos/ringbuf.h>     // Messages handed over to the network task
 
 
 /************************************************************
@@ -71,6 +90,11 @@
   #define WIFI_PSK  "mypassword"
 #endif
 
+// NTP-Server for the Wall Clock (Timestamps of Measurements)
+#ifndef NTP_SERVER
+  #define NTP_SERVER "pool.ntp.org"
+#endif
+
 /************************************************************
  * MQTT-Settings
  ************************************************************/ 
@@ -91,13 +115,24 @@
 #ifndef MQTT_PREFIX
   #define MQTT_PREFIX "esp32/default"
 #endif
+// Transmitters publishing compact (CBOR) instead of JSON Messages, bit n: ISS/n+1
+// (default until changed by command "format"), e.g.: build_flags = -DISS_CBOR_TX=0xff
+#ifndef ISS_CBOR_TX
+  #define ISS_CBOR_TX 0x00
+#endif
 
 // MQTT-Connection Settings
 #define MQTT_BUFSIZE   2048                       // MQTT-Buffersize (may be augmented, when Scan returns many BLE-Devices
+#define MQTT_KEEPALIVE   15                       // [s] PINGREQ after this time without traffic
+#define JSON_BUFSIZE   3072                       // JSON Messages (streamed to the broker, not limited by MQTT_BUFSIZE)
+#define CBOR_BUFSIZE    256                       // Compact ISS Messages (see IssCbor.h)
+#define CLIENTID_SIZE    24                       // "esp32_" + 3 MAC Bytes
+#define QUEUE_DRAIN_RATE  5                       // Default: queued Messages forwarded per second after reconnect
+#define EPOCH_VALID_MS 1609459200000LL            // Wall Clock is set if later than 2021-01-01 [ms since 1970]
 // Topic used to subscribe, MQTT_PREFIX will be added
 #define T_CMD          "cmd"                      // Topic for Commands (subscribe) (MQTT_PREFIX will be added)
 // Topics used to publish, MQTT_PREFIX will be added
-#define T_ISS          "ISS"                      // Topic for ISS Data
+#define T_ISS          "ISS"                      // Topic for ISS Data, one subtopic per transmitter: ISS/1 - ISS/8
 #define T_HELP         "help"                     // Topic for Help 
 #define T_RFMSTATS     "rfmstats"                 // Topic for RFM69 Statistics
 #define T_CPU          "cpu"                      // Topic for CPU Status
@@ -105,9 +140,62 @@
 #define T_NETWORK      "network"                  // Topic for Network Status 
 #define T_RESULT       "result"                   // Topic for Commands Responses
 #define T_SKETCH       "sketch"                   // Topic for Sketch Status 
+#define T_BATCH        "batch"                    // Subtopic of T_ISS for batches of records (batch mode)
+#define T_SDT          "sdt"                      // Subtopic of T_ISS for points of the compressed series (swinging door)
 #define T_STATUS       "status"                   // Topic for Online-Status 'ONLINE/OFFLINE' (published at birth and lastwill) (MQTT_PREFIX will be added)
 #define STATUS_MSG_ON  "ONLINE"                   // Online Message
 #define STATUS_MSG_OFF "OFFLINE"                  // Last Will Message
+// Topic IDs: index of topic table TOPICS
+#define TOPIC_ISS         0                       // ISS/1 - ISS/8: TOPIC_ISS + Transmitter ID (0-7)
+#define TOPIC_HELP        8
+#define TOPIC_RFMSTATS    9
+#define TOPIC_CPU        10
+#define TOPIC_LOG        11
+#define TOPIC_NETWORK    12
+#define TOPIC_RESULT     13
+#define TOPIC_SKETCH     14
+#define TOPIC_STATUS     15
+#define TOPIC_BATCH      16                       // ISS/batch
+#define TOPIC_SDT        17                       // ISS/sdt
+#define TOPIC_FIELD      18                       // ISS/[ID]/[field]: TOPIC_FIELD + Transmitter ID * FIELD_NUM + FIELD_xx
+#define TOPIC_NUM        (TOPIC_FIELD + DAVIS_HOP_MAX_TX * FIELD_NUM) // Number of topics
+// Field Topics: one retained subtopic per measurement, published on change, see publishFields()
+#define FIELD_WINDSPEED   0
+#define FIELD_WINDDIR     1
+#define FIELD_GUST        2
+#define FIELD_TEMPERATURE 3
+#define FIELD_HUMIDITY    4
+#define FIELD_RAINRATE    5
+#define FIELD_SOLAR       6
+#define FIELD_GOLDCAP     7
+#define FIELD_RAINDAY     8
+#define FIELD_RAINSUM     9
+#define FIELD_NUM        10                       // Number of fields
+#define F_WINDSPEED    "windspeed"                // Subtopics of the fields (ISS/[ID]/[field])
+#define F_WINDDIR      "winddir"
+#define F_GUST         "gust"
+#define F_TEMPERATURE  "temperature"
+#define F_HUMIDITY     "humidity"
+#define F_RAINRATE     "rainrate"
+#define F_SOLAR        "solar"
+#define F_GOLDCAP      "goldcap"
+#define F_RAINDAY      "rainday"
+#define F_RAINSUM      "rainsum"
+// Swinging Door Compression: per field and transmitter, points published to ISS/sdt, see sdtAdd()
+#define SDT_SPAN          600                     // Default: longest time between published points [s]
+#define SDT_SPAN_MAX    86400                     // largest span [s]
+// Batch Mode: records of received packets (allrx) collected into one message, see batchAdd()
+#define BATCH_BUFSIZE    OUTBOUND_PAYLOAD_MAX     // longest batch [bytes], so it fits into the outbox
+#define BATCH_RECORD_MAX  256                     // longest record and end of batch [bytes], flushed before it may overflow
+#define BATCH_LATENCY       30                    // Default: latency cap, longest wait of a record [s]
+#define BATCH_LATENCY_MAX 3600                    // largest latency cap [s]
+#define BATCH_FLUSH_COUNT    0                    // Flush reasons: number of records reached
+#define BATCH_FLUSH_PERIOD   1                    // period elapsed
+#define BATCH_FLUSH_LATENCY  2                    // oldest record reached latency cap
+#define BATCH_FLUSH_SIZE     3                    // next record might not fit
+#define BATCH_FLUSH_CONFIG   4                    // settings changed
+#define BATCH_FLUSH_NUM      5
+const char * const BATCH_FLUSH_NAMES[BATCH_FLUSH_NUM] = { "count", "period", "latency", "size", "config" };
 
 /************************************************************
  * Debug LED
@@ -121,107 +209,348 @@
 #define T_HEARTBEAT_10S       10000  // cron every 10 seconds
 #define T_HEARTBEAT_30S       30000  // cron every 30 seconds
 #define T_HEARTBEAT_60S       60000  // cron every 60 seconds
+#define T_RADIO_WAIT_MAX       1000  // loop(): longest sleep waiting for the next deadline or event [ms]
 #define T_STATE_LONG          60000  // Print detailed Status every 1 minute
 #define T_STATE_SHORT          1000  // Print Status every 1 second
-#define T_MQTT_RECONNECT       5000  // How often check MQTT: 5 seconds
-#define T_NET_MONITORING      10000  // How often check Wifi: 10 seconds 
-#define T_WIFI_MAX_TRIES         10  // Howoften retry to reconnect Wifi: 10 (repeated later)
+#define T_WIFI_CONNECT        15000  // Longest wait for the WiFi connection (IP address)
+#define T_MQTT_CONNECT         5000  // Longest wait for TCP connection and CONNACK of the broker
+#define T_BACKOFF_MIN          1000  // Reconnect: delay after first failure, doubled after each further failure
+#define T_BACKOFF_MAX         60000  // Reconnect: longest delay (a random part of up to 50% is subtracted)
 #define T_REBOOT_TIMEOUT       5000  // ms until Reboot is triggered when g_rebootActive = true
 
+/************************************************************
+ * Jobs of loop() (DeadlineScheduler, registered in this order)
+ ************************************************************/ 
+#define JOB_1S          0      // oncePerSecond(), every T_HEARTBEAT_1S
+#define JOB_10S         1      // oncePerTenSeconds(), every T_HEARTBEAT_10S
+#define JOB_30S         2      // oncePerThirtySeconds(), every T_HEARTBEAT_30S
+#define JOB_60S         3      // oncePerMinute(), every T_HEARTBEAT_60S
+#define JOB_BATCH       4      // batchPoll() at the flush deadline of the pending batch
+#define JOB_HOP         5      // hopPoll() at the next hop deadline (HOP_BY_TIMER 0)
+
 /************************************************************
  * RFM Params
  ************************************************************/ 
-#define PACKET_INTERVAL 2500   // After 2,5s a Packet should be recived, if not: Hop anyway
-#define PACKET_OFFSET   500    // Hop after (N * PACKET_INTERVAL) + PACKET_OFFSET  [N = number off Packets missed so far]
-#define PACKET_LONGHOP  20000  // Hop every PACKET_LONGHOP, if more than 20 Packes in a steak have been missed
+#define HOP_BY_TIMER    1      // Hop on missing Packet by loop(), woken 1: by hardware timer [us], 0: at the scheduler deadline [ms]
+#define ACQ_DWELL_US      500  // Acquisition: dwell per channel while scanning for a carrier [us]
+#define ACQ_CAPTURE_US  15000  // Acquisition: wait for the packet after sync word detection [us]
+#define ACQ_FOLLOW_US 3200000  // Acquisition: wait on next channel after carrier detection [us], > longest interval (ID 7: 3 s)
+#define HOP_TIMER_NUM   0      // Hardware timer used for hopping (1 MHz)
+#define ACQ_OFF         0      // Acquisition state: transmitter(s) followed by hop scheduler
+#define ACQ_SCAN        1      // Acquisition state: scanning channels for a carrier
+#define ACQ_CAPTURE     2      // Acquisition state: sync word detected, waiting for packet
+#define ACQ_FOLLOW      3      // Acquisition state: carrier detected, waiting for next packet on next channel
+#define RAIN_TX_ID      0      // Transmitter ID (0-7, published as 1-8) whose rain counter is set by "setrc"
+
+/************************************************************
+ * Connection States, see monitorConnections()
+ ************************************************************/ 
+#define NET_WIFI_WAIT        0     // WiFi.begin() called, waiting for IP address (WiFi event)
+#define NET_WIFI_BACKOFF     1     // WiFi failed, waiting for next attempt
+#define NET_MQTT_TCP         2     // DNS lookup and TCP connect to the broker
+#define NET_MQTT_CONNACK     3     // CONNECT sent, waiting for CONNACK
+#define NET_MQTT_BACKOFF     4     // MQTT failed, waiting for next attempt
+#define NET_ONLINE           5     // MQTT connected
+const char * const NET_STATE_NAMES[] = {
+  "WiFi wait", "WiFi backoff", "MQTT connect", "MQTT connack", "MQTT backoff", "online"
+};
+
+/************************************************************
+ * Tasks
+ * - loop() (radio, decoding, commands) runs on ARDUINO_RUNNING_CORE (1)
+ * - networkTask() (WiFi, MQTT, OTA) runs on NET_TASK_CORE (0)
+ ************************************************************/ 
+#define NET_TASK_CORE        0     // Core of the network task (the WiFi driver runs on core 0 as well)
+#define NET_TASK_STACK    8192     // Stack size of the network task [bytes]
+#define NET_TASK_PRIO        1     // Priority of the network task
+#define RADIO_TASK_PRIO      2     // Priority of loop(): hops and packets are handled as soon as it is woken
+#define NET_TASK_WAIT_MS    10     // Network task: longest wait for Messages to publish [ms]
+#define NET_TASK_IDLE_MS   100     // Network task: longest wait while waiting for a reconnect (backoff) [ms]
+#define PUB_RING_SIZE    16384     // loop() -> network task: Messages to publish [bytes]
+#define CMD_QUEUE_LEN        4     // network task -> loop(): Commands waiting for execution
+#define CMD_REPLY_SIZE      64     // Longest Response of a Command [characters + 1]
+
+/************************************************************
+ * Settings stored in NVS
+ ************************************************************/ 
+#define NVS_NAMESPACE   "gateway"  // Preferences namespace
+#define NVS_KEY_REGION  "region"   // Frequency region (DAVIS_REGION_xx), set by command "region"
+#define NVS_KEY_CBOR    "cbor"     // Transmitters publishing compact Messages (bit n: ISS/n+1), set by command "format"
 
 
 /************************************************************
  * Objects
  ************************************************************/ 
-// WIFI Client
-WiFiClient myWiFiClient;
-
-// MQTT Client
-PubSubClient mqtt(MQTT_SERVER, MQTT_PORT, myWiFiClient);
-
-// IRQ Handling
-portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
-
-// CommandParser
-#define PARSER_NUM_COMMANDS   8   // limit number of commands 
-#define PARSER_NUM_ARGS       2   // limit number of arguments
-#define PARSER_CMD_LENGTH     10  // limit length of command names [characters]
-#define PARSER_ARG_SIZE       16  // limit size of all arguments [bytes]
-#define PARSER_RESPONSE_SIZE  64  // limit size of response strings [bytes]
-typedef CommandParser<PARSER_NUM_COMMANDS, PARSER_NUM_ARGS, PARSER_CMD_LENGTH, PARSER_ARG_SIZE, PARSER_RESPONSE_SIZE> MyCommandParser;
-MyCommandParser parser;
-// Command Handler Prototypes
-void cmd_allrx   (MyCommandParser::Argument *args, char *response);      // "allrx", "U"
-void cmd_hello   (MyCommandParser::Argument *args, char *response);      // "hello", ""
-void cmd_help    (MyCommandParser::Argument *args, char *response);      // "help"
-void cmd_newday  (MyCommandParser::Argument *args, char *response);      // "newDay", ""
-void cmd_period  (MyCommandParser::Argument *args, char *response);      // "period", "U"
-void cmd_reset   (MyCommandParser::Argument *args, char *response);      // "reset", ""
-void cmd_reboot  (MyCommandParser::Argument *args, char *response);      // "reboot", ""
-void cmd_setrc   (MyCommandParser::Argument *args, char *response);      // "setrc", "u"
+// TCP Connection to the broker, connected without blocking (see monitorConnections)
+MqttTransport transport;
+
+// MQTT Session, taken over from transport after the CONNACK
+uint8_t mqttBuf[MQTT_BUFSIZE];                   // incoming messages (commands)
+MqttSession mqtt(transport, mqttBuf, sizeof(mqttBuf));
+
+// MQTT Topics, composed at compile time, index: TOPIC_xx
+typedef struct {
+  const char *topic;                       // MQTT_PREFIX "/" subtopic
+  boolean     retain;                      // publish retained
+  boolean     store;                       // keep in outbox while disconnected (store and forward)
+} MqttTopic;
+// Field Topics of one transmitter, retained, order: FIELD_xx
+#define FIELD_TOPIC(tx, f) { MQTT_PREFIX "/" T_ISS "/" tx "/" f, true, false }
+#define FIELD_TOPICS(tx) \
+  FIELD_TOPIC(tx, F_WINDSPEED), FIELD_TOPIC(tx, F_WINDDIR),  FIELD_TOPIC(tx, F_GUST),    \
+  FIELD_TOPIC(tx, F_TEMPERATURE), FIELD_TOPIC(tx, F_HUMIDITY), FIELD_TOPIC(tx, F_RAINRATE), \
+  FIELD_TOPIC(tx, F_SOLAR),     FIELD_TOPIC(tx, F_GOLDCAP),  FIELD_TOPIC(tx, F_RAINDAY), \
+  FIELD_TOPIC(tx, F_RAINSUM)
+const MqttTopic TOPICS[] = {
+  { MQTT_PREFIX "/" T_ISS "/1",   false, true  },
+  { MQTT_PREFIX "/" T_ISS "/2",   false, true  },
+  { MQTT_PREFIX "/" T_ISS "/3",   false, true  },
+  { MQTT_PREFIX "/" T_ISS "/4",   false, true  },
+  { MQTT_PREFIX "/" T_ISS "/5",   false, true  },
+  { MQTT_PREFIX "/" T_ISS "/6",   false, true  },
+  { MQTT_PREFIX "/" T_ISS "/7",   false, true  },
+  { MQTT_PREFIX "/" T_ISS "/8",   false, true  },
+  { MQTT_PREFIX "/" T_HELP,       false, false },
+  { MQTT_PREFIX "/" T_RFMSTATS,   false, false },
+  { MQTT_PREFIX "/" T_CPU,        false, false },
+  { MQTT_PREFIX "/" T_LOG,        false, false },
+  { MQTT_PREFIX "/" T_NETWORK,    false, false },
+  { MQTT_PREFIX "/" T_RESULT,     false, false },
+  { MQTT_PREFIX "/" T_SKETCH,     false, false },
+  { MQTT_PREFIX "/" T_STATUS,     true,  false },
+  { MQTT_PREFIX "/" T_ISS "/" T_BATCH, false, true },
+  { MQTT_PREFIX "/" T_ISS "/" T_SDT,   false, true },
+  FIELD_TOPICS("1"), FIELD_TOPICS("2"), FIELD_TOPICS("3"), FIELD_TOPICS("4"),
+  FIELD_TOPICS("5"), FIELD_TOPICS("6"), FIELD_TOPICS("7"), FIELD_TOPICS("8")
+};
+static_assert(sizeof(TOPICS) / sizeof(TOPICS[0]) == TOPIC_NUM, "topic table does not match TOPIC_NUM");
+#define TOPIC_SUBTOPIC(id) (TOPICS[id].topic + sizeof(MQTT_PREFIX)) // topic without MQTT_PREFIX "/"
+
+// Fields, index: FIELD_xx
+typedef struct {
+  const char *name;                        // subtopic F_xx
+  uint8_t     packetField;                 // DAVIS_FIELD_xx of the packets carrying it, DAVIS_FIELD_NONE: all packets
+  uint8_t     decimals;                    // fixed point value [10^-decimals]
+  int32_t     deadband;                    // Default: published if changed by more [10^-decimals]
+  uint16_t    wrap;                        // value wraps around (e.g. 360 for a direction), 0: no
+  int32_t     deviation;                   // Default: error bound of the swinging door compression [10^-decimals]
+} IssField;
+const IssField FIELDS[FIELD_NUM] = {
+  { F_WINDSPEED,   DAVIS_FIELD_NONE,        2,  100, 0,   100 },  // 1 km/h
+  { F_WINDDIR,     DAVIS_FIELD_NONE,        0,   10, 360,  10 },  // 10°
+  { F_GUST,        DAVIS_FIELD_GUST,        2,  100, 0,   100 },  // 1 km/h
+  { F_TEMPERATURE, DAVIS_FIELD_TEMPERATURE, 2,   10, 0,    10 },  // 0.1 °C
+  { F_HUMIDITY,    DAVIS_FIELD_HUMIDITY,    2,  100, 0,   100 },  // 1 %rel
+  { F_RAINRATE,    DAVIS_FIELD_RAINRATE,    2,    0, 0,    10 },  // every change, 0.1 mm/h
+  { F_SOLAR,       DAVIS_FIELD_SOLAR,       2, 1000, 0,  1000 },  // 10
+  { F_GOLDCAP,     DAVIS_FIELD_GOLDCAP,     2,   10, 0,    10 },  // 0.1 V
+  { F_RAINDAY,     DAVIS_FIELD_RAINCLICKS,  0,    0, 0,     0 },  // every click
+  { F_RAINSUM,     DAVIS_FIELD_RAINCLICKS,  0,    0, 0,     0 }   // every click
+};
+
+// JSON Messages (rendered into a static buffer, no heap)
+char jsonBuf[JSON_BUFSIZE];
+JsonWriter json(jsonBuf, sizeof(jsonBuf));
+// Batch Mode: records collected until flushed, see batchAdd()
+char batchBuf[BATCH_BUFSIZE];
+JsonWriter batch(batchBuf, sizeof(batchBuf));
+// Compact ISS Messages (CBOR, rendered into a static buffer, no heap)
+uint8_t cborBuf[CBOR_BUFSIZE];
+CborWriter cbor(cborBuf, sizeof(cborBuf));
+// Swinging Door Compression per transmitter and field (FIELD_xx)
+SwingingDoor sdt[DAVIS_HOP_MAX_TX][FIELD_NUM];
+
+
+// Command Handlers
+void cmd_allrx   (const CommandArg *args, CommandReply &reply);
+void cmd_batch   (const CommandArg *args, CommandReply &reply);
+void cmd_batchcap(const CommandArg *args, CommandReply &reply);
+void cmd_deadband(const CommandArg *args, CommandReply &reply);
+void cmd_drain   (const CommandArg *args, CommandReply &reply);
+void cmd_fields  (const CommandArg *args, CommandReply &reply);
+void cmd_format  (const CommandArg *args, CommandReply &reply);
+void cmd_hello   (const CommandArg *args, CommandReply &reply);
+void cmd_help    (const CommandArg *args, CommandReply &reply);
+void cmd_newday  (const CommandArg *args, CommandReply &reply);
+void cmd_period  (const CommandArg *args, CommandReply &reply);
+void cmd_region  (const CommandArg *args, CommandReply &reply);
+void cmd_reset   (const CommandArg *args, CommandReply &reply);
+void cmd_reboot  (const CommandArg *args, CommandReply &reply);
+void cmd_sdt     (const CommandArg *args, CommandReply &reply);
+void cmd_sdtdev  (const CommandArg *args, CommandReply &reply);
+void cmd_setrc   (const CommandArg *args, CommandReply &reply);
+// Commands: "command", Arguments (s: String, d: Double, u: Unsigned Int), Handler
+// - looked up by a perfect hash built at compile time, see CommandTable
+constexpr Command COMMAND_LIST[] = {
+  { "allrx",    "u",  cmd_allrx    },   // allrx  - Switch on/Off Message for each Packed received
+  { "batch",    "uu", cmd_batch    },   // batch  - Set Batch Mode
+  { "batchcap", "u",  cmd_batchcap },   // batchcap - Set Latency Cap of Batch Mode
+  { "deadband", "sd", cmd_deadband },   // deadband - Set Deadband of a Field Topic
+  { "drain",    "u",  cmd_drain    },   // drain  - Set Rate of forwarding queued Messages
+  { "fields",   "u",  cmd_fields   },   // fields - Switch on/off Field Topics
+  { "format",   "us", cmd_format   },   // format - Select JSON or compact (CBOR) ISS Messages
+  { "hello",    "",   cmd_hello    },   // hello  - Ping
+  { "help",     "",   cmd_help     },   // help   - Send Help
+  { "newday",   "",   cmd_newday   },   // newday - Reset Daily Raincounter
+  { "period",   "u",  cmd_period   },   // period - Set Message Period
+  { "reboot",   "",   cmd_reboot   },   // reboot - Reboot ESP32
+  { "region",   "s",  cmd_region   },   // region - Select Frequency Region
+  { "reset",    "",   cmd_reset    },   // reset  - Reset Statistics
+  { "sdt",      "u",  cmd_sdt      },   // sdt    - Switch on/off Swinging Door Compression
+  { "sdtdev",   "sd", cmd_sdtdev   },   // sdtdev - Set Error Bound of Swinging Door Compression
+  { "setrc",    "u",  cmd_setrc    },   // setrc  - Set Raincounter
+};
+constexpr CommandTable commands(COMMAND_LIST);
+static_assert(commands.valid(), "command names must be unique");
+// Response of the Command executed by loop() (static buffer, no heap)
+char cmdReplyBuf[CMD_REPLY_SIZE];
+CommandReply cmdReply(cmdReplyBuf, sizeof(cmdReplyBuf));
 
 // DavisRFM69 radio;            
 DavisRFM69  radio(RFM_CS, RFM_IRQ);                               
+// Hop Timing
+DavisHopScheduler hopScheduler;
+// Jobs of loop(), see setupScheduler()
+DeadlineScheduler scheduler;
+hw_timer_t *hopTimer = NULL;
+// Settings
+Preferences prefs;
+// Store and Forward: Messages not published while disconnected
+OutboundQueue outbox;
+// Tasks, connected by bounded queues (NULL: network handled by loop(), e.g. during setup)
+TaskHandle_t    netTask  = NULL;           // WiFi, MQTT, OTA, see networkTask()
+TaskHandle_t    radioTask = NULL;          // loop(), woken by task notifications, see wakeRadioTask()
+RingbufHandle_t pubRing  = NULL;           // loop() -> netTask: PubItem followed by the payload
+QueueHandle_t   cmdQueue = NULL;           // netTask -> loop(): Commands received and parsed (CommandCall)
+typedef struct {
+  byte          topic;                     // Topic ID TOPIC_xx
+} PubItem;
 
 
 /************************************************************
  * Global Vars
  ************************************************************/ 
-boolean       g_Firstrun;                  // To handle things, once
-// CronJob
-uint32_t      g_LastCron_1s;               // ms used for 1 second cron
-uint32_t      g_LastCron_10s;              // ms used for 10 second cron
-uint32_t      g_LastCron_30s;              // ms used for 30 second cron
-uint32_t      g_LastCron_60s;              // ms used for 1 minute cron
-// MQTT
-uint32_t      g_MqttReconnectCount;        // How often the MQTT has been reconnected
-uint32_t      g_LastMqttReconnectAttempt;  // Last Time when a MQTT connect was initiated
+// WiFi & MQTT Connection, see monitorConnections()
+byte          g_netState;                  // Connection state NET_xx
+uint32_t      g_netStateSince;             // millis() when g_netState was entered
+uint32_t      g_netRetryDelay;             // [ms] Backoff before next attempt (NET_xx_BACKOFF)
+uint8_t       g_wifiFailures;              // WiFi attempts failed in a row
+uint8_t       g_mqttFailures;              // MQTT attempts failed in a row
+uint32_t      g_wifiConnects;              // How often WiFi has been connected
+uint32_t      g_MqttReconnectCount;        // How often MQTT has been connected
+volatile boolean g_wifiUp;                 // WiFi has an IP address (set by onWiFiEvent)
+volatile boolean g_wifiDropped;            // WiFi connection failed or lost (set by onWiFiEvent)
 // Wifi
-boolean       g_wificonnected;             // State of the WiFi connection
-uint32_t      g_LastNetMonitoring;         // Last Time when Wifi+MQTT have been monitored
 const char*   g_wifissid = WIFI_SSID;      // WiFi SSID
 const char*   g_wifipass = WIFI_PSK;       // WiFi Password, mus be stored in plain, because we have to use it anyway
 const char*   g_otahash = OTA_HASH;        // OTA Password as MD5 Hash, so an Attacker with access to this data can't get the passwort itself
 
+// Publish Statistics per Topic (index: TOPIC_xx)
+typedef struct {
+  uint32_t      published;                 // Messages published
+  uint32_t      bytes;                     // Payload bytes published
+  uint32_t      failed;                    // Messages not published (not connected, write error)
+} MqttTopicStats;
+MqttTopicStats g_topicStats[TOPIC_NUM];    // written by the network task only
+volatile uint32_t g_loopFailed[TOPIC_NUM]; // Messages of loop() not published (buffer too small), see countFailed()
+volatile uint32_t g_loopFailedSum;         // sum of g_loopFailed (written by loop() only)
+uint32_t      g_loopFailedSeen[TOPIC_NUM]; // g_loopFailed added to g_topicStats (network task)
+uint32_t      g_loopFailedSumSeen;         // g_loopFailedSum added to g_topicStats (network task)
+// Store and Forward
+uint32_t      g_bootId;                    // random ID of this boot, see OutboundRecord
+uint32_t      g_queueRate;                 // queued Messages forwarded per second, 0: hold
+// Tasks
+volatile uint32_t g_radioBusyUs;           // [us] time loop() was working (wraps, use differences)
+volatile uint32_t g_netBusyUs;             // [us] time networkTask() was working (wraps, use differences)
+volatile uint32_t g_radioIdleUs;           // [us] time loop() was sleeping (wraps, use differences)
+volatile uint32_t g_netIdleUs;             // [us] time networkTask() was waiting (wraps, use differences)
+volatile uint32_t g_radioWakeups;          // iterations of loop() (wraps, use differences)
+uint32_t      g_pubRingHighWater;          // [bytes] maximum of pubRing used
+uint32_t      g_pubDropped;                // Messages dropped, pubRing full
+uint32_t      g_cmdQueueHighWater;         // maximum number of Commands waiting in cmdQueue
+uint32_t      g_cmdDropped;                // Commands dropped, cmdQueue full or Command invalid
+volatile boolean g_netStatsReset;          // reset statistics owned by the network task
+volatile byte g_nvsRegion;                 // Region to be stored in NVS (set by loop())
+volatile boolean g_nvsRegionDirty;         // g_nvsRegion not stored yet, see saveSettings()
+volatile boolean g_nvsCborDirty;           // g_issCbor not stored yet, see saveSettings()
+uint32_t      g_radioStallMaxUs;           // [us] longest iteration of loop()
+uint32_t      g_netStallMaxUs;             // [us] longest iteration of networkLoop()
+byte          g_netStallState;             // Connection state NET_xx of the longest iteration
+volatile boolean g_radioStandby;           // OTA update started: switch radio to standby (done by loop())
+volatile boolean g_hopTimerExpired;        // Hop timer ISR: hop deadline reached (handled by loop())
+// Values not changing at runtime, read once at startup (avoid heap allocations while publishing)
+char          g_clientID[CLIENTID_SIZE];   // MQTT Client ID, see composeClientID()
+char          g_sketchMD5[33];             // MD5 of running sketch
+uint32_t      g_sketchSize;                // Size of running sketch
 // Reboot Timer
 boolean       g_rebootActive;              // if true trigger reeboot 5s after g_reboot_triggered
 uint32_t      g_rebootTriggered;           // millis() when reboot was started
 // RFM69
-byte          g_hopCount;                  // Number of Auto-Hops due to missing Packet
-uint32_t      g_lastRxTime;                // [ms] when last Packet was received
-uint32_t      g_sinceLastRx;               // [ms] how long it tooks since last Packet was received
-uint32_t      g_lastTimeout;               // Timestamp [ms] used to hop every PACKET_LONGHOP ms, when no packet has been received
-uint32_t      g_longestBlackout;           // Longest Time without reception 
-boolean       g_BlackoutTag;               // Tag to recognise first Blackout Hop 
-uint16_t      g_numBlackouts;              // How often did we have a Blackout (more than 25 Packets missed)
-uint16_t      g_packetsReceived;           // Number of packets with correct CRC
-uint16_t      g_autoHops;                  // How often did we HOP because of missing packets (up to 25 Packets missed)
-uint16_t      g_receivedStreak;            // Number of uninterruptedly receiverd correct packages
-uint16_t      g_receivedStreakMax;         // Maximum Number of uninterruptedly receiverd correct packages
-uint16_t      g_crcErrors;                 // Number of packets with CRC ERROR
+volatile byte     g_acqState;              // Acquisition state ACQ_xx
+volatile int64_t  g_acqUntil;              // [us] end of actual acquisition step
+volatile int64_t  g_acqStart;              // [us] start of acquisition (boot or all transmitters lost)
+volatile uint32_t g_acqCarriers;           // Carriers detected while acquiring
+volatile uint32_t g_acqLocks;              // Number of completed acquisitions
+volatile uint32_t g_timeToLockLast;        // [ms] duration of last acquisition
+volatile uint32_t g_timeToLockMax;         // [ms] longest acquisition
+volatile uint64_t g_timeToLockSum;         // [ms] sum of all acquisitions
+volatile uint32_t g_missedHops;            // Hops because of missing packets, counted by hopMissedPacket() 
+uint32_t      g_missedHopsSeen;            // g_missedHops already processed by pollRadio()
+volatile uint32_t g_hopLateCount;          // Number of hops measured for lateness
+volatile uint64_t g_hopLateSum;            // [us] Sum of hop lateness against deadline
+volatile int32_t  g_hopLateMax;            // [us] Maximum hop lateness against deadline
+uint16_t      g_crcErrors;                 // Number of packets with CRC ERROR (all transmitters)
+uint16_t      g_crcCorrected;              // Number of packets repaired by CRC error correction (all transmitters)
 boolean       g_sendReceivedPackets;       // Send all received packets with correct CRC
+uint8_t       g_issCbor;                   // Transmitters publishing compact (CBOR) Messages, bit n: ISS/n+1
+boolean       g_sendFields;                // Publish Field Topics (ISS/[ID]/[field]) on change
+int32_t       g_fieldDeadband[FIELD_NUM];  // Published if changed by more [10^-decimals], index: FIELD_xx
+int32_t       g_fieldLast[DAVIS_HOP_MAX_TX][FIELD_NUM]; // Values last published
+uint16_t      g_fieldSeen[DAVIS_HOP_MAX_TX];      // Fields received, bit: FIELD_xx
+uint16_t      g_fieldPublished[DAVIS_HOP_MAX_TX]; // Fields published (g_fieldLast valid), bit: FIELD_xx
+volatile boolean g_fieldResync;            // publish all Fields again (MQTT reconnected, set by network task)
+uint16_t      g_sdtSpan;                   // Swinging Door: longest time between points [s], 0: off
+int32_t       g_sdtDeviation[FIELD_NUM];   // Swinging Door: error bound [10^-decimals], index: FIELD_xx
 uint16_t      g_sendIntervall;             // Interval when Data should be published via MQTT
 uint32_t      g_lastDataSend;              // millis() when last Data has been published via MQTT
-// ISS Weather Values
-float         g_windSpeed;                 // Windspeed [km/h]
-uint16_t      g_windDirection;             // Directon of Wind [0-350°]
-boolean       g_transmitterBatteryStatus;  // Battery Status: 0: OK, 1: Warning
-float         g_goldcapChargeStatus;       // Goldcap Charge Status [V]     - msgID = 0x2 
-float         g_rainRate;                  // Rainrate [mm/h]               - msgID = 0x5
-float         g_solarRadiation;            // Solar Radiation [?]           - msgID = 0x7
-float         g_outsideTemperature;        // Outside Temperature [°C]      - msgID = 0x8
-float         g_gustSpeed;                 // Gust Speed [km/h]             - msgID = 0x9
-float         g_outsideHumidity;           // Outside Humidity [%rel]       - msgID = 0xa
-uint16_t      g_rainClicks;                // Rainclicks received [0-127]   - msgID = 0xe
-uint16_t      g_rainClicksLast;            // Last Rainclicks received
-uint16_t      g_rainClicksDay;             // Rainclicks since last reset
-unsigned long g_rainClicksSum;             // Rainclicks overall
+// Batch Mode (allrx), see batchAdd()
+uint8_t       g_batchCount;                // Flush after N records, 0: no limit
+uint16_t      g_batchPeriod;               // [s] Flush every T seconds, 0: no period (batch mode off if both are 0)
+uint16_t      g_batchLatency;              // [s] Latency cap: longest wait of a record
+uint8_t       g_batchRecords;              // Records in the pending batch
+int64_t       g_batchFirstUs;              // [us] Reception of the oldest record in the pending batch
+int64_t       g_batchWindow;               // Period number (esp_timer / g_batchPeriod) of the pending batch
+uint32_t      g_batchesSent;               // Batches published
+uint32_t      g_batchRecordsSent;          // Records published in batches
+uint32_t      g_batchFlushes[BATCH_FLUSH_NUM]; // Batches per flush reason BATCH_FLUSH_xx
+// State of one Transmitter (ISS, Anemometer Transmitter, Temp/Hum Station)
+typedef struct {
+  boolean       active;                    // Packet with correct CRC has been received
+  DavisPacket   lastPacket;                // Last packet received with correct CRC
+  // Statistics
+  int64_t       lastRxUs;                  // [us] when last Packet was received (PayloadReady, see DavisPacket)
+  uint32_t      sinceLastRx;               // [ms] how long it tooks since last Packet was received
+  uint32_t      longestBlackout;           // [ms] Longest Time without reception 
+  uint16_t      packetsReceived;           // Number of packets with correct CRC
+  uint16_t      receivedStreak;            // Number of uninterruptedly receiverd correct packages
+  uint16_t      receivedStreakMax;         // Maximum Number of uninterruptedly receiverd correct packages
+  uint32_t      missedSeen;                // Missed Packets (see DavisHopTx) already processed by pollRadio()
+  // ISS Weather Values (fixed point, see DavisMeasurement)
+  int32_t       windSpeed;                 // Windspeed [0.01 km/h]
+  uint16_t      windDirection;             // Directon of Wind [0-350°]
+  boolean       transmitterBatteryStatus;  // Battery Status: 0: OK, 1: Warning
+  int32_t       goldcapChargeStatus;       // Goldcap Charge Status [0.01 V]     - msgID = 0x2 
+  int32_t       rainRate;                  // Rainrate [0.01 mm/h]               - msgID = 0x5
+  int32_t       solarRadiation;            // Solar Radiation [0.01]             - msgID = 0x7
+  int32_t       outsideTemperature;        // Outside Temperature [0.01 °C]      - msgID = 0x8
+  int32_t       gustSpeed;                 // Gust Speed [0.01 km/h]             - msgID = 0x9
+  int32_t       outsideHumidity;           // Outside Humidity [0.01 %rel]       - msgID = 0xa
+  uint16_t      rainClicks;                // Rainclicks received [0-127]   - msgID = 0xe
+  uint16_t      rainClicksLast;            // Last Rainclicks received
+  uint16_t      rainClicksDay;             // Rainclicks since last reset
+  unsigned long rainClicksSum;             // Rainclicks overall
+} IssStation;
+IssStation    g_station[DAVIS_HOP_MAX_TX]; // index: Transmitter ID (0-7)
 
 
 /************************************************************
@@ -229,17 +558,179 @@ unsigned long g_rainClicksSum;             // Rainclicks overall
  * @param[in] uint64 0: Don't Send each received Packet, 1: Send each received Packet
  * @returns String "Sending all received Packets: Yes"
  ************************************************************/ 
-void cmd_allrx (MyCommandParser::Argument *args, char *response) {
-  String msgStr;  
-  msgStr = "Sending all received Packets: ";  
+void cmd_allrx(const CommandArg *args, CommandReply &reply) {
+  reply.add("Sending all received Packets: ");
   if (args[0].asUInt64 ==0) {
-    msgStr.concat("No");    
+    reply.add("No");    
     g_sendReceivedPackets = false;
   } else {
-    msgStr.concat("Yes");    
+    reply.add("Yes");    
     g_sendReceivedPackets = true;
   }   
-  msgStr.toCharArray(response, MyCommandParser::MAX_RESPONSE_SIZE);  
+}
+
+
+/************************************************************
+ * Command "batch"
+ * - Batch Mode: with allrx, records of received packets are 
+ *   collected and published as one message to ISS/batch
+ * - a pending batch is flushed first
+ * @param[in] uint64 N: flush after N records, 0: no limit
+ * @param[in] uint64 T: flush every T seconds, 0: no period
+ *            (both 0: batch mode off)
+ * @returns String "Batch: 8 Records, 20 s"
+ ************************************************************/ 
+void cmd_batch(const CommandArg *args, CommandReply &reply) {
+  batchFlush(BATCH_FLUSH_CONFIG);
+  g_batchCount  = (args[0].asUInt64 > 255) ? 255 : args[0].asUInt64;
+  g_batchPeriod = (args[1].asUInt64 > BATCH_LATENCY_MAX) ? BATCH_LATENCY_MAX : args[1].asUInt64;
+  if ((g_batchCount == 0) && (g_batchPeriod == 0)) {
+    reply.add("Batch: off");
+  } else {
+    reply.add("Batch: ");
+    reply.addUInt(g_batchCount);
+    reply.add(" Records, ");
+    reply.addUInt(g_batchPeriod);
+    reply.add(" s");
+  }
+}
+
+
+/************************************************************
+ * Command "batchcap"
+ * - Latency cap of the batch mode: a record is published at 
+ *   the latest S seconds after it has been received
+ * @param[in] uint64 S: 1 - BATCH_LATENCY_MAX seconds
+ * @returns String "Batch Latency Cap: 30 s"
+ ************************************************************/ 
+void cmd_batchcap(const CommandArg *args, CommandReply &reply) {
+  g_batchLatency = args[0].asUInt64;
+  if (g_batchLatency < 1) g_batchLatency = 1;
+  if (args[0].asUInt64 > BATCH_LATENCY_MAX) g_batchLatency = BATCH_LATENCY_MAX;
+  reply.add("Batch Latency Cap: ");
+  reply.addUInt(g_batchLatency);
+  reply.add(" s");
+}
+
+
+/************************************************************
+ * Command "drain"
+ * - Set Rate of forwarding queued Messages after Reconnect
+ * @param[in] uint64 Messages per Second, 0: hold queued Messages
+ * @returns String "Forwarding 5 queued Messages per Second"
+ ************************************************************/ 
+void cmd_drain(const CommandArg *args, CommandReply &reply) {
+  g_queueRate = args[0].asUInt64;
+  reply.add("Forwarding ");
+  reply.addUInt(g_queueRate);
+  reply.add(" queued Messages per Second");
+}
+
+
+/************************************************************
+ * Set a value per field (arguments: field, value)
+ * - used by the commands "deadband" and "sdtdev"
+ * - value in units of the field, stored in 10^-decimals of 
+ *   the field, negative values as 0
+ * @param[in]  args   String field, e.g. "temperature", 
+ *                    double value, e.g. 0.1
+ * @param[out] reply  "[label] temperature: 0.10" or error
+ * @param[in]  label  e.g. "Deadband"
+ * @param[out] values value per field, index: FIELD_xx
+ * @return     false if the field is unknown
+ ************************************************************/ 
+boolean cmdSetFieldValue(const CommandArg *args, CommandReply &reply, const char *label, int32_t *values) {
+  char num[JSON_WRITER_NUM_LEN];
+  byte f;
+  double value;
+  for (f = 0; f < FIELD_NUM; f++) {
+    if (strcasecmp(args[0].asString, FIELDS[f].name) == 0) break;
+  }
+  if (f >= FIELD_NUM) {
+    reply.add("Unknown Field, see help");
+    return false;
+  }
+  value = args[1].asDouble;
+  for (byte d = 0; d < FIELDS[f].decimals; d++) value *= 10;
+  values[f] = (value <= 0) ? 0 : (value >= INT32_MAX) ? INT32_MAX : (int32_t)lround(value);
+  JsonWriter::formatFixed(values[f], FIELDS[f].decimals, num);
+  reply.add(label);
+  reply.add(" ");
+  reply.add(FIELDS[f].name);
+  reply.add(": ");
+  reply.add(num);
+  return true;
+}
+
+
+/************************************************************
+ * Command "deadband"
+ * - Field Topics: a field is published if its value changed 
+ *   by more than the deadband (0: every change)
+ * @param[in] String field, e.g. "temperature"
+ * @param[in] double deadband in units of the field, e.g. 0.1
+ * @returns String "Deadband temperature: 0.10"
+ ************************************************************/ 
+void cmd_deadband(const CommandArg *args, CommandReply &reply) {
+  cmdSetFieldValue(args, reply, "Deadband", g_fieldDeadband);
+}
+
+
+/************************************************************
+ * Command "fields"
+ * - Field Topics: each measurement on its own retained 
+ *   subtopic ISS/[ID]/[field], published on change
+ * - when switched on, all fields received so far are 
+ *   published at once
+ * @param[in] uint64 0: off, 1: on
+ * @returns String "Publishing Field Topics: Yes"
+ ************************************************************/ 
+void cmd_fields(const CommandArg *args, CommandReply &reply) {
+  reply.add("Publishing Field Topics: ");
+  if (args[0].asUInt64 == 0) {
+    reply.add("No");    
+    g_sendFields = false;
+  } else {
+    reply.add("Yes");    
+    g_sendFields = true;
+    g_fieldResync = true;
+  }   
+}
+
+
+/************************************************************
+ * Command "format"
+ * - Format of ISS Messages per Transmitter, stored in NVS 
+ *   by the network task (saveSettings())
+ *   - json: JSON Message, see sendIssData()
+ *   - cbor: compact Message, see sendIssCbor()
+ * @param[in] uint64 ID: Transmitter ID 1-8, 0: all
+ * @param[in] String "json" or "cbor"
+ * @returns String "Format cbor: ISS/1 ISS/3"
+ ************************************************************/ 
+void cmd_format(const CommandArg *args, CommandReply &reply) {
+  uint8_t mask;
+  if (args[0].asUInt64 > DAVIS_HOP_MAX_TX) {
+    reply.add("Unknown Transmitter ID, known: 0 (all), 1 - 8");
+  } else if ((strcasecmp(args[1].asString, "json") != 0) && (strcasecmp(args[1].asString, "cbor") != 0)) {
+    reply.add("Unknown Format, known: json, cbor");
+  } else {
+    mask = args[0].asUInt64 ? (1 << (args[0].asUInt64 - 1)) : 0xff;
+    if (strcasecmp(args[1].asString, "cbor") == 0) {
+      g_issCbor |= mask;
+    } else {
+      g_issCbor &= ~mask;
+    }
+    g_nvsCborDirty = true;
+    reply.add("Format cbor:");
+    for (byte id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+      if (g_issCbor & (1 << id)) {
+        reply.add(" " T_ISS "/");
+        reply.addUInt(id + 1);
+      }
+    }
+    if (!g_issCbor) reply.add(" none");
+  }
 }
 
 
@@ -249,10 +740,8 @@ void cmd_allrx (MyCommandParser::Argument *args, char *response) {
  * @param[in] void
  * @returns String "world"
  ************************************************************/ 
-void cmd_hello(MyCommandParser::Argument *args, char *response) {  
-  String msgStr;  
-  msgStr = "world";  
-  msgStr.toCharArray(response, MyCommandParser::MAX_RESPONSE_SIZE);
+void cmd_hello(const CommandArg *args, CommandReply &reply) {
+  reply.add("world");
 }
 
 /************************************************************
@@ -261,12 +750,10 @@ void cmd_hello(MyCommandParser::Argument *args, char *response) {
  * @param[in] void
  * @returns String "OK"
  ************************************************************/ 
-void cmd_help (MyCommandParser::Argument *args, char *response) {  
-  String msgStr;  
+void cmd_help(const CommandArg *args, CommandReply &reply) {
   sendHelp();
-  msgStr = "Help published on Topic: ";  
-  msgStr.concat(MQTT_PREFIX "/" T_HELP);
-  msgStr.toCharArray(response, MyCommandParser::MAX_RESPONSE_SIZE);
+  reply.add("Help published on Topic: ");
+  reply.add(MQTT_PREFIX "/" T_HELP);
 }
 
 /************************************************************
@@ -274,11 +761,11 @@ void cmd_help (MyCommandParser::Argument *args, char *response) {
  * @param[in] void
  * @returns String "Daily Rain-Click counter set to 0"
  ************************************************************/ 
-void cmd_newday(MyCommandParser::Argument *args, char *response) {  
-  String msgStr;    
-  g_rainClicksDay = 0;
-  msgStr = "Daily Rain-Click counter set to 0";    
-  msgStr.toCharArray(response, MyCommandParser::MAX_RESPONSE_SIZE);
+void cmd_newday(const CommandArg *args, CommandReply &reply) {
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    g_station[id].rainClicksDay = 0;
+  }
+  reply.add("Daily Rain-Click counter set to 0");
 }
 
 /************************************************************
@@ -286,12 +773,10 @@ void cmd_newday(MyCommandParser::Argument *args, char *response) {
  * @param[in] uint64 time in seconds - 0: Nont Send
  * @returns String "Message Period set to 42"
  ************************************************************/ 
-void cmd_period  (MyCommandParser::Argument *args, char *response) {
-  String msgStr;  
+void cmd_period(const CommandArg *args, CommandReply &reply) {
   g_sendIntervall = args[0].asUInt64;
-  msgStr = "Message Period set to ";  
-  msgStr.concat(g_sendIntervall);
-  msgStr.toCharArray(response, MyCommandParser::MAX_RESPONSE_SIZE);  
+  reply.add("Message Period set to ");
+  reply.addUInt(g_sendIntervall);
 }
 
 /************************************************************
@@ -300,12 +785,39 @@ void cmd_period  (MyCommandParser::Argument *args, char *response) {
  * @param[in] void
  * @returns String "Rebooting in 5 seconds ... [please standby]."
  ************************************************************/ 
-void cmd_reboot(MyCommandParser::Argument *args, char *response) {
-  String msgStr;  
-  msgStr = "Rebooting in 5 seconds ... [please standby].";
+void cmd_reboot(const CommandArg *args, CommandReply &reply) {
+  reply.add("Rebooting in 5 seconds ... [please standby].");
   g_rebootActive = true;
   g_rebootTriggered = millis();
-  msgStr.toCharArray(response, MyCommandParser::MAX_RESPONSE_SIZE);    
+}
+
+/************************************************************
+ * Command "region"
+ * - Select Frequency Region, stored in NVS by the network 
+ *   task (saveSettings()), no flash write in loop()
+ * @param[in] String "US" or "EU"
+ * @returns String "Region set to EU"
+ ************************************************************/ 
+void cmd_region(const CommandArg *args, CommandReply &reply) {
+  byte region;
+  for (region = 0; region < DAVIS_REGION_NUM; region++) {
+    if (strcasecmp(args[0].asString, DavisRFM69::regionName(region)) == 0) {
+      break;
+    }
+  }
+  if (region < DAVIS_REGION_NUM) {
+    selectRegion(region);
+    g_nvsRegion = region;
+    g_nvsRegionDirty = true;                       // after the value, see saveSettings()
+    reply.add("Region set to ");
+    reply.add(DavisRFM69::regionName(region));
+  } else {
+    reply.add("Unknown Region, known: ");
+    for (region = 0; region < DAVIS_REGION_NUM; region++) {
+      reply.add(DavisRFM69::regionName(region));
+      reply.add(region < DAVIS_REGION_NUM - 1 ? ", " : "");
+    }
+  }
 }
 
 /************************************************************
@@ -314,31 +826,97 @@ void cmd_reboot(MyCommandParser::Argument *args, char *response) {
  * @param[in] void
  * @returns String "Statistics resetted."
  ************************************************************/ 
-void cmd_reset(MyCommandParser::Argument *args, char *response) {
-  String msgStr;  
-  msgStr = "Statistics resetted.";
-  g_longestBlackout   = 0;  // Longest Time without reception 
-  g_packetsReceived   = 0;  // Number of packets with correct CRC
-  g_autoHops          = 0;  // How often did we HOP because of missing packets
-  g_numBlackouts      = 0;  // How often did we have to resync
-  g_receivedStreak    = 0;  // Number of uninterruptedly receiverd correct packages
-  g_receivedStreakMax = 0;  // Maximum Number of uninterruptedly receiverd correct packages
+void cmd_reset(const CommandArg *args, CommandReply &reply) {
+  reply.add("Statistics resetted.");
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    IssStation &st = g_station[id];
+    st.longestBlackout   = 0;  // Longest Time without reception 
+    st.packetsReceived   = 0;  // Number of packets with correct CRC
+    st.receivedStreak    = 0;  // Number of uninterruptedly receiverd correct packages
+    st.receivedStreakMax = 0;  // Maximum Number of uninterruptedly receiverd correct packages
+    st.missedSeen        = 0;
+  }
+  hopScheduler.resetStats();   // Missed packets and blackouts per transmitter
   g_crcErrors         = 0;  // Number of packets with CRC ERROR  
-  msgStr.toCharArray(response, MyCommandParser::MAX_RESPONSE_SIZE);    
+  g_crcCorrected      = 0;  // Number of packets repaired by CRC error correction
+  g_netStatsReset     = true;  // Publish statistics, Store and Forward, Command Queue (by network task)
+  g_pubRingHighWater  = 0;  // Publish Queue
+  g_pubDropped        = 0;
+  g_radioStallMaxUs   = 0;  // longest iteration of loop()
+  g_batchesSent       = 0;  // Batch Mode
+  g_batchRecordsSent  = 0;
+  memset(g_batchFlushes, 0, sizeof(g_batchFlushes));
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {  // Swinging Door
+    for (byte f = 0; f < FIELD_NUM; f++) sdt[id][f].resetStats();
+  }
+  radio.resetRingStats();   // Ring high water mark and overflows
+  radio.resetChannelStats();   // Packets and CRC errors per channel
+  g_hopLateCount      = 0;  // Hop lateness 
+  g_hopLateSum        = 0;
+  g_hopLateMax        = 0;
+  g_acqCarriers       = 0;  // Acquisition
+  g_acqLocks          = 0;
+  g_timeToLockLast    = 0;
+  g_timeToLockMax     = 0;
+  g_timeToLockSum     = 0;
 }
 
+/************************************************************
+ * Command "sdt"
+ * - Swinging Door Compression: per transmitter and field, 
+ *   only the points needed to reconstruct the series within 
+ *   the error bound (command "sdtdev") are published to ISS/sdt
+ * - switched off: points held back are published
+ * @param[in] uint64 S: a point at least every S seconds, 0: off
+ * @returns String "Swinging Door: 600 s"
+ ************************************************************/ 
+void cmd_sdt(const CommandArg *args, CommandReply &reply) {
+  if (args[0].asUInt64 == 0) {
+    sdtFlush();
+    g_sdtSpan = 0;
+    reply.add("Swinging Door: off");
+  } else {
+    if (!g_sdtSpan) {
+      // start new series
+      for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+        for (byte f = 0; f < FIELD_NUM; f++) sdt[id][f].reset();
+      }
+    }
+    g_sdtSpan = (args[0].asUInt64 > SDT_SPAN_MAX) ? SDT_SPAN_MAX : args[0].asUInt64;
+    sdtConfigure();
+    reply.add("Swinging Door: ");
+    reply.addUInt(g_sdtSpan);
+    reply.add(" s");
+  }
+}
+
+
+/************************************************************
+ * Command "sdtdev"
+ * - Swinging Door Compression: error bound of a field, each 
+ *   value is reconstructed within +/- E (0: only values on a 
+ *   straight line are dropped)
+ * @param[in] String field, e.g. "temperature"
+ * @param[in] double E in units of the field, e.g. 0.1
+ * @returns String "Swinging Door temperature: 0.10"
+ ************************************************************/ 
+void cmd_sdtdev(const CommandArg *args, CommandReply &reply) {
+  if (cmdSetFieldValue(args, reply, "Swinging Door", g_sdtDeviation)) {
+    sdtConfigure();
+  }
+}
+
+
 /************************************************************
  * Command "setrc NEWVAL"
- * - Set Raincounter
+ * - Set Raincounter of transmitter RAIN_TX_ID
  * @param[in] void
  * @returns String "Raincounter set to 42"
  ************************************************************/ 
-void cmd_setrc(MyCommandParser::Argument *args, char *response) {      
-  String msgStr;  
-  g_rainClicksSum = args[0].asUInt64;
-  msgStr = "Raincounter set to ";  
-  msgStr.concat(g_rainClicksSum);
-  msgStr.toCharArray(response, MyCommandParser::MAX_RESPONSE_SIZE);  
+void cmd_setrc(const CommandArg *args, CommandReply &reply) {
+  g_station[RAIN_TX_ID].rainClicksSum = args[0].asUInt64;
+  reply.add("Raincounter set to ");
+  reply.addUInt(g_station[RAIN_TX_ID].rainClicksSum);
 }
 
 
@@ -364,183 +942,694 @@ String composeClientID(void) {
  * Debug Print String
  * - to Serial Console 
  * - MQTT-Message to TOPIC_LOG
- * @param[in] mes Message to be send
+ * @param[in] msg Message to be send, terminated
  ************************************************************/ 
-void dbgout(String msg){  
-  mqttPub (T_LOG, msg, false);
+void dbgout(const char *msg){  
+  mqttPublish(TOPIC_LOG, msg, strlen(msg), false);
 }
 
 
 /************************************************************
  * Monitor Connections
- * - Check Wifi (and reconnect)
- * - Check MQTT (and reconnect)
- * TODO: reconnect on wifi error without rebooting!
+ * - non-blocking state machine, called by the network task,
+ *   never waits for WiFi, DNS, TCP or the broker:
+ *   NET_WIFI_WAIT -> NET_MQTT_TCP -> NET_MQTT_CONNACK -> NET_ONLINE
+ * - WiFi state is taken from WiFi events (onWiFiEvent)
+ * - TCP connect and MQTT handshake: see MqttTransport
+ * - failed attempts are repeated after an exponential backoff
+ *   with jitter (NET_WIFI_BACKOFF, NET_MQTT_BACKOFF)
  ************************************************************/ 
 void monitorConnections(void) {  
-  // Monitor WIFI- and MQTT-Connection   
-  if (millis() - g_LastNetMonitoring > T_NET_MONITORING) {    
-    // Monitor WIFI-Connection   
-    g_LastNetMonitoring = millis();
-    DBG_MONITOR.print("!!! WiFi localIP: ");
-    DBG_MONITOR.println(WiFi.localIP());    
-    if ((WiFi.status() != WL_CONNECTED) || (WiFi.localIP()[0] == 0)) {      
-      DBG_ERROR.println("WiFi CONNECTION LOST");
-      DBG_ERROR.println("reconnecting ...");
-      WiFi.disconnect();
-      WiFi.reconnect();
-      if (WiFi.status() != WL_CONNECTED) {      
-        DBG_ERROR.println("WiFi RECONNECTION FAILED, TRYING AGAIN LATER");  
-        DBG_MONITOR.println("Not Monitoring MQTT because WiFi OFFLINE");     
-        g_wificonnected = false;
-      } else {        
-        DBG_ERROR.println("WiFi CONNECTION RESTORED");
-        g_wificonnected = true;
+  uint32_t elapsed = millis() - g_netStateSince;
+  int8_t rc;
+  // WiFi lost: close MQTT connection, reconnect WiFi
+  if (g_wifiDropped && (g_netState != NET_WIFI_WAIT) && (g_netState != NET_WIFI_BACKOFF)) {
+    DBG_ERROR.println("WiFi CONNECTION LOST");
+    mqttClose();
+    WiFi.disconnect();
+    setNetState(NET_WIFI_BACKOFF, backoffDelay(0));
+    return;
+  }
+  switch (g_netState) {
+    // WiFi
+    case NET_WIFI_WAIT:
+      if (g_wifiUp) {
+        DBG_MONITOR.print("WiFi CONNECTED, IP: ");
+        DBG_MONITOR.println(WiFi.localIP());
+        g_wifiFailures = 0;
+        g_wifiConnects++;
+        setNetState(NET_MQTT_BACKOFF, 0);
+      } else if (g_wifiDropped || (elapsed > T_WIFI_CONNECT)) {
+        DBG_ERROR.println("WiFi CONNECTION FAILED, TRYING AGAIN LATER");
+        WiFi.disconnect();
+        setNetState(NET_WIFI_BACKOFF, backoffDelay(g_wifiFailures++));
       }
-    } else {        
-        DBG_MONITOR.println("Monitoring WiFi... ONLINE");
-        g_wificonnected = true;
-    }
-    // Monitor MQTT-Connection
-    if (g_wificonnected){
-      DBG_MONITOR.print("!!! MQTT: ");      
-      if (!mqtt.connected()) {        
-        if (millis() - g_LastMqttReconnectAttempt > T_MQTT_RECONNECT) {
-          g_LastMqttReconnectAttempt = millis();
-          g_MqttReconnectCount++;
-          DBG_ERROR.print("MQTT Connection lost! - Error:");
-          DBG_ERROR.println("mqtt.state()");
-          DBG_ERROR.print(" - trying to reconnect [");
-          DBG_ERROR.print(g_MqttReconnectCount);
-          DBG_ERROR.println("]... ");      
-          // Attempt to reconnect
-          String myClientID;
-          myClientID = composeClientID();
-          if (mqtt.connect(myClientID.c_str(), MQTT_USER, MQTT_PASS, MQTT_PREFIX "/" T_STATUS, 1, true, STATUS_MSG_OFF, true))  { 
-            // connected: publish Status ONLINE
-            mqtt.publish(MQTT_PREFIX "/" T_STATUS, STATUS_MSG_ON, true);
-            // resubscribe
-            mqtt.subscribe(MQTT_PREFIX "/" T_CMD);          
-            g_LastMqttReconnectAttempt = 0;
-            g_MqttReconnectCount = 0;
-            DBG_ERROR.println("MQTT SUCCESSFULLY RECONNECTED");
-          } else {
-            DBG_ERROR.println("MQTT RECONNECTION FAILED");
-          } 
-        } 
-      } else {
-        DBG_MONITOR.println("... ONLINE");             
+      break;
+    case NET_WIFI_BACKOFF:
+      if (elapsed >= g_netRetryDelay) {
+        DBG_ERROR.println("WiFi reconnecting ...");
+        g_wifiDropped = false;
+        WiFi.begin(g_wifissid, g_wifipass);
+        setNetState(NET_WIFI_WAIT, 0);
       }
-    }
-  } 
+      break;
+    // MQTT
+    case NET_MQTT_BACKOFF:
+      if (elapsed >= g_netRetryDelay) {
+        DBG_ERROR.print("MQTT connecting [");
+        DBG_ERROR.print(g_mqttFailures + 1);
+        DBG_ERROR.println("]... ");      
+        if (transport.beginConnect(MQTT_SERVER, MQTT_PORT)) {
+          setNetState(NET_MQTT_TCP, 0);
+        } else {
+          mqttFailed("DNS");
+        }
+      }
+      break;
+    case NET_MQTT_TCP:
+      rc = transport.pollConnect();
+      if (rc > 0) {
+        // send CONNECT, the CONNACK is not waited for
+        if (mqttSendConnect()) {
+          setNetState(NET_MQTT_CONNACK, 0);
+        } else {
+          mqttFailed("CONNECT");
+        }
+      } else if ((rc < 0) || (elapsed > T_MQTT_CONNECT)) {
+        mqttFailed("TCP");
+      }
+      break;
+    case NET_MQTT_CONNACK:
+      rc = transport.pollConnack();
+      if (rc > 0) {
+        // CONNACK accepted: the session takes over the connection
+        mqtt.begin(MQTT_KEEPALIVE);
+        mqttConnected();
+      } else if (rc < 0) {
+        DBG_ERROR.print("CONNACK: ");
+        DBG_ERROR.println(transport.connackCode());
+        mqttFailed(transport.connected() ? "refused" : "closed by broker");
+      } else if (elapsed > T_MQTT_CONNECT) {
+        mqttFailed("no CONNACK");
+      }
+      break;
+    case NET_ONLINE:
+      if (!mqtt.connected()) {
+        DBG_ERROR.print("MQTT Connection lost! - Error: ");
+        DBG_ERROR.println(mqtt.state());
+        mqttClose();
+        setNetState(NET_MQTT_BACKOFF, backoffDelay(g_mqttFailures++));
+      }
+      break;
+  }
+}
+
+
+/************************************************************
+ * Change Connection State
+ * @param[in] state NET_xx
+ * @param[in] retryDelay [ms] Backoff (NET_xx_BACKOFF)
+ ************************************************************/ 
+void setNetState(byte state, uint32_t retryDelay) {
+  g_netState = state;
+  g_netStateSince = millis();
+  g_netRetryDelay = retryDelay;
+  DBG_MONITOR.print("!!! Connection: ");
+  DBG_MONITOR.print(NET_STATE_NAMES[state]);
+  if (retryDelay) {
+    DBG_MONITOR.print(", retry in [ms] ");
+    DBG_MONITOR.print(retryDelay);
+  }
+  DBG_MONITOR.println();
+}
+
+
+/************************************************************
+ * Reconnect Delay
+ * - exponential backoff: T_BACKOFF_MIN * 2^failures, 
+ *   limited to T_BACKOFF_MAX
+ * - jitter: random delay between 50% and 100% of it, so 
+ *   many gateways do not hit the broker at the same time
+ * @param[in] failures attempts failed in a row
+ * @return [ms]
+ ************************************************************/ 
+uint32_t backoffDelay(uint8_t failures) {
+  uint32_t d = T_BACKOFF_MAX;
+  if (failures < 16) {
+    d = (uint32_t)T_BACKOFF_MIN << failures;
+    if (d > T_BACKOFF_MAX) d = T_BACKOFF_MAX;
+  }
+  return d - esp_random() % (d / 2 + 1);
+}
+
+
+/************************************************************
+ * Send CONNECT on the TCP connection of transport
+ * - LastWill: STATUS_MSG_OFF to TOPIC_STATUS, retained
+ * - keep alive MQTT_KEEPALIVE, the pings are sent by 
+ *   mqtt.loop() once connected
+ * @return false on error
+ ************************************************************/ 
+boolean mqttSendConnect(void) {
+  return transport.sendConnect(g_clientID, MQTT_USER, MQTT_PASS, TOPICS[TOPIC_STATUS].topic, 1, true, STATUS_MSG_OFF, true, MQTT_KEEPALIVE);
+}
+
+
+/************************************************************
+ * MQTT connected
+ * - publish Status ONLINE
+ * - (re)subscribe to commands
+ ************************************************************/ 
+void mqttConnected(void) {
+  g_mqttFailures = 0;
+  g_MqttReconnectCount++;
+  setNetState(NET_ONLINE, 0);
+  mqttPublish(TOPIC_STATUS, STATUS_MSG_ON, sizeof(STATUS_MSG_ON) - 1, true);
+  mqtt.subscribe(MQTT_PREFIX "/" T_CMD);          
+  g_fieldResync = true;                           // changes may have been lost while offline
+  wakeRadioTask();
+  DBG_ERROR.println("MQTT SUCCESSFULLY CONNECTED");
+}
+
+
+/************************************************************
+ * MQTT Connection attempt failed: close, wait for next attempt
+ * @param[in] reason for debug output
+ ************************************************************/ 
+void mqttFailed(const char *reason) {
+  DBG_ERROR.print("MQTT CONNECTION FAILED: ");
+  DBG_ERROR.println(reason);
+  mqttClose();
+  setNetState(NET_MQTT_BACKOFF, backoffDelay(g_mqttFailures++));
+}
+
+
+/************************************************************
+ * Close MQTT Connection (without waiting)
+ ************************************************************/ 
+void mqttClose(void) {
+  transport.stop();
+  mqtt.end();
+}
+
+
+/************************************************************
+ * WiFi Event (WiFi event task)
+ * @param[in] event ARDUINO_EVENT_WIFI_xx
+ ************************************************************/ 
+void onWiFiEvent(WiFiEvent_t event) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      g_wifiUp = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      g_wifiUp = false;
+      g_wifiDropped = true;
+      break;
+    default:
+      break;
+  }
 }
 
 
 /************************************************************
  * MQTT Message Received
  * - Callback function started when MQTT Message received
- * - convert Payload to lower case
- * - 
+ * - the Command is parsed where it is (mqttBuf, 
+ *   not terminated), no copies of the Message
+ * - invalid Commands are answered at once, valid ones are 
+ *   handed over to loop() as CommandCall (index of the 
+ *   Command and Arguments)
  * @param[in] topic Topic received
  * @param[in] topic Message received
  * @param[in] length Length of the Message received
  ************************************************************/ 
 void mqttCallback(char* topic, byte* payload, unsigned int length) {  
-  String msg;  
-  char* myBuf = (char*)malloc(length + 1);    
-  char response[MyCommandParser::MAX_RESPONSE_SIZE];
-  // copy Buffer to String
-  //   payload[length] = '\0';  // ensure that buffer is null-terminated
-  //   msg = String((char*)payload);
-  // Copy payload to new buffer and add '0x00' to the end
-  for (int i=0; i<length; i++) {
-    myBuf [i] = payload [i] ;
-  }
-  myBuf[length] = '\0';
-  // Convert Buffer to String
-  msg = String((char*)myBuf);    
-  // convert String to Lower-Case
-  // msg.toLowerCase();
-  // Echo String
-  dbgout("received MQTT-Message: \"" + msg + "\"");
-  // Parse Command    
-  msg.toCharArray(myBuf, msg.length() + 1);    
-  parser.processCommand(myBuf, response);            
-  // Publish Result;
-  mqttPub (T_RESULT, String(response), false);
-  // free(msgBuf);
-  free(myBuf);
-}
-
-
-/************************************************************
- * Publish & Print Message
+  CommandCall call;
+  const char *error;
+  char msgBuf[CMD_REPLY_SIZE];
+  CommandReply msg(msgBuf, sizeof(msgBuf));
+  UBaseType_t waiting;
+  // Echo Command
+  DBG.print("received MQTT-Message: \"");
+  DBG.write(payload, length);
+  DBG.println("\"");
+  // Parse Command
+  error = commands.parse((const char *)payload, length, call);
+  if (error) {
+    g_cmdDropped++;
+    msg.add("ERROR: ");
+    msg.add(error);
+    mqttPublish(TOPIC_RESULT, msg.c_str(), msg.length(), false);
+    return;
+  }
+  // Before the tasks are started: execute at once
+  if (!cmdQueue) {
+    executeCommand(call);
+    return;
+  }
+  // Execute in loop() (Commands change radio and station state)
+  if (xQueueSend(cmdQueue, &call, 0) != pdTRUE) {
+    g_cmdDropped++;
+    static const char QUEUE_FULL[] = "ERROR: Command Queue full";
+    mqttPublish(TOPIC_RESULT, QUEUE_FULL, sizeof(QUEUE_FULL) - 1, false);
+    return;
+  }
+  waiting = uxQueueMessagesWaiting(cmdQueue);
+  if (waiting > g_cmdQueueHighWater) g_cmdQueueHighWater = waiting;
+  wakeRadioTask();
+}
+
+
+/************************************************************
+ * Execute Commands received by mqttCallback()
+ * - called by loop()
+ ************************************************************/ 
+void processCommands(void) {
+  CommandCall call;
+  if (!cmdQueue) return;
+  while (xQueueReceive(cmdQueue, &call, 0) == pdTRUE) {
+    executeCommand(call);
+  }
+}
+
+
+/************************************************************
+ * Execute Command and publish Result
+ * - the Handler writes the Result into cmdReply (static 
+ *   buffer, no heap)
+ * @param[in] call Command parsed by mqttCallback()
+ ************************************************************/ 
+void executeCommand(const CommandCall &call) {
+  commands.execute(call, cmdReply);
+  mqttPublish(TOPIC_RESULT, cmdReply.c_str(), cmdReply.length(), false);
+}
+
+
+/************************************************************
+ * Publish & Print Message without copies
  * - to Serial Console
  *   - if mqttOnly is false
- * - Publish MQTT-Message to topic MQTT_PREFIX/TOPIC_LOG
- *   - MQTT_PREFIX is added by this function
- * @param[in] topic MQTT-SubTopic (MQTT_PREFIX will be added)
- * @param[in] msg Message to be send
+ * - Publish MQTT-Message
+ *   - by the network task: at once, see mqttDeliver()
+ *   - by other tasks: handed over to the network task 
+ *     (pubRing), never blocking
+ * @param[in] topic Topic ID TOPIC_xx
+ * @param[in] buf Message to be send
+ * @param[in] len Length of message
  * @param[in] mqttOnly if false, then also Serial Output is generated
+ * @return true if published or handed over to the network task
  ************************************************************/ 
-void mqttPub(String subtopic, String msg, boolean mqttOnly){  
-  String myTopic;
+boolean mqttPublish(byte topic, const char *buf, size_t len, boolean mqttOnly){  
+  void *item = NULL;
+  size_t used;
   // Serial
   if (!mqttOnly) {
-    DBG.println(msg);    
+    DBG.write((const uint8_t *)buf, len);    
+    DBG.println();
   }  
-  // MQTT Topic
-  myTopic = MQTT_PREFIX;
-  myTopic.concat("/" + subtopic);
-  char* topicBuf = (char*)malloc(myTopic.length() + 1);  // allocate memory
-  myTopic.toCharArray(topicBuf, myTopic.length() + 1);  
-  // MQTT Message
-  char* msgBuf = (char*)malloc(msg.length() + 1);  // allocate memory
-  msg.toCharArray(msgBuf, msg.length() + 1);  
-  if (mqtt.connected()) {
-    mqtt.publish(topicBuf, msgBuf);
-  } else {
+  // Network task (or not started yet)
+  if (!netTask || (xTaskGetCurrentTaskHandle() == netTask)) {
+    return mqttDeliver(topic, buf, len);
+  }
+  // Other tasks: copy to pubRing
+  if (xRingbufferSendAcquire(pubRing, &item, sizeof(PubItem) + len, 0) != pdTRUE) {
+    g_pubDropped++;
+    DBG_ERROR.print("ERROR: Publish Queue full, dropped Message of Topic ");
+    DBG_ERROR.println(TOPIC_SUBTOPIC(topic));
+    return false;
+  }
+  ((PubItem *)item)->topic = topic;
+  memcpy((PubItem *)item + 1, buf, len);
+  xRingbufferSendComplete(pubRing, item);
+  used = PUB_RING_SIZE - xRingbufferGetCurFreeSize(pubRing);
+  if (used > g_pubRingHighWater) g_pubRingHighWater = used;
+  return true;
+}
+
+
+/************************************************************
+ * Deliver Message (network task)
+ * - Publish MQTT-Message, see mqttSend()
+ * - Messages of topics marked "store" in TOPICS which could
+ *   not be published are kept in the outbox and forwarded
+ *   after reconnect, see forwardQueued()
+ * @param[in] topic Topic ID TOPIC_xx
+ * @param[in] buf Message to be send
+ * @param[in] len Length of message
+ * @return true if published
+ ************************************************************/ 
+boolean mqttDeliver(byte topic, const char *buf, size_t len){  
+  OutboundRecord rec;
+  // MQTT
+  if (mqttSend(topic, buf, len)) return true;
+  // Store and Forward
+  if (TOPICS[topic].store) {
+    rec.topic    = topic;
+    rec.len      = (uint16_t)((len > OUTBOUND_PAYLOAD_MAX) ? OUTBOUND_PAYLOAD_MAX + 1 : len);
+    rec.bootId   = g_bootId;
+    rec.uptimeMs = esp_timer_get_time() / 1000;
+    rec.epochMs  = epochMs();
+    if (!outbox.push(rec, buf)) {
+      DBG_ERROR.print("ERROR: Outbox dropped Message of Topic ");
+      DBG_ERROR.println(TOPIC_SUBTOPIC(topic));
+    }
+  }
+  return false;
+}
+
+
+/************************************************************
+ * Send Message to the Broker
+ * - Topic is taken from the topic table TOPICS
+ * - Payload is streamed to the broker (beginPublish), 
+ *   it is neither copied nor limited by MQTT_BUFSIZE
+ * - counts messages and bytes per topic (g_topicStats)
+ * @param[in] topic Topic ID TOPIC_xx
+ * @param[in] buf Message to be send
+ * @param[in] len Length of message
+ * @return true if published
+ ************************************************************/ 
+boolean mqttSend(byte topic, const char *buf, size_t len){  
+  MqttTopicStats &stats = g_topicStats[topic];
+  if (!mqtt.connected()) {
+    stats.failed++;
     DBG_ERROR.println("ERROR: MQTT-Connection lost");
+    return false;
+  }
+  if (!mqtt.beginPublish(TOPICS[topic].topic, len, TOPICS[topic].retain) || 
+      (mqtt.write((const uint8_t *)buf, len) != len) || 
+      !mqtt.endPublish()) {
+    stats.failed++;
+    DBG_ERROR.print("ERROR: MQTT-Publish failed: ");
+    DBG_ERROR.println(TOPIC_SUBTOPIC(topic));
+    return false;
   }
-  free(msgBuf);
-  free(topicBuf);
+  stats.published++;
+  stats.bytes += len;
+  return true;
 }
 
 
 /************************************************************
- * cronjob
- * - execute things periodicaly
+ * Publish JSON Message rendered by json
+ * - nothing is published if the JSON buffer was too small
+ * @param[in] topic Topic ID TOPIC_xx
+ * @param[in] mqttOnly if false, then also Serial Output is generated
  ************************************************************/ 
-void cronjob(void) {
-  // once on Startup
-  if (g_Firstrun) {
-      g_LastCron_1s = millis();          
-      g_LastCron_10s = g_LastCron_1s;    
-      g_LastCron_30s = g_LastCron_1s;    
-      g_LastCron_60s = g_LastCron_1s;    
-      oncePerSecond();        
-      oncePerTenSeconds();
-      oncePerThirtySeconds();
-      oncePerMinute();          
-  } else {
-    // once a second  
-    if ((millis() - g_LastCron_1s) > T_HEARTBEAT_1S) {
-      g_LastCron_1s = millis();    
-      oncePerSecond();        
-      if ((millis() - g_LastCron_10s) > T_HEARTBEAT_10S) {
-        g_LastCron_10s = g_LastCron_1s;    
-        oncePerTenSeconds();
-        if ((millis() - g_LastCron_30s) > T_HEARTBEAT_30S) {
-          g_LastCron_30s = g_LastCron_1s;    
-          oncePerThirtySeconds();
-          if ((millis() - g_LastCron_60s) > T_HEARTBEAT_60S) {
-            g_LastCron_60s = g_LastCron_1s;    
-            oncePerMinute();
-          }
-        }
-      }
+void mqttPubJson(byte topic, boolean mqttOnly){  
+  if (json.overflow()) {
+    countFailed(topic);
+    DBG_ERROR.print("ERROR: JSON-Buffer too small for Topic ");
+    DBG_ERROR.println(TOPIC_SUBTOPIC(topic));
+    return;
+  }
+  mqttPublish(topic, json.c_str(), json.length(), mqttOnly);
+}
+
+
+/************************************************************
+ * Count Message not published because it could not be 
+ * rendered (buffer too small)
+ * - g_topicStats is written by the network task only: loop()
+ *   counts in g_loopFailed, added by collectFailed()
+ * @param[in] topic Topic ID TOPIC_xx
+ ************************************************************/ 
+void countFailed(byte topic) {
+  if (!netTask || (xTaskGetCurrentTaskHandle() == netTask)) {
+    g_topicStats[topic].failed++;
+    return;
+  }
+  g_loopFailed[topic]++;
+  g_loopFailedSum++;                       // after the topic, see collectFailed()
+}
+
+
+/************************************************************
+ * Add Messages counted by countFailed() in loop() to 
+ * g_topicStats (network task)
+ ************************************************************/ 
+void collectFailed(void) {
+  uint32_t n;
+  if (g_loopFailedSum == g_loopFailedSumSeen) return;
+  g_loopFailedSumSeen = g_loopFailedSum;
+  for (byte t = 0; t < TOPIC_NUM; t++) {
+    n = g_loopFailed[t];
+    g_topicStats[t].failed += n - g_loopFailedSeen[t];
+    g_loopFailedSeen[t] = n;
+  }
+}
+
+
+/************************************************************
+ * Store Settings changed by Commands in NVS (network task)
+ * - an NVS update takes milliseconds (more when a page is 
+ *   erased), so loop() only marks the Setting and keeps 
+ *   serving the radio; it only pauses while flash is 
+ *   actually written (cache disabled on both cores)
+ ************************************************************/ 
+void saveSettings(void) {
+  if (!g_nvsRegionDirty && !g_nvsCborDirty) return;
+  prefs.begin(NVS_NAMESPACE, false);
+  if (g_nvsRegionDirty) {
+    g_nvsRegionDirty = false;                      // before the value, a newer one is stored next time
+    prefs.putUChar(NVS_KEY_REGION, g_nvsRegion);
+  }
+  if (g_nvsCborDirty) {
+    g_nvsCborDirty = false;
+    prefs.putUChar(NVS_KEY_CBOR, g_issCbor);
+  }
+  prefs.end();
+}
+
+
+/************************************************************
+ * Forward Messages queued in the outbox
+ * - while MQTT is connected, at most g_queueRate Messages per
+ *   second (token bucket), so live Messages are not delayed
+ * - Messages stay queued until they have been published
+ * - Messages queued before the clock was set get their
+ *   "Timestamp" now, if they were created in this boot
+ ************************************************************/ 
+void forwardQueued(void) {
+  static char buf[OUTBOUND_PAYLOAD_MAX + JSON_WRITER_NUM_LEN + 16];
+  static uint32_t tokens = 0;
+  static uint32_t lastRefill = 0;
+  OutboundRecord rec;
+  uint32_t now = millis();
+  size_t len;
+  int64_t epoch;
+  // Refill Tokens
+  if (now - lastRefill >= 1000) {
+    lastRefill = now;
+    tokens = g_queueRate;
+  }
+  if ((tokens == 0) || !mqtt.connected() || !outbox.size()) return;
+  if (!outbox.peek(rec, buf, OUTBOUND_PAYLOAD_MAX)) return;
+  tokens--;
+  len = rec.len;
+  // Add Timestamp, if the clock has been set after the Message was queued
+  epoch = epochMs();
+  // (not for points of ISS/sdt: their Timestamp is the time of the point)
+  if ((rec.epochMs == 0) && (rec.bootId == g_bootId) && (epoch != 0) && (len > 0) && (rec.topic != TOPIC_SDT)) {
+    epoch -= esp_timer_get_time() / 1000 - rec.uptimeMs;
+    if (buf[len - 1] == '}') {
+      // JSON Message
+      len--;
+      memcpy(buf + len, ",\"Timestamp\":", 13);
+      len += 13;
+      len += JsonWriter::formatInt64(epoch, buf + len);
+      buf[len++] = '}';
+    } else if (((uint8_t)buf[0] == (CBOR_MAP | CBOR_INDEFINITE)) && ((uint8_t)buf[len - 1] == CBOR_BREAK)) {
+      // Compact Message: key and value in front of the break
+      len--;
+      len += CborWriter::encodeHead(CBOR_UINT, ISS_KEY_TIMESTAMP, (uint8_t *)buf + len);
+      len += CborWriter::encodeInt(epoch, (uint8_t *)buf + len);
+      buf[len++] = (char)CBOR_BREAK;
     }
   }
+  if (mqttSend(rec.topic, buf, len)) {
+    outbox.pop();
+  }
+}
+
+
+/************************************************************
+ * Wall Clock
+ * - set by SNTP, see setupWIFI()
+ * @return ms since 1970-01-01 UTC, 0 if the clock is not set
+ ************************************************************/ 
+int64_t epochMs(void) {
+  struct timeval tv;
+  int64_t ms;
+  gettimeofday(&tv, NULL);
+  ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  return (ms < EPOCH_VALID_MS) ? 0 : ms;
+}
+
+
+/************************************************************
+ * Network Handler
+ * - publish Messages handed over by loop() (pubRing)
+ * - Monitor (and restore) WiFi & MQTT Connection
+ * - MQTT Messaging, OTA, Store and Forward
+ * @param[in] wait longest wait for the first Message [ticks]
+ ************************************************************/ 
+void networkLoop(TickType_t wait) {
+  PubItem *item = NULL;
+  size_t size;
+  int64_t start = esp_timer_get_time();
+  uint32_t elapsed;
+  byte state;
+  if (pubRing) {
+    item = (PubItem *)xRingbufferReceive(pubRing, &size, wait);
+    elapsed = (uint32_t)(esp_timer_get_time() - start);
+    g_netIdleUs += elapsed;
+    start += elapsed;
+  }
+  state = g_netState;
+  while (item) {
+    mqttDeliver(item->topic, (const char *)(item + 1), size - sizeof(PubItem));
+    vRingbufferReturnItem(pubRing, item);
+    item = (PubItem *)xRingbufferReceive(pubRing, &size, 0);
+  }
+  collectFailed();                 // Messages loop() could not render
+  saveSettings();                  // Settings changed by Commands
+  if (g_netStatsReset) {
+    g_netStatsReset = false;
+    memset(g_topicStats, 0, sizeof(g_topicStats));  // Publish statistics per topic
+    outbox.resetStats();                            // Store and Forward (queued messages are kept)
+    g_cmdQueueHighWater = 0;                        // Command Queue
+    g_cmdDropped = 0;
+    g_netStallMaxUs = 0;                            // longest iteration
+  }
+  monitorConnections();            // Monitor (and restore) Wifi & MQTT Connection
+  mqtt.loop();                     // handle MQTT Messaging  
+  ArduinoOTA.handle();             // handle OTA  
+  forwardQueued();                 // Store and Forward
+  outbox.poll();                   // sync flash log of the outbox, if due
+  elapsed = (uint32_t)(esp_timer_get_time() - start);
+  g_netBusyUs += elapsed;
+  if (elapsed > g_netStallMaxUs) {
+    g_netStallMaxUs = elapsed;
+    g_netStallState = state;
+  }
+}
+
+
+/************************************************************
+ * Network Task
+ * - pinned to NET_TASK_CORE, so blocking WiFi and MQTT calls 
+ *   (reconnect, TCP timeouts) never stall the radio in loop()
+ ************************************************************/ 
+void networkTask(void *param) {
+  for (;;) {
+    networkLoop(networkWait());
+  }
+}
+
+
+/************************************************************
+ * Network Task: longest wait for Messages to publish
+ * - connected or connecting: NET_TASK_WAIT_MS, MQTT, OTA and
+ *   the connection state machine need polling
+ * - waiting for the next reconnect attempt (backoff): until 
+ *   its deadline, at most NET_TASK_IDLE_MS (OTA)
+ * @return [ticks]
+ ************************************************************/ 
+TickType_t networkWait(void) {
+  uint32_t elapsed;
+  uint32_t wait;
+  if ((g_netState != NET_WIFI_BACKOFF) && (g_netState != NET_MQTT_BACKOFF)) {
+    return pdMS_TO_TICKS(NET_TASK_WAIT_MS);
+  }
+  elapsed = millis() - g_netStateSince;
+  wait = (elapsed < g_netRetryDelay) ? g_netRetryDelay - elapsed : 0;
+  if (wait > NET_TASK_IDLE_MS) wait = NET_TASK_IDLE_MS;
+  return pdMS_TO_TICKS(wait);
+}
+
+
+/************************************************************
+ * Wake loop()
+ * - after handing over work to loop() (Commands, OTA, Field
+ *   Topics after reconnect), see loop()
+ ************************************************************/ 
+void wakeRadioTask(void) {
+  if (radioTask) xTaskNotifyGive(radioTask);
+}
+
+
+/************************************************************
+ * Wake loop() from an ISR
+ * - radio ISR: PayloadReady signaled, the packet is read by 
+ *   radio.service() in loop() (see DavisRFM69::setIrqHandler)
+ ************************************************************/ 
+void IRAM_ATTR wakeRadioTaskFromISR(void) {
+  BaseType_t woken = pdFALSE;
+  if (!radioTask) return;
+  vTaskNotifyGiveFromISR(radioTask, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+
+/************************************************************
+ * Next Hop Deadline
+ * - transmitter followed: expected packet of the transmitter 
+ *   due next (see DavisHopScheduler)
+ * - acquisition: end of the acquisition step
+ * @return [us] esp_timer time, SCHED_NEVER if none
+ ************************************************************/ 
+int64_t hopDeadline(void) {
+  if (hopScheduler.locked()) {
+    return hopScheduler.deadline();
+  }
+  if (g_acqState != ACQ_OFF) {
+    return g_acqUntil;
+  }
+  return SCHED_NEVER;
+}
+
+
+/************************************************************
+ * Hop Job
+ * - hop if expected Packet is missing
+ * - acquisition step while no transmitter is followed
+ * - HOP_BY_TIMER 1: called by loop() when woken by the hop 
+ *   timer, see onHopTimer()
+ * - HOP_BY_TIMER 0: scheduled at hopDeadline() by loop()
+ * - a packet signaled meanwhile is read first, a hop would
+ *   restart the receiver and drop it from the FIFO
+ ************************************************************/ 
+void hopPoll(void) {
+  while (radio.service()) {
+  }
+  if (g_acqState != ACQ_OFF) {
+    acquire();
+  } else {
+    hopMissedPacket();
+  }
+}
+
+
+/************************************************************
+ * Init Jobs of loop()
+ * - Cronjobs: periodic, the first run of all of them is done 
+ *   by the first loop()
+ * - Batch flush and hop: deadlines set by loop()
+ ************************************************************/ 
+void setupScheduler(void) {
+  int64_t now = esp_timer_get_time();
+  DBG_SETUP.print("- Init Scheduler... ");  
+  scheduler.add(oncePerSecond,        T_HEARTBEAT_1S * 1000LL,  now);   // JOB_1S
+  scheduler.add(oncePerTenSeconds,    T_HEARTBEAT_10S * 1000LL, now);   // JOB_10S
+  scheduler.add(oncePerThirtySeconds, T_HEARTBEAT_30S * 1000LL, now);   // JOB_30S
+  scheduler.add(oncePerMinute,        T_HEARTBEAT_60S * 1000LL, now);   // JOB_60S
+  scheduler.add(batchPoll, 0);                                           // JOB_BATCH
+  scheduler.add(hopPoll, 0);                                             // JOB_HOP
+  DBG_SETUP.println("done.");
+  delay(DEBUG_SETUP_DELAY);  
 }
 
 
@@ -553,179 +1642,371 @@ void oncePerSecond(void) {
   if (g_sendIntervall > 0) {
     if ((millis() - g_lastDataSend) > g_sendIntervall * 1000) {
       g_lastDataSend = millis();
-      sendIssData(0xff);
+      for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+        if (g_station[id].active) {
+          sendIssData(id, 0xff);
+        }
+      }
     }
   }
 }
 
 
 /************************************************************
- * Once per 10 Seconds
- * - execute things once every 10 seconds
+ * Once per 10 Seconds
+ * - execute things once every 10 seconds
+ ************************************************************/ 
+void oncePerTenSeconds(void) {
+  // Insert here Actions, which should occure every 10 Seconds
+  sendCPUState(true);    
+  // DBG.print("radio._mode:   "); DBG.println(radio._mode);
+  // DBG.print("radio.CHANNEL: "); DBG.println(radio.CHANNEL);
+  // DBG.print("radio.RSSI:    "); DBG.println(radio.RSSI);
+}
+
+/************************************************************
+ * Once per 30 Seconds
+ * - execute things once every 30 seconds
+ ************************************************************/ 
+void oncePerThirtySeconds(void) {
+  // Insert here Actions, which should occure every 10 Seconds
+  sendNetworkState(true);
+  sendRfmState(true);
+}
+
+/************************************************************
+ * Once per 60 Seconds
+ * - execute things once every minute
+ ************************************************************/ 
+void oncePerMinute(void) {
+  static uint8_t fidx = 4;
+  byte t;
+  // Insert here Actions, which should occure every 10 Seconds
+  sendSketchState(true);  
+  #if DAVISRFM69_VERIFY_SHADOW
+  if (radio.verifyShadow() > 0) {
+    dbgout("RFM69 register shadow mismatch");
+  }
+  #endif
+}
+
+
+/************************************************************
+ * Arm Hop Timer
+ * - one shot alarm at the deadline of the hop scheduler
+ * - while acquiring: at the end of the acquisition step
+ * - only called by loop(), the timer ISR does not touch the 
+ *   timer (see onHopTimer)
+ ************************************************************/ 
+void armHopTimer(void) {
+#if HOP_BY_TIMER
+  int64_t deadline;
+  int32_t waitUs;
+  timerAlarmDisable(hopTimer);
+  deadline = hopDeadline();
+  if (deadline == SCHED_NEVER) {
+    return;
+  }
+  waitUs = (int32_t)(deadline - esp_timer_get_time());
+  if (waitUs < 1) waitUs = 1;
+  timerWrite(hopTimer, 0);
+  timerAlarmWrite(hopTimer, waitUs, false);
+  timerAlarmEnable(hopTimer);
+#endif
+}
+
+
+/************************************************************
+ * Hop because expected Packet is missing
+ * - called by hopPoll() in loop()
+ * - tune to the expected channel of the transmitter whose 
+ *   packet is due next, start acquisition if all have 
+ *   been lost
+ * - records lateness of the hop against its deadline
+ * - statistics and debug output are done by pollRadio()
+ * @return true if a hop was due
+ ************************************************************/ 
+boolean hopMissedPacket(void) {
+  int64_t t;
+  int32_t late;
+  boolean locked;
+  t = esp_timer_get_time();
+  if (!hopScheduler.hopDue(t)) {
+    return false;
+  }
+  late = (int32_t)(t - hopScheduler.deadline());
+  locked = hopScheduler.packetMissed(t);
+  if (locked) {
+    radio.setChannel(hopScheduler.channel());
+  } else {
+    startAcquisition();
+  }
+  g_missedHops++;
+  g_hopLateCount++;
+  g_hopLateSum += late;
+  if (late > g_hopLateMax) {
+    g_hopLateMax = late;
+  }
+  return true;
+}
+
+
+/************************************************************
+ * Start Acquisition
+ * - no transmitter is followed (boot, all lost, new region)
+ * - scan channels for a carrier, see acquire()
+ ************************************************************/ 
+void startAcquisition(void) {
+  int64_t t = esp_timer_get_time();
+  g_acqState = ACQ_SCAN;
+  g_acqStart = t;
+  g_acqUntil = t + ACQ_DWELL_US;
+  radio.hop();
+}
+
+
+/************************************************************
+ * Acquisition Step
+ * - called by hopPoll() in loop(), woken by the hop timer at
+ *   the end of each step (HOP_BY_TIMER 1)
+ * - ACQ_SCAN: dwell ACQ_DWELL_US per channel, then the 
+ *   receiver flags (RSSI, sync word) are polled by SPI from
+ *   loop(), never from the timer ISR
+ *   - sync word detected: stay ACQ_CAPTURE_US for the packet
+ *   - RSSI above threshold only: the packet has been missed,
+ *     but the transmitter sends its next packet on the next 
+ *     channel: wait there (ACQ_FOLLOW)
+ *   - nothing detected: next channel
+ * - ACQ_CAPTURE timed out: follow to next channel
+ * - ACQ_FOLLOW timed out: scan again
+ * - the first packet with correct CRC ends the acquisition, 
+ *   the hop scheduler takes the phase in the hop sequence 
+ *   from its channel and timestamp (see onRadioPacket)
+ * @return true if a step was due
+ ************************************************************/ 
+boolean acquire(void) {
+  int64_t t;
+  byte flags;
+  t = esp_timer_get_time();
+  if ((g_acqState == ACQ_OFF) || (t < g_acqUntil)) {
+    return false;
+  }
+  switch (g_acqState) {
+    case ACQ_SCAN:
+      flags = radio.rxFlags();
+      if (flags & RF69_RX_SYNC) {
+        g_acqState = ACQ_CAPTURE;
+        g_acqUntil = t + ACQ_CAPTURE_US;
+      } else if (flags & RF69_RX_RSSI) {
+        g_acqState = ACQ_FOLLOW;
+        g_acqUntil = t + ACQ_FOLLOW_US;
+        g_acqCarriers++;
+        radio.hop();
+      } else {
+        g_acqUntil = t + ACQ_DWELL_US;
+        radio.hop();
+      }
+      break;
+    case ACQ_CAPTURE:
+      g_acqState = ACQ_FOLLOW;
+      g_acqUntil = t + ACQ_FOLLOW_US;
+      g_acqCarriers++;
+      radio.hop();
+      break;
+    default:  // ACQ_FOLLOW
+      g_acqState = ACQ_SCAN;
+      g_acqUntil = t + ACQ_DWELL_US;
+      radio.hop();
+      break;
+  }
+  return true;
+}
+
+
+/************************************************************
+ * Hop Timer ISR
+ * - hop deadline reached: wake loop(), which hops (or does 
+ *   the acquisition step) and re-arms the timer
+ * - no radio or timer access here: SPI and the timer driver
+ *   are only used by loop(), so they need no lock
  ************************************************************/ 
-void oncePerTenSeconds(void) {
-  // Insert here Actions, which should occure every 10 Seconds
-  sendCPUState(true);    
-  // DBG.print("radio._mode:   "); DBG.println(radio._mode);
-  // DBG.print("radio.CHANNEL: "); DBG.println(radio.CHANNEL);
-  // DBG.print("radio.RSSI:    "); DBG.println(radio.RSSI);
+void IRAM_ATTR onHopTimer(void) {
+  g_hopTimerExpired = true;
+  wakeRadioTaskFromISR();
 }
 
+
 /************************************************************
- * Once per 30 Seconds
- * - execute things once every 30 seconds
+ * Correction Filter (called by radio.service() in loop())
+ * - a packet repaired by CRC error correction is only 
+ *   accepted if its transmitter is followed, it arrived in 
+ *   the receive window of that transmitter and on the 
+ *   channel the hop scheduler expects for it; this bounds
+ *   miscorrections of noise and multi bit errors
+ * @param[in] packet repaired packet
+ * @return    true to accept the packet
  ************************************************************/ 
-void oncePerThirtySeconds(void) {
-  // Insert here Actions, which should occure every 10 Seconds
-  sendNetworkState(true);
+bool onCorrectedPacket(const DavisPacket &packet) {
+  return hopScheduler.expected(packet.data[0] & 0x07, packet.channel, packet.timestampUs);
 }
 
+
 /************************************************************
- * Once per 60 Seconds
- * - execute things once every minute
+ * Radio Packet Handler (called by radio.service() in loop())
+ * - the packet has been stored in the ring
+ * - packet with correct CRC: update hop schedule of its 
+ *   transmitter, tune to the expected channel of the 
+ *   transmitter whose packet is due next, re-arm timer
+ *   - ends acquisition: time to lock is recorded
+ * - CRC error: radio stays on channel, while acquiring 
+ *   the transmitter is followed to the next channel
+ * @param[in] packet packet just received
+ * @return    true if the receiver has been re-armed
  ************************************************************/ 
-void oncePerMinute(void) {
-  static uint8_t fidx = 4;
-  byte t;
-  // Insert here Actions, which should occure every 10 Seconds
-  sendSketchState(true);  
+bool onRadioPacket(const DavisPacket &packet) {
+  boolean locked;
+  uint32_t ttl;
+  if (!packet.crcOk) {
+    if (g_acqState == ACQ_OFF) {
+      return false;
+    }
+    g_acqState = ACQ_FOLLOW;
+    g_acqUntil = esp_timer_get_time() + ACQ_FOLLOW_US;
+    g_acqCarriers++;
+    radio.hop();
+    armHopTimer();
+    return true;
+  }
+  locked = hopScheduler.packetReceived(packet.data[0] & 0x07, packet.channel, packet.timestampUs);
+  if (locked) {
+    radio.setChannel(hopScheduler.channel());
+    if (g_acqState != ACQ_OFF) {
+      g_acqState = ACQ_OFF;
+      ttl = (uint32_t)((esp_timer_get_time() - g_acqStart) / 1000);
+      g_acqLocks++;
+      g_timeToLockLast = ttl;
+      g_timeToLockSum += ttl;
+      if (ttl > g_timeToLockMax) {
+        g_timeToLockMax = ttl;
+      }
+    }
+  }
+  armHopTimer();
+  return locked;
 }
 
 
 /************************************************************
  * Process the received RFM Data Packet
- * - Parse Databytes and store to g_ Variables
- * - 
+ * - Decode Databytes of the last packet of a transmitter 
+ *   (DavisDecoder) and store to its measurement state
+ * @param[in] id Transmitter ID (0-7)
  ************************************************************/ 
-void parseIssData() {
-  uint16_t rawrr;
-  float cph; 
-  byte msgID;
+void parseIssData(uint8_t id) {
+  IssStation &st = g_station[id];
+  DavisMeasurement m;
+  char num[DAVIS_CENTI_STR_LEN];
   uint16_t rainDiff;
   
+  DavisDecoder::decode(st.lastPacket.data, m);
   // *********************
-  // wind speed (all packets)          
-  g_windSpeed = (float) radio.data(1) * 1.60934;  
+  // wind speed and direction (all packets)
+  st.windSpeed = m.windSpeed;
   DBG_ISS.print("WindSpeed");
-  DBG_ISS.println(g_windSpeed);  
-  // *********************
-  // wind direction (all packets)
-  // There is a dead zone on the wind vane. No values are reported between 8
-  // and 352 degrees inclusive. These values correspond to received byte
-  // values of 1 and 255 respectively
-  // See http://www.wxforum.net/index.php?topic=21967.50    
-  // 0 = South    
-  g_windDirection = (uint16_t)(radio.data(2) * 360.0f / 255.0f);
-  // convert to 180° = South
-  if (g_windDirection >= 180) {
-      g_windDirection -= 180;
-  } else {
-      g_windDirection += 180;
-  }  
+  DavisDecoder::formatCenti(st.windSpeed, num);
+  DBG_ISS.println(num);  
+  st.windDirection = m.windDirection;
   DBG_ISS.print("WindDirection: ");
-  DBG_ISS.println(g_windDirection);      
+  DBG_ISS.println(st.windDirection);      
   // *********************
   // battery status (all packets)    
-  g_transmitterBatteryStatus = (boolean)(radio.data(0) & 0x8) == 0x8;
+  // battery low bit of byte 0, published as BattWarning (the 
+  // former test "(boolean)(data[0] & 0x8) == 0x8" was never true)
+  st.transmitterBatteryStatus = m.batteryLow;
   DBG_ISS.print(F("Battery status: "));
-  if (g_transmitterBatteryStatus) {
+  if (m.batteryLow) {
       DBG_ISS.print(F("ALARM "));
   } else {
       DBG_ISS.print(F("OK    "));
   }  
-  // Now look at each individual packet. Mask off the four low order bits. 
-  // The highest order bit of these four bits is set high when the ISS battery is low. 
-  // The other three bits are the MessageID.  
-  msgID = (radio.data(0) & 0xf0) >>4 ;
-  switch (msgID) {
-    case 0x2:  // goldcap charge status (MSG-ID 2) 
-      g_goldcapChargeStatus = (float)((radio.data(3) << 2) + ((radio.data(4) & 0xC0) >> 6)) / 100;     
+  // Now look at the value selected by the Message ID
+  switch (m.field) {
+    case DAVIS_FIELD_GOLDCAP:  
+      st.goldcapChargeStatus = m.value;
       DBG_ISS.print("Goldcap Charge Status: ");
-      DBG_ISS.print(g_goldcapChargeStatus);
+      DavisDecoder::formatCenti(st.goldcapChargeStatus, num);
+      DBG_ISS.print(num);
       DBG_ISS.println(" [V]");      
       break;
-    case 0x3:  // MSG ID 3: unknown - not used
-      DBG_ISS.println("Message-ID 3: unknown");
-      break;
-    case 0x5:  // rain rate (MSG-ID 5) as number of rain clicks per hour
-               // ISS will transmit difference between last two clicks in seconds      
-      DBG_ISS.print("Rain Rate ");
-      if ( radio.data(3) == 255 ){
-          // no rain
-          g_rainRate = 0;
-          DBG_ISS.print("(NO rain): ");
-      } else {
-        rawrr = radio.data(3) + ((radio.data(4) & 0x30) * 16);
-        if ( (radio.data(4) & 0x40) == 0 ) {
-          // HiGH rain rate 
-          // Clicks per hour = 3600 / (VALUE/16)
-          cph = 57600 / (float) (rawrr);
-          DBG_ISS.print("(HIGH rain rate): ");
-        } else {
-          // LOW rain rate
-          // Clicks per hour = 3600 / VALUE
-          cph = 3600 / (float) (rawrr);
-          DBG_ISS.print("(LOW rain rate): ");
-        }
-        // Rainrate [mm/h] = [Clicks/hour] * [Cupsize]
-        g_rainRate = cph * 0.2;
-      }        
-      DBG_ISS.print(g_rainRate);              
+    case DAVIS_FIELD_RAINRATE:
+      st.rainRate = m.value;
+      DBG_ISS.print("Rain Rate: ");
+      DavisDecoder::formatCenti(st.rainRate, num);
+      DBG_ISS.print(num);              
       DBG_ISS.println(" [mm/h]");
       break;
-    case 0x7:  // solarRadiation (MSG-ID 7)
-      g_solarRadiation = (float)((radio.data(3) * 4) + ((radio.data(4) & 0xC0) >> 6));
+    case DAVIS_FIELD_SOLAR:
+      st.solarRadiation = m.value;
       DBG_ISS.print("Solar Radiation: ");
-      DBG_ISS.println(g_solarRadiation);      
+      DavisDecoder::formatCenti(st.solarRadiation, num);
+      DBG_ISS.println(num);      
       break;
-    case 0x8:  // outside temperature (MSG-ID 8)
-      g_outsideTemperature = (float) (((radio.data(3) * 256 + radio.data(4)) / 160) -32) * 5 / 9;  
+    case DAVIS_FIELD_TEMPERATURE:
+      st.outsideTemperature = m.value;
       DBG_ISS.print("Outside Temp: ");
-      DBG_ISS.print(g_outsideTemperature);
+      DavisDecoder::formatCenti(st.outsideTemperature, num);
+      DBG_ISS.print(num);
       DBG_ISS.println(" [C]");      
       break;
-    case 0x9:  // gust speed (MSG-ID 9), maximum wind speed in last 10 minutes - not used
-      g_gustSpeed = (float) radio.data(3) * 1.60934;
+    case DAVIS_FIELD_GUST:  // maximum wind speed in last 10 minutes - not used
+      st.gustSpeed = m.value;
       DBG_ISS.print("Gust Speed: ");
-      DBG_ISS.print(g_gustSpeed);
+      DavisDecoder::formatCenti(st.gustSpeed, num);
+      DBG_ISS.print(num);
       DBG_ISS.println(" [km/h]");
       break;
-    case 0xa:  // outside humidity (MSG-ID A)      
-      g_outsideHumidity = (float)(word((radio.data(4) >> 4), radio.data(3))) / 10.0;   
+    case DAVIS_FIELD_HUMIDITY:
+      st.outsideHumidity = m.value;
       DBG_ISS.print("Outside Humdity: ");
-      DBG_ISS.print(g_outsideHumidity);
+      DavisDecoder::formatCenti(st.outsideHumidity, num);
+      DBG_ISS.print(num);
       DBG_ISS.println(" [%relH]");
       break;
-    case 0xe:  // rain counter (MSG-ID E)      
-      g_rainClicks = (radio.data(3) & 0x7F);              
+    case DAVIS_FIELD_RAINCLICKS:
+      st.rainClicks = (uint16_t)m.value;
       rainDiff = 0;      
       // First run
-      if (g_rainClicksLast == 255) {
-        g_rainClicksLast = g_rainClicks;
+      if (st.rainClicksLast == 255) {
+        st.rainClicksLast = st.rainClicks;
       }      
-      if (g_rainClicks > g_rainClicksLast) {               
+      if (st.rainClicks > st.rainClicksLast) {               
         // Rainclicks higher than last time 
-        rainDiff = g_rainClicks - g_rainClicksLast;        
-      } else if (g_rainClicksLast > g_rainClicks) {        
+        rainDiff = st.rainClicks - st.rainClicksLast;        
+      } else if (st.rainClicksLast > st.rainClicks) {        
         // Rainclicks lower than last time (overflow) 
-        rainDiff = g_rainClicks + 128 - g_rainClicksLast;
+        rainDiff = st.rainClicks + 128 - st.rainClicksLast;
       } 
-      g_rainClicksLast = g_rainClicks;
-      g_rainClicksDay += rainDiff;
-      g_rainClicksSum += rainDiff;
+      st.rainClicksLast = st.rainClicks;
+      st.rainClicksDay += rainDiff;
+      st.rainClicksSum += rainDiff;
       DBG_ISS.print("Rain Counter: ");
-      DBG_ISS.print(g_rainClicks);
+      DBG_ISS.print(st.rainClicks);
       DBG_ISS.println(" [clicks]");        
       DBG_ISS.print("Rain Counter Diff: ");
       DBG_ISS.print(rainDiff);
       DBG_ISS.println(" [clicks]");        
       DBG_ISS.print("Dayly Rain Clicks: ");
-      DBG_ISS.print(g_rainClicksDay);
+      DBG_ISS.print(st.rainClicksDay);
       DBG_ISS.println(" [clicks]");        
       DBG_ISS.print("Overall Rain Clicks: ");
-      DBG_ISS.print(g_rainClicksSum);
+      DBG_ISS.print(st.rainClicksSum);
       DBG_ISS.println(" [clicks]");              
       break;      
+    default:  // e.g. MSG ID 3: unknown - not used
+      DBG_ISS.print("Message-ID ");
+      DBG_ISS.print(m.msgId);
+      DBG_ISS.println(": unknown");
+      break;
   }  
   DBG_ISS.println("*** Finished Parsing ISS Data *** ");
 }
@@ -733,138 +2014,450 @@ void parseIssData() {
 
 /************************************************************
  * Poll Radio
- * - Check for received Packet
+ * - Process all Packets waiting in the radio ring
+ *   - Transmitter ID (0-7) from low three bits of byte 0, 
+ *     each transmitter has its own statistics and measurements
  * - Hop
- *   - After correct Packet has been received
- *   - every 2.5s for 25 times after last correct Packet
- *   - every 20s if no correct Packet has been received for a long time 
+ *   - After correct Packet has been received (done by 
+ *     radio.service())
+ *     to the expected channel of the transmitter whose 
+ *     packet is due next (see DavisHopScheduler)
+ *   - when the expected Packet did not arrive, for 25 times 
+ *     after last correct Packet of a transmitter
+ *     - hop timing: expected interval (41 + ID) / 16 s, 
+ *       interval and phase learned from received packets
+ *     - done by hopPoll()
+ *   - no transmitter followed: acquisition (see acquire()), 
+ *     done by hopPoll()
  ************************************************************/ 
 void pollRadio(void) {
-  String msgStr;
-  uint32_t now;
+  DavisPacket packet;
   uint8_t msgID;
   uint16_t crc; 
   boolean success; 
+  uint32_t missedHops;
+  uint32_t missed;
+  uint8_t id;
+  // *************************
+  // * Hops because of missing Packets 
+  // * - done by hopPoll(), loop() is woken at the deadline by the hop timer (HOP_BY_TIMER 1, see onHopTimer)
+  // *   or by the scheduler (HOP_BY_TIMER 0, ms resolution)
+  // * - update statistics for all hops done since last poll
+  missedHops = g_missedHops;
+  if (missedHops != g_missedHopsSeen) {
+    DBG_RFM.print("HOP: ");
+    DBG_RFM.print(missedHops - g_missedHopsSeen);
+    DBG_RFM.println(" PACKET(S) MISSED");    
+    g_missedHopsSeen = missedHops;
+  }
+  // * - a packet missed (listened for or not) breaks the receive streak
+  for (id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    missed = hopScheduler.tx(id).missed + hopScheduler.tx(id).skipped;
+    if (missed != g_station[id].missedSeen) {
+      g_station[id].missedSeen = missed;
+      g_station[id].receivedStreak = 0;
+    }
+  }
   // *************************
-  // * RF-Packet received
+  // * RF-Packets received (drain ring filled by radio.service())
   // * - check CRC
   // * - process values if CRC OK  
-  success = false;
-  if (radio.receiveDone() && !radio.getCrcError()) {         
-    now = millis();
+  // * - radio has already been re-armed by radio.service()
+  while (radio.receivePacket(packet)) {
+    success = false;
     DBG_RFM.println("Packet received: ");    
-    msgStr = "Packet received:";    
     // Channel
     DBG_RFM.print("Channel: ");
-    DBG_RFM.println(radio.channel());
-    msgStr.concat("Ch:"+ String(radio.channel()));
+    DBG_RFM.println(packet.channel);
     // 8 Data-Byte
-    msgStr.concat(" Data:");
     DBG_RFM.print("Data: ");
     for (byte i = 0; i < DAVIS_PACKET_LEN; i++) {          
-      if (radio.data(i) < 10) {
-        msgStr.concat("0");
+      if (packet.data[i] < 10) {
         DBG_RFM.print("0");
       }
-      msgStr.concat(String(radio.data(i), 16));    
-      DBG_RFM.print(radio.data(i), HEX);          
+      DBG_RFM.print(packet.data[i], HEX);          
       if (i < DAVIS_PACKET_LEN-1) {
-        msgStr.concat(":");
         DBG_RFM.print(":");
       }          
     }    
     DBG_RFM.println(" ");
     // RSSI
     DBG_RFM.print("RSSI: ");
-    DBG_RFM.println((radio.rssi()));
-    msgStr.concat(" RSSI:" + String(radio.rssi()));
-    // Compute CRC
-    crc =  radio.crc16(); 
+    DBG_RFM.println(packet.rssi);
+    // Timestamp taken by ISR
+    DBG_RFM.print("Time [us]: ");
+    DBG_RFM.println(packet.timestampUs);
+    // Frequency error measured by AFC
+    DBG_RFM.print("AFC [Hz]: ");
+    DBG_RFM.println(RF69_FSTEP_HZ(packet.afc));
+    // CRC (verified by radio.service())
+    crc = radio.crc16(packet); 
     DBG_RFM.print("CRC: ");
     DBG_RFM.println(crc, HEX);                
-    msgStr.concat(" CRC:");
-    msgStr.concat(String(crc, 16));    
-    // verify CRC    
-    if ((crc == (word(radio.data(6), radio.data(7)))) && (crc != 0)) {
-      if ((now - g_lastRxTime) > g_longestBlackout) {
-        g_longestBlackout = now - g_lastRxTime;
+    if (packet.crcOk) {
+      id = packet.data[0] & 0x07;
+      IssStation &st = g_station[id];
+      st.sinceLastRx = (uint32_t)((packet.timestampUs - st.lastRxUs) / 1000);
+      if (st.active && (st.sinceLastRx > st.longestBlackout)) {
+        st.longestBlackout = st.sinceLastRx;
       }
-      g_sinceLastRx = now - g_lastRxTime;
-      g_lastRxTime = now;
-      g_packetsReceived++;
-      // Hop to next Channel if CRC was correct
-      DBG_RFM.println("CRC OK");
+      st.lastRxUs = packet.timestampUs;
+      st.packetsReceived++;
+      st.active = true;
+      // radio.service() did hop to next Channel, because CRC was correct
+      DBG_RFM.print("CRC OK - Transmitter: ");
+      DBG_RFM.println(id + 1);
       DBG_RFM.print("Hop! - New Channel: ");
-      msgStr.concat(" - OK");
-      radio.hop();    
+      if (packet.corrected) {
+        g_crcCorrected++;
+        DBG_RFM.print("CRC corrected bits: ");
+        DBG_RFM.println(packet.corrected);
+      }
       DBG_RFM.println(radio.channel());
-      g_hopCount = 1;
-      g_receivedStreak++;
-      if (g_receivedStreak > g_receivedStreakMax) {
-        g_receivedStreakMax = g_receivedStreak;
+      st.receivedStreak++;
+      if (st.receivedStreak > st.receivedStreakMax) {
+        st.receivedStreakMax = st.receivedStreak;
       }
       // Parse the RFM Data
-      parseIssData();
+      st.lastPacket = packet;
+      parseIssData(id);
+      msgID = (st.lastPacket.data[0] & 0xf0) >> 4;
       success = true;      
     } else {            
-      // don`t try  again on same channel      
-      radio.markCrcError();
       DBG_RFM.println("Wrong CRC");        
-      msgStr.concat(" - ERROR");    
       g_crcErrors++;
-      g_receivedStreak = 0;
     }        
+    // Send Data for current Message ID (Batch Mode: add record to batch)
+    if (success && g_sendReceivedPackets) {
+      if (g_batchCount || g_batchPeriod) {
+        batchAdd(id);
+      } else {
+        sendIssData(id, msgID); 
+      }
+    }      
+    // Field Topics: changed values of the packet
+    if (success && g_sendFields) {
+      publishFields(id);
+    }
+    // Swinging Door: points needed to reconstruct the series
+    if (success && g_sdtSpan) {
+      sdtAdd(id);
+    }
   }
-  // *************************
-  // Hop if packet was not received in expected time.
-  // Auto-Hopping machanism:
-  // - If a packet as been correctly received (g_hopCount == 1)
-  //   - hop every 2,5s 
-  //   - for maximum of 25 packets missing
-  // Timing:
-  // - Hop after (N * PACKET_INTERVAL) + PACKET_OFFSET  [N = number off Packets missed so far]
-  //   - 1st Hop after 3,0 s
-  //   - 2nd Hop after 5,5 s
-  //   - 3rd Hop after 8,0 s  
-  if ((g_hopCount > 0) && ((millis() - g_lastRxTime) > (unsigned long)(g_hopCount * PACKET_INTERVAL + PACKET_OFFSET))) {    
-    g_receivedStreak = 0;
-    g_BlackoutTag = true;
-    // after 25 missed Packets, no automatic HOP every 2,5s
-    if (++g_hopCount > 25) {
-      g_hopCount = 0;
+}
+
+
+/************************************************************
+ * Batch Mode: add record of the last packet of a transmitter
+ * - the batch is flushed
+ *   - before the record, if it might not fit (BATCH_RECORD_MAX)
+ *   - after the record, if it holds g_batchCount records
+ *   - by batchPoll(): period, latency cap
+ * - Format of a batch (ISS/batch):
+ *   {"Records":[
+ *     {"ID":1,"RxTime":5220121345,"Timestamp":1760000000123,"msgID":8,
+ *      "RSSI":-74,"WindSpeed":3.22,"WindDirection":257,"OutsideTemperature":6.67},
+ *     {"ID":1,"RxTime":5222683845,...,"Rainrate":null}],
+ *    "Count":2,"Flush":"count"}
+ *   - RxTime: reception [us since boot], Timestamp: reception 
+ *     [ms since 1970] (only if the clock is set)
+ *   - field of the packet as in ISS/[ID], RainClicks with 
+ *     RainClicksDay and RainClicksSum
+ * @param[in] id Transmitter ID (0-7)
+ ************************************************************/ 
+void batchAdd(uint8_t id) {
+  IssStation &st = g_station[id];
+  const DavisPacket &p = st.lastPacket;
+  DavisMeasurement m;
+  int64_t now = esp_timer_get_time();
+  int64_t epoch = epochMs();
+  if (g_batchRecords && (batch.length() + BATCH_RECORD_MAX > BATCH_BUFSIZE)) {
+    batchFlush(BATCH_FLUSH_SIZE);
+  }
+  if (!g_batchRecords) {
+    batch.reset();
+    batch.beginObject();
+    batch.beginArray("Records");
+    g_batchFirstUs = p.timestampUs;
+    g_batchWindow = g_batchPeriod ? (now / (g_batchPeriod * 1000000LL)) : 0;
+  }
+  DavisDecoder::decode(p.data, m);
+  batch.beginObject();
+  batch.addUInt("ID", id + 1);
+  batch.addInt64("RxTime", p.timestampUs);
+  if (epoch) {
+    batch.addInt64("Timestamp", epoch - (now - p.timestampUs) / 1000);
+  }
+  batch.addUInt("msgID", m.msgId);
+  batch.addInt("RSSI", p.rssi);
+  batch.addFixed("WindSpeed", m.windSpeed, 2);
+  batch.addUInt("WindDirection", m.windDirection);
+  switch (m.field) {
+    case DAVIS_FIELD_NONE:
+      break;
+    case DAVIS_FIELD_RAINRATE:
+      if (m.value == DAVIS_RAINRATE_INF) {
+        batch.addNull("Rainrate");
+      } else {
+        batch.addFixed("Rainrate", m.value, 2);
+      }
+      break;
+    case DAVIS_FIELD_RAINCLICKS:
+      batch.addUInt("RainClicks", st.rainClicks);
+      batch.addUInt("RainClicksDay", st.rainClicksDay);
+      batch.addUInt("RainClicksSum", st.rainClicksSum);
+      break;
+    default:
+      batch.addFixed(DavisDecoder::fieldName(m.field), m.value, 2);
+      break;
+  }
+  batch.endObject();
+  g_batchRecords++;
+  if (g_batchCount && (g_batchRecords >= g_batchCount)) {
+    batchFlush(BATCH_FLUSH_COUNT);
+  }
+}
+
+
+/************************************************************
+ * Batch Mode: flush by time
+ * - period: at the end of every g_batchPeriod seconds
+ * - latency cap: g_batchLatency seconds after reception of 
+ *   the oldest record
+ * - scheduled at batchDeadline() by loop()
+ ************************************************************/ 
+void batchPoll(void) {
+  int64_t now;
+  if (!g_batchRecords) return;
+  now = esp_timer_get_time();
+  if (g_batchPeriod && (now / (g_batchPeriod * 1000000LL) != g_batchWindow)) {
+    batchFlush(BATCH_FLUSH_PERIOD);
+  } else if (now - g_batchFirstUs >= g_batchLatency * 1000000LL) {
+    batchFlush(BATCH_FLUSH_LATENCY);
+  }
+}
+
+
+/************************************************************
+ * Batch Mode: deadline of the pending batch, see batchPoll()
+ * @return [us] esp_timer time, SCHED_NEVER if none pending
+ ************************************************************/ 
+int64_t batchDeadline(void) {
+  int64_t deadline;
+  if (!g_batchRecords) return SCHED_NEVER;
+  deadline = g_batchFirstUs + g_batchLatency * 1000000LL;
+  if (g_batchPeriod && ((g_batchWindow + 1) * g_batchPeriod * 1000000LL < deadline)) {
+    deadline = (g_batchWindow + 1) * g_batchPeriod * 1000000LL;
+  }
+  return deadline;
+}
+
+
+/************************************************************
+ * Batch Mode: publish pending batch to ISS/batch
+ * @param[in] reason BATCH_FLUSH_xx
+ ************************************************************/ 
+void batchFlush(byte reason) {
+  if (!g_batchRecords) return;
+  batch.endArray();
+  batch.addUInt("Count", g_batchRecords);
+  batch.addString("Flush", BATCH_FLUSH_NAMES[reason]);
+  batch.endObject();
+  if (batch.overflow()) {
+    countFailed(TOPIC_BATCH);
+    DBG_ERROR.println("ERROR: Batch-Buffer too small");
+  } else {
+    mqttPublish(TOPIC_BATCH, batch.c_str(), batch.length(), true);
+    g_batchesSent++;
+    g_batchRecordsSent += g_batchRecords;
+    g_batchFlushes[reason]++;
+  }
+  g_batchRecords = 0;
+}
+
+
+/************************************************************
+ * Field Topics: publish changed values of the last packet
+ * - each measurement on its own retained subtopic 
+ *   ISS/[ID]/[field] (see FIELDS), so new subscribers get
+ *   the current state at once
+ * - only the fields carried by the packet: wind (every 
+ *   packet) and the field selected by its message ID
+ * - published if changed by more than the deadband 
+ *   (g_fieldDeadband), see publishField()
+ * @param[in] id Transmitter ID (0-7)
+ ************************************************************/ 
+void publishFields(uint8_t id) {
+  DavisMeasurement m;
+  DavisDecoder::decode(g_station[id].lastPacket.data, m);
+  for (byte f = 0; f < FIELD_NUM; f++) {
+    if ((FIELDS[f].packetField == DAVIS_FIELD_NONE) || (FIELDS[f].packetField == m.field)) {
+      g_fieldSeen[id] |= (1 << f);
+      publishField(id, f, false);
     }
-    g_autoHops++;
-    radio.hop();
-    DBG_RFM.print("HOP: ");
-    DBG_RFM.print(g_hopCount - 1);
-    DBG_RFM.println(" PACKET(S) MISSED");    
-    // MQTT Message
-    msgStr = "HOP: ";
-    msgStr.concat(String(g_hopCount - 1));
-    msgStr.concat(" Packets(s) missed, hopping anyway to Channel:");
-    msgStr.concat(String(radio.channel()));    
   }
-  // *************************
-  // Hop if NO packet was not received for a LONG time.
-  // Auto-Hopping machanism:
-  // Hop every PACKET_LONGINTERVAL 
-  // - if no Packet was received at all
-  // - OR if more than 25 Packets were missing
-  if ( (g_hopCount == 0) && ( (millis() - g_lastTimeout) > PACKET_LONGHOP) ) {
-    // 1st Hop
-    if (g_BlackoutTag) {
-      g_numBlackouts++;      
+}
+
+
+/************************************************************
+ * Field Topics: publish all fields received so far
+ * - after MQTT reconnect (changes may have been lost) and 
+ *   when switched on by command "fields"
+ ************************************************************/ 
+void fieldsPoll(void) {
+  if (!g_fieldResync) return;
+  g_fieldResync = false;
+  if (!g_sendFields) return;
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    for (byte f = 0; f < FIELD_NUM; f++) {
+      if (g_fieldSeen[id] & (1 << f)) publishField(id, f, true);
+    }
+  }
+}
+
+
+/************************************************************
+ * Field Topics: publish one field
+ * - payload: value as JSON number, e.g. "21.50" (Rainrate 
+ *   of a zero click interval: "null")
+ * - the value is kept as published only if it has been 
+ *   handed over, else it is tried again with the next packet
+ * @param[in] id    Transmitter ID (0-7)
+ * @param[in] f     FIELD_xx
+ * @param[in] force publish even if not changed
+ ************************************************************/ 
+void publishField(uint8_t id, byte f, boolean force) {
+  char num[JSON_WRITER_NUM_LEN];
+  size_t len;
+  int32_t value = fieldValue(id, f);
+  int32_t last = g_fieldLast[id][f];
+  int64_t diff;
+  if (!force && (g_fieldPublished[id] & (1 << f))) {
+    if (value == last) return;
+    if ((value != DAVIS_RAINRATE_INF) && (last != DAVIS_RAINRATE_INF)) {
+      diff = llabs((int64_t)value - last);
+      if (FIELDS[f].wrap && (diff > FIELDS[f].wrap / 2)) diff = FIELDS[f].wrap - diff;
+      if (diff <= g_fieldDeadband[f]) return;
+    }
+  }
+  if ((f == FIELD_RAINRATE) && (value == DAVIS_RAINRATE_INF)) {
+    len = 4;
+    memcpy(num, "null", 5);
+  } else {
+    len = JsonWriter::formatFixed(value, FIELDS[f].decimals, num);
+  }
+  if (mqttPublish(TOPIC_FIELD + id * FIELD_NUM + f, num, len, true)) {
+    g_fieldLast[id][f] = value;
+    g_fieldPublished[id] |= (1 << f);
+  }
+}
+
+
+/************************************************************
+ * Field Topics: actual value of a field
+ * @param[in] id Transmitter ID (0-7)
+ * @param[in] f  FIELD_xx
+ * @return    value [10^-decimals]
+ ************************************************************/ 
+int32_t fieldValue(uint8_t id, byte f) {
+  const IssStation &st = g_station[id];
+  switch (f) {
+    case FIELD_WINDSPEED:   return st.windSpeed;
+    case FIELD_WINDDIR:     return st.windDirection;
+    case FIELD_GUST:        return st.gustSpeed;
+    case FIELD_TEMPERATURE: return st.outsideTemperature;
+    case FIELD_HUMIDITY:    return st.outsideHumidity;
+    case FIELD_RAINRATE:    return st.rainRate;
+    case FIELD_SOLAR:       return st.solarRadiation;
+    case FIELD_GOLDCAP:     return st.goldcapChargeStatus;
+    case FIELD_RAINDAY:     return st.rainClicksDay;
+    case FIELD_RAINSUM:     return (int32_t)st.rainClicksSum;
+    default:                return 0;
+  }
+}
+
+
+/************************************************************
+ * Swinging Door: add values of the last packet
+ * - only the fields carried by the packet (see publishFields)
+ * - time of a value: reception of the packet (RxTime)
+ * - a Rainrate of a zero click interval can not be 
+ *   interpolated, it interrupts the series
+ * @param[in] id Transmitter ID (0-7)
+ ************************************************************/ 
+void sdtAdd(uint8_t id) {
+  DavisMeasurement m;
+  SdtPoint out[SDT_OUT_MAX];
+  int32_t value;
+  uint8_t n;
+  DavisDecoder::decode(g_station[id].lastPacket.data, m);
+  for (byte f = 0; f < FIELD_NUM; f++) {
+    if ((FIELDS[f].packetField == DAVIS_FIELD_NONE) || (FIELDS[f].packetField == m.field)) {
+      value = fieldValue(id, f);
+      n = sdt[id][f].add(g_station[id].lastPacket.timestampUs, value, out, 
+                         (f == FIELD_RAINRATE) && (value == DAVIS_RAINRATE_INF));
+      for (uint8_t i = 0; i < n; i++) sdtPublish(id, f, out[i].t, out[i].v);
     }
-    g_lastTimeout = millis();    
-    radio.hop();    
-    DBG_RFM.println(F("HOP: RESYNC (20s)"));
-    msgStr = "HOP: RESYNC, new Channel:";
-    msgStr.concat(String(radio.channel()));
   }
-  // Send Data for current Message ID      
-  if (success && g_sendReceivedPackets) {
-    sendIssData(msgID); 
-  }      
+}
+
+
+/************************************************************
+ * Swinging Door: publish points held back (switched off)
+ ************************************************************/ 
+void sdtFlush(void) {
+  SdtPoint p;
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    for (byte f = 0; f < FIELD_NUM; f++) {
+      if (sdt[id][f].flush(p)) sdtPublish(id, f, p.t, p.v);
+    }
+  }
+}
+
+
+/************************************************************
+ * Swinging Door: apply error bounds and span
+ ************************************************************/ 
+void sdtConfigure(void) {
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    for (byte f = 0; f < FIELD_NUM; f++) {
+      sdt[id][f].configure(g_sdtDeviation[f], g_sdtSpan * 1000000LL);
+    }
+  }
+}
+
+
+/************************************************************
+ * Swinging Door: publish a point to ISS/sdt
+ * - Format: {"ID":1,"Field":"temperature","RxTime":675048123,
+ *            "Timestamp":1760000000123,"Value":21.5}
+ *   - RxTime: reception [us since boot], Timestamp: reception 
+ *     [ms since 1970] (only if the clock is set)
+ *   - Value: Rainrate of a zero click interval: null
+ * - the series is reconstructed by linear interpolation 
+ *   between the points of a transmitter and field
+ * @param[in] id Transmitter ID (0-7)
+ * @param[in] f  FIELD_xx
+ * @param[in] t  time of the point: reception [us since boot]
+ * @param[in] v  value [10^-decimals]
+ ************************************************************/ 
+void sdtPublish(uint8_t id, byte f, int64_t t, int32_t v) {
+  int64_t epoch = epochMs();
+  json.reset();
+  json.beginObject();
+  json.addUInt("ID", id + 1);
+  json.addString("Field", FIELDS[f].name);
+  json.addInt64("RxTime", t);
+  if (epoch) {
+    json.addInt64("Timestamp", epoch - (esp_timer_get_time() - t) / 1000);
+  }
+  if ((f == FIELD_RAINRATE) && (v == DAVIS_RAINRATE_INF)) {
+    json.addNull("Value");
+  } else {
+    json.addFixed("Value", v, FIELDS[f].decimals);
+  }
+  json.endObject();
+  mqttPubJson(TOPIC_SDT, true);
 }
 
 
@@ -891,24 +2484,84 @@ void resetHandler() {
  ************************************************************
  * {"Heap Size":349264,"FreeHeap":260632,"Minimum Free Heap":253140,
  *  "Max Free Heap":113792,"Chip Model":"ESP32-D0WDQ5",
- *  "Chip Revision":1,"Millis":5220121,"Cycle Count":3019255534
+ *  "Chip Revision":1,"Millis":5220121,"Cycle Count":3019255534,
+ *  "Tasks":[{"Task":"radio","Core":1,"Load [%]":2.4,"Idle [%]":97.5,"Wakeups [1/s]":1.9,
+ *            "Stack Free":5312,"Max Stall [us]":1830},
+ *           {"Task":"network","Core":0,"Load [%]":0.8,"Idle [%]":99.1,"Stack Free":4620,
+ *            "Max Stall [us]":2410,"Max Stall State":"MQTT connect"}],
+ *  "Publish Queue":{"Size":16384,"High Water":2816,"Dropped":0},
+ *  "Command Queue":{"Size":4,"High Water":1,"Dropped":0}
  * }
  ************************************************************
  * @param[in] mqttOnly if false, then also Serial Output is generated
  ************************************************************/ 
 void sendCPUState(boolean mqttOnly) {    
-  String msgStr;
-  msgStr = "{";    
-  msgStr.concat("\"Heap Size\":" + String(ESP.getHeapSize()) + ",");
-  msgStr.concat("\"FreeHeap\":" + String(ESP.getFreeHeap()) + ",");
-  msgStr.concat("\"Minimum Free Heap\":" + String(ESP.getMinFreeHeap()) + ",");
-  msgStr.concat("\"Max Free Heap\":" + String(ESP.getMaxAllocHeap()) + ",");
-  msgStr.concat("\"Chip Model\":\"" + String(ESP.getChipModel()) + "\",");
-  msgStr.concat("\"Chip Revision\":" + String(ESP.getChipRevision()) + ",");
-  msgStr.concat("\"Millis\":" + String(millis()) + ",");
-  msgStr.concat("\"Cycle Count\":" + String(ESP.getCycleCount()) + "");
-  msgStr.concat("}");
-  mqttPub(T_CPU, msgStr, mqttOnly);  
+  static int64_t  lastUs = 0;
+  static uint32_t lastRadioBusyUs = 0;
+  static uint32_t lastNetBusyUs = 0;
+  static uint32_t lastRadioIdleUs = 0;
+  static uint32_t lastNetIdleUs = 0;
+  static uint32_t lastRadioWakeups = 0;
+  int64_t  now = esp_timer_get_time();
+  uint32_t radioBusyUs = g_radioBusyUs;
+  uint32_t netBusyUs = g_netBusyUs;
+  uint32_t radioIdleUs = g_radioIdleUs;
+  uint32_t netIdleUs = g_netIdleUs;
+  uint32_t radioWakeups = g_radioWakeups;
+  uint32_t period = (uint32_t)((now - lastUs) / 1000);    // [ms]
+  if (period == 0) period = 1;
+  json.reset();
+  json.beginObject();
+  json.addUInt("Heap Size", ESP.getHeapSize());
+  json.addUInt("FreeHeap", ESP.getFreeHeap());
+  json.addUInt("Minimum Free Heap", ESP.getMinFreeHeap());
+  json.addUInt("Max Free Heap", ESP.getMaxAllocHeap());
+  json.addString("Chip Model", ESP.getChipModel());
+  json.addUInt("Chip Revision", ESP.getChipRevision());
+  json.addUInt("Millis", millis());
+  json.addUInt("Cycle Count", ESP.getCycleCount());
+  // Tasks: CPU load and time sleeping [0.1 %] since last State, unused stack [bytes]
+  json.beginArray("Tasks");
+  json.beginObject();
+  json.addString("Task", "radio");
+  json.addInt("Core", xPortGetCoreID());
+  json.addFixed("Load [%]", (radioBusyUs - lastRadioBusyUs) / period, 1);
+  json.addFixed("Idle [%]", (radioIdleUs - lastRadioIdleUs) / period, 1);
+  json.addFixed("Wakeups [1/s]", (uint32_t)((uint64_t)(radioWakeups - lastRadioWakeups) * 10000 / period), 1);
+  json.addUInt("Stack Free", uxTaskGetStackHighWaterMark(NULL));
+  json.addUInt("Max Stall [us]", g_radioStallMaxUs);
+  json.endObject();
+  if (netTask) {
+    json.beginObject();
+    json.addString("Task", "network");
+    json.addInt("Core", NET_TASK_CORE);
+    json.addFixed("Load [%]", (netBusyUs - lastNetBusyUs) / period, 1);
+    json.addFixed("Idle [%]", (netIdleUs - lastNetIdleUs) / period, 1);
+    json.addUInt("Stack Free", uxTaskGetStackHighWaterMark(netTask));
+    json.addUInt("Max Stall [us]", g_netStallMaxUs);
+    json.addString("Max Stall State", NET_STATE_NAMES[g_netStallState]);
+    json.endObject();
+  }
+  json.endArray();
+  lastUs = now;
+  lastRadioBusyUs = radioBusyUs;
+  lastNetBusyUs = netBusyUs;
+  lastRadioIdleUs = radioIdleUs;
+  lastNetIdleUs = netIdleUs;
+  lastRadioWakeups = radioWakeups;
+  // Queues between the tasks
+  json.beginObject("Publish Queue");
+  json.addUInt("Size", PUB_RING_SIZE);
+  json.addUInt("High Water", g_pubRingHighWater);
+  json.addUInt("Dropped", g_pubDropped);
+  json.endObject();
+  json.beginObject("Command Queue");
+  json.addUInt("Size", CMD_QUEUE_LEN);
+  json.addUInt("High Water", g_cmdQueueHighWater);
+  json.addUInt("Dropped", g_cmdDropped);
+  json.endObject();
+  json.endObject();
+  mqttPubJson(TOPIC_CPU, mqttOnly);  
 }
 
 
@@ -916,24 +2569,37 @@ void sendCPUState(boolean mqttOnly) {
  * Send Help for Available Commands 
  ************************************************************/ 
 void sendHelp(void) {
-  String msgStr;  
-  msgStr = "Commands\r\n";  
-  msgStr.concat("allrx  [0|1]  - Switch on/Off Message for each Packed received 0:off, 1_on\r\n");
-  msgStr.concat("hello         - Ping\r\n");
-  msgStr.concat("help          - Send Help\r\n");
-  msgStr.concat("newday        - Reset Daily Raincounter\r\n");
-  msgStr.concat("period [S]    - Set Message Period to S seconds\r\n");
-  msgStr.concat("reboot        - Reboot\r\n");
-  msgStr.concat("reset         - Reset Statistics\r\n");
-  msgStr.concat("setrc [N]     - Set Raincounter to N");
-  mqttPub(T_HELP, msgStr, true);
+  static const char HELP[] =
+    "Commands\r\n"
+    "allrx  [0|1]  - Switch on/Off Message for each Packed received 0:off, 1_on\r\n"
+    "batch [N] [T] - Batch Mode for allrx: flush after N Records and/or every T seconds, 0 0: off\r\n"
+    "batchcap [S]  - Batch Mode: publish each Record at the latest S seconds after reception\r\n"
+    "deadband [F] [D] - Publish Field F if changed by more than D: " F_WINDSPEED ", " F_WINDDIR ", " F_GUST ", "
+    F_TEMPERATURE ", " F_HUMIDITY ", " F_RAINRATE ", " F_SOLAR ", " F_GOLDCAP ", " F_RAINDAY ", " F_RAINSUM "\r\n"
+    "drain [N]     - Forward N queued Messages per second after reconnect, 0: hold\r\n"
+    "fields [0|1]  - Switch on/off Field Topics ISS/[ID]/[F], retained, published on change\r\n"
+    "format [I] [F] - Publish ISS/I (0: all) as F: json, cbor\r\n"
+    "hello         - Ping\r\n"
+    "help          - Send Help\r\n"
+    "newday        - Reset Daily Raincounter\r\n"
+    "period [S]    - Set Message Period to S seconds\r\n"
+    "reboot        - Reboot\r\n"
+    "region [R]    - Select Frequency Region R: US, EU\r\n"
+    "reset         - Reset Statistics\r\n"
+    "sdt [S]       - Swinging Door Compression to ISS/sdt, a point at least every S seconds, 0: off\r\n"
+    "sdtdev [F] [E] - Swinging Door: reconstruct Field F within +/- E\r\n"
+    "setrc [N]     - Set Raincounter to N";
+  mqttPublish(TOPIC_HELP, HELP, sizeof(HELP) - 1, true);
 }
 
  
 /*********************************************************
  * Send Received Packet to MQTT over Software Serial
  *********************************************************
- * - sends Data to ESP via Softwareserial
+ * - sends Data of one transmitter to topic ISS/[ID 1-8]
+ * - rendered by json into a static buffer (no heap)
+ * - compact Message instead, if selected for the transmitter
+ *   by command "format", see sendIssCbor()
  * - Format Template:
  *   {"WindSpeed": 31.415,                   // Windspeed [km/h]
  *    "WindDirection" : 314,                 // Directon of Wind [0-350°]
@@ -941,8 +2607,11 @@ void sendHelp(void) {
  *    "Payload" : 80:00:B2:30:A9:00:A0:DA    // Raw Payload of received Packet
  *    "Channel": 4,                          // Channel during last packet
  *    "RSSI" : -58,                          // RSSI during last packet
+ *    "RxTime" : 675048123,                  // [us] since boot, PayloadReady of last packet
+ *    "SyncTime" : 675044790,                // [us] since boot, Sync Word of last packet (estimated)
+ *    "Corrected" : 0,                       // bits repaired by CRC error correction in last packet
  *    "GoldcapVoltage" : 3.1415,             // when msgID = 0x2
- *    "Rainrate" : 31.415,                   // when msgID = 0x5
+ *    "Rainrate" : 31.415,                   // when msgID = 0x5 (null: zero click interval)
  *    "SolarRadiation" : 3141,               // when msgID = 0x7
  *    "OutsideTemperature":31.4,             // when msgID = 0x8
  *    "GustSpeed" : 314.15,                  // when msgID = 0x9
@@ -952,132 +2621,190 @@ void sendHelp(void) {
  *    "lastpacketreceived": 675048,          // [ms] since last packet was received from ISS     
  *    "packetsReceived":169,                 // Number of packets received (correct CRC)
  *    "autoHops":152",                       // Number of Autohops, because of single missing Packets
- *    "numResyncs":42",                      // Number of Resyncs (at least one Packet missed) 
+ *    "numResyncs":42",                      // Number of Resyncs (more than 25 Packets missed) 
  *    "receivedStreak":23,                   // Number of Packets received without Error in current streak
  *    "receivedStreakMax":2423,              // Maximum Number of Packets received without Error
- *    "crcerrors":12"}                       // Number of CRC-Errors during receptions
+ *    "crcerrors":12",                       // Number of CRC-Errors during receptions
+ *    "crccorrected":3"}                     // Number of packets repaired by CRC error correction
  *************************************************************************
+ * @param[in] id:    Transmitter ID (0-7)
  * @param[in] msgID: - 255: Send all Data, other send only Data belonging to msgID
  **************************************************************************/
-void sendIssData(uint8_t msgID) {    
-    String msgStr;   
-    uint32_t t;
+void sendIssData(uint8_t id, uint8_t msgID) {    
+    IssStation &st = g_station[id];
+    int64_t epoch;
+    // Compact Message selected by command "format"
+    if (g_issCbor & (1 << id)) {
+      sendIssCbor(id, msgID);
+      return;
+    }
+    json.reset();
+    json.beginObject();
     // WindSpeed
-    msgStr = "{\"WindSpeed\": ";
-    msgStr.concat(g_windSpeed);
+    json.addFixed("WindSpeed", st.windSpeed, 2);
     // Wind Direction
-    msgStr.concat(", \"WindDirection\": ");
-    msgStr.concat(g_windDirection);
+    json.addUInt("WindDirection", st.windDirection);
     // Battery Warning
-    msgStr.concat(", \"BattWarning\": ");
-    if (g_transmitterBatteryStatus){
-      msgStr.concat("1");
-    } else {
-      msgStr.concat("0");  
-    }    
-    // Payload: 80:00:B2:30:A9:00:AA:DA
-    msgStr.concat(", \"Payload\": \"");
-    for (byte i = 0; i < DAVIS_PACKET_LEN; i++) {
-        if (radio.data(i) < 0x10) {
-            msgStr.concat(F("0"));
-        }
-        msgStr.concat(String(radio.data(i), HEX));
-        if (i < DAVIS_PACKET_LEN -1 ) {
-          msgStr.concat(":");
-        } else {
-          msgStr.concat("\"");
-        }        
-    }
+    json.addUInt("BattWarning", st.transmitterBatteryStatus ? 1 : 0);
+    // Payload: 80:00:b2:30:a9:00:aa:da
+    json.addHex("Payload", st.lastPacket.data, DAVIS_PACKET_LEN, ':');
     // Channel
-    msgStr.concat(", \"Channel\":");
-    msgStr.concat(radio.channel());            
+    json.addUInt("Channel", st.lastPacket.channel);
     // RSSI
-    msgStr.concat(", \"RSSI\":");
-    msgStr.concat(radio.rssi());       
+    json.addInt("RSSI", st.lastPacket.rssi);
+    // Reception time of last packet: PayloadReady and (estimated) Sync Word [us since boot]
+    json.addInt64("RxTime", st.lastPacket.timestampUs);
+    json.addInt64("SyncTime", st.lastPacket.timestampUs - DAVIS_PAYLOAD_AIRTIME_US);
+    // Wall Clock [ms since 1970] (only if set by SNTP)
+    epoch = epochMs();
+    if (epoch) {
+      json.addInt64("Timestamp", epoch);
+    }
+    // Bits repaired by CRC error correction in last packet
+    json.addUInt("Corrected", st.lastPacket.corrected);
     // msgID
-    msgStr.concat(", \"msgID\":");
-    msgStr.concat(msgID);    
+    json.addUInt("msgID", msgID);
     // GoldcapVoltage
     if ((msgID == 0x2) || (msgID =0xff)) {
-      msgStr.concat(", \"GoldcapVoltage\":");
-      msgStr.concat(g_goldcapChargeStatus);
+      json.addFixed("GoldcapVoltage", st.goldcapChargeStatus, 2);
     }
     // Unknown msgID 0x3
     if ((msgID == 0x3) || (msgID =0xff)) {
-      #if HAS_BMP085 
-        myString.concat(F("\"Pressure\" : "));
-        myString.concat(g_pressPa);             
-        myString.concat(F(", \"PressureAtSealevel\" : "));
-        myString.concat(g_pressPaSea);
-        myString.concat(F(", \"InsideTemperature\" : "));
-        myString.concat(g_insideTemperature);
-      #else
-        if (msgID == 0x3) {
-          msgStr.concat(", \"Unknown msgID\":3");
-        }
-      #endif // HAS_BMP085 
+      if (msgID == 0x3) {
+        json.addUInt("Unknown msgID", 3);
+      }
     }
-    // Rainrate
+    // Rainrate (zero click interval: null)
     if ((msgID == 0x5) || (msgID =0xff)) {
-      msgStr.concat(", \"Rainrate\":");
-      msgStr.concat(g_rainRate);
+      if (st.rainRate == DAVIS_RAINRATE_INF) {
+        json.addNull("Rainrate");
+      } else {
+        json.addFixed("Rainrate", st.rainRate, 2);
+      }
     }
     // SolarRadiation
     if ((msgID == 0x7) || (msgID =0xff)) {
-      msgStr.concat(", \"SolarRadiation\":");
-      msgStr.concat(g_solarRadiation);
+      json.addFixed("SolarRadiation", st.solarRadiation, 2);
     }
     // OutsideTemperature
     if ((msgID == 0x8) || (msgID =0xff)) {
-      msgStr.concat(", \"OutsideTemperature\":");
-      msgStr.concat(g_outsideTemperature);
+      json.addFixed("OutsideTemperature", st.outsideTemperature, 2);
     }
     // GustSpeed
     if ((msgID == 0x9) || (msgID =0xff)) {
-      msgStr.concat(", \"GustSpeed\":");
-      msgStr.concat(g_gustSpeed);
+      json.addFixed("GustSpeed", st.gustSpeed, 2);
     }
     // OutsideHumidity
     if ((msgID == 0xa) || (msgID =0xff)) {
-      msgStr.concat(", \"OutsideHumidity\":");
-      msgStr.concat(g_outsideHumidity);
+      json.addFixed("OutsideHumidity", st.outsideHumidity, 2);
     }
     // RainClicks
     if ((msgID == 0xe) || (msgID =0xff)) {
-      msgStr.concat(", \"RainClicks\":");
-      msgStr.concat(g_rainClicks);
-      msgStr.concat(", \"RainClicksDay\":");
-      msgStr.concat(g_rainClicksDay);
-      msgStr.concat(", \"RainClicksSum\":");
-      msgStr.concat(g_rainClicksSum);
+      json.addUInt("RainClicks", st.rainClicks);
+      json.addUInt("RainClicksDay", st.rainClicksDay);
+      json.addUInt("RainClicksSum", st.rainClicksSum);
     }         
     // Statistics
-    msgStr.concat(",");
-    msgStr.concat("\"millis\":" + String(millis()) + ",");
-    msgStr.concat("\"Time before Last Packet received\":" + String(g_sinceLastRx) + ",");    
-    msgStr.concat("\"Packets received\":" + String(g_packetsReceived) + ",");    
-    msgStr.concat("\"CRC-Errors\":" + String(g_crcErrors) + ",");
-    msgStr.concat("\"Automatic Hops\":" + String(g_autoHops) + ",");         
-    msgStr.concat("\"Blackouts\":" + String(g_numBlackouts) + ",");     
-    msgStr.concat("\"Longest Blackout\":" + String(g_longestBlackout) + ",");       
-    msgStr.concat("\"Receive Streak\":" + String(g_receivedStreak) + ",");
-    msgStr.concat("\"Longest Receive Streak\":" + String(g_receivedStreakMax)+ ",");
-    // Receiver Status:
-    // - OK (less than 3 Packets missed)
-    // - Warning (4 to 20 Packets missed)
-    // - Error (more than one Minute without Data)
-    msgStr.concat("\"Receiver Status\":");    
-    t = millis() - g_lastRxTime;
-    if (t < 10000) {                               // 10s no Reception (3 Packets)
-    msgStr.concat("\"OK\"");
-    } else if (t < 60000) {                        // 60s no Reception (20 Packets)
-    msgStr.concat("\"Warning (4 to 20 Packets missed)\"");
-    } else {                                       // More than 60s no Reception 
-    msgStr.concat("\"Error (more than one Minute without Data)\"");
-    } 
-    msgStr.concat("}");    
-    // Publish MQTT
-    mqttPub(T_ISS, msgStr, true);      
+    json.addUInt("millis", millis());
+    json.addUInt("Time before Last Packet received", st.sinceLastRx);
+    json.addUInt("Packets received", st.packetsReceived);
+    json.addUInt("CRC-Errors", g_crcErrors);
+    json.addUInt("CRC-Corrected", g_crcCorrected);
+    json.addUInt("Automatic Hops", hopScheduler.tx(id).missed);
+    json.addUInt("Blackouts", hopScheduler.tx(id).lost);
+    json.addUInt("Longest Blackout", st.longestBlackout);
+    json.addUInt("Receive Streak", st.receivedStreak);
+    json.addUInt("Longest Receive Streak", st.receivedStreakMax);
+    // Receiver Status
+    json.addString("Receiver Status", ISS_RECEIVER_STATUS_NAMES[receiverStatus(id)]);
+    json.endObject();
+    // Publish MQTT: ISS/1 - ISS/8
+    mqttPubJson(TOPIC_ISS + id, true);      
+}
+
+
+/*********************************************************
+ * Send Received Packet as compact Message
+ *********************************************************
+ * - same Data as sendIssData(), encoded as CBOR map with 
+ *   integer keys (see IssCbor.h), about a quarter of the size
+ * - rendered by cbor into a static buffer (no heap)
+ * - tools/iss_decode turns it back into the JSON Message
+ *************************************************************************
+ * @param[in] id:    Transmitter ID (0-7)
+ * @param[in] msgID: Message ID of the last packet
+ **************************************************************************/
+void sendIssCbor(uint8_t id, uint8_t msgID) {
+    IssStation &st = g_station[id];
+    int64_t epoch;
+    cbor.reset();
+    cbor.beginMap();
+    cbor.addUInt(ISS_KEY_VERSION, ISS_CBOR_VERSION);
+    // Wind, Battery
+    cbor.addFixed(ISS_KEY_WINDSPEED, st.windSpeed, 2);
+    cbor.addUInt(ISS_KEY_WINDDIRECTION, st.windDirection);
+    cbor.addUInt(ISS_KEY_BATTWARNING, st.transmitterBatteryStatus ? 1 : 0);
+    // Last Packet
+    cbor.addBytes(ISS_KEY_PAYLOAD, st.lastPacket.data, DAVIS_PACKET_LEN);
+    cbor.addUInt(ISS_KEY_CHANNEL, st.lastPacket.channel);
+    cbor.addInt(ISS_KEY_RSSI, st.lastPacket.rssi);
+    cbor.addInt(ISS_KEY_RXTIME, st.lastPacket.timestampUs);
+    cbor.addInt(ISS_KEY_SYNCTIME, st.lastPacket.timestampUs - DAVIS_PAYLOAD_AIRTIME_US);
+    epoch = epochMs();
+    if (epoch) {
+      cbor.addInt(ISS_KEY_TIMESTAMP, epoch);
+    }
+    cbor.addUInt(ISS_KEY_CORRECTED, st.lastPacket.corrected);
+    cbor.addUInt(ISS_KEY_MSGID, msgID);
+    // Measurements (all of them, as the JSON Message)
+    cbor.addFixed(ISS_KEY_GOLDCAP, st.goldcapChargeStatus, 2);
+    if (st.rainRate == DAVIS_RAINRATE_INF) {
+      cbor.addNull(ISS_KEY_RAINRATE);
+    } else {
+      cbor.addFixed(ISS_KEY_RAINRATE, st.rainRate, 2);
+    }
+    cbor.addFixed(ISS_KEY_SOLAR, st.solarRadiation, 2);
+    cbor.addFixed(ISS_KEY_TEMPERATURE, st.outsideTemperature, 2);
+    cbor.addFixed(ISS_KEY_GUSTSPEED, st.gustSpeed, 2);
+    cbor.addFixed(ISS_KEY_HUMIDITY, st.outsideHumidity, 2);
+    cbor.addUInt(ISS_KEY_RAINCLICKS, st.rainClicks);
+    cbor.addUInt(ISS_KEY_RAINCLICKS_DAY, st.rainClicksDay);
+    cbor.addUInt(ISS_KEY_RAINCLICKS_SUM, st.rainClicksSum);
+    // Statistics
+    cbor.addUInt(ISS_KEY_MILLIS, millis());
+    cbor.addUInt(ISS_KEY_SINCE_LAST_RX, st.sinceLastRx);
+    cbor.addUInt(ISS_KEY_PACKETS, st.packetsReceived);
+    cbor.addUInt(ISS_KEY_CRC_ERRORS, g_crcErrors);
+    cbor.addUInt(ISS_KEY_CRC_CORRECTED, g_crcCorrected);
+    cbor.addUInt(ISS_KEY_AUTO_HOPS, hopScheduler.tx(id).missed);
+    cbor.addUInt(ISS_KEY_BLACKOUTS, hopScheduler.tx(id).lost);
+    cbor.addUInt(ISS_KEY_LONGEST_BLACKOUT, st.longestBlackout);
+    cbor.addUInt(ISS_KEY_STREAK, st.receivedStreak);
+    cbor.addUInt(ISS_KEY_STREAK_MAX, st.receivedStreakMax);
+    cbor.addUInt(ISS_KEY_RX_STATUS, receiverStatus(id));
+    cbor.endMap();
+    // Publish MQTT: ISS/1 - ISS/8
+    if (cbor.overflow()) {
+      countFailed(TOPIC_ISS + id);
+      DBG_ERROR.println("ERROR: CBOR-Buffer too small");
+      return;
+    }
+    mqttPublish(TOPIC_ISS + id, (const char *)cbor.data(), cbor.length(), true);
+}
+
+
+/************************************************************
+ * Receiver Status of a transmitter
+ * @param[in] id Transmitter ID (0-7)
+ * @return    ISS_RX_STATUS_OK: less than 3 Packets missed
+ *            ISS_RX_STATUS_WARNING: 4 to 20 Packets missed
+ *            ISS_RX_STATUS_ERROR: more than one Minute without Data
+ ************************************************************/
+byte receiverStatus(uint8_t id) {
+  uint32_t t = (uint32_t)((esp_timer_get_time() - g_station[id].lastRxUs) / 1000);
+  if (t < 10000) return ISS_RX_STATUS_OK;          // 10s no Reception (3 Packets)
+  if (t < 60000) return ISS_RX_STATUS_WARNING;     // 60s no Reception (20 Packets)
+  return ISS_RX_STATUS_ERROR;                      // More than 60s no Reception 
 }
 
 
@@ -1086,19 +2813,200 @@ void sendIssData(uint8_t msgID) {
  * this will send State of Network  as JSON Message:
  ************************************************************
  * {"IP-Address":"192.168.1.42",
- *  "MQTT-ClientID":"esp32_00_00_00"  
+ *  "MQTT-ClientID":"esp32_00_00_00",
+ *  "Topics":[{"Topic":"ISS/1","Published":1204,"Bytes":702332,"Failed":0},
+ *            {"Topic":"ISS/1/+","Published":310,"Bytes":1240,"Failed":0},
+ *            {"Topic":"cpu","Published":42,"Bytes":8190,"Failed":1}],
+ *  "Connection":{"State":"online","Since [s]":3605,"WiFi Connects":1,"MQTT Connects":2},
+ *  "Batch":{"Records per Batch":8,"Period [s]":0,"Latency Cap [s]":30,"Pending":3,
+ *           "Batches":120,"Records":941,"Flushes":{"count":112,"period":0,"latency":5,"size":3,"config":0}},
+ *  "Queue":{"RAM Records":0,"Flash Records":12,"Enqueued":40,"Forwarded":28,
+ *           "Dropped":0,"High Water":14,"Flash ok":1,"Drain Rate":5},
+ *  "Compression":{"Span [s]":600,"Fields":[{"Field":"temperature","Deviation":0.10,
+ *           "Values":1440,"Points":52,"Ratio":27.69,"RMS Error":0.0312}]}
  * }
  ************************************************************
  * @param[in] mqttOnly if false, then also Serial Output is generated
  ************************************************************/ 
 void sendNetworkState(boolean mqttOnly) {    
-  String msgStr;    
+  IPAddress ip = WiFi.localIP();
+  char ipStr[4 * JSON_WRITER_NUM_LEN];
+  size_t len = 0;
+  for (byte i = 0; i < 4; i++) {
+    len += JsonWriter::formatUInt64(ip[i], ipStr + len);
+    if (i < 3) ipStr[len++] = '.';
+  }
   // Publish MQTT
-  msgStr = '{';  
-  msgStr.concat("\"IP-Address\":\"" + WiFi.localIP().toString() + "\",");
-  msgStr.concat("\"MQTT-ClientID\":\"" + composeClientID() + "\"");     
-  msgStr.concat("}");    
-  mqttPub(T_NETWORK, msgStr, mqttOnly);
+  json.reset();
+  json.beginObject();
+  json.addString("IP-Address", ipStr);
+  json.addString("MQTT-ClientID", g_clientID);
+  // Publish Statistics of used Topics
+  json.beginArray("Topics");
+  for (byte t = 0; t < TOPIC_NUM; t++) {
+    MqttTopicStats stats = g_topicStats[t];
+    char fieldTopic[] = T_ISS "/0/+";
+    // Field Topics: one entry per transmitter, ISS/[ID]/+
+    if (t >= TOPIC_FIELD) {
+      for (byte f = 1; f < FIELD_NUM; f++) {
+        stats.published += g_topicStats[t + f].published;
+        stats.bytes     += g_topicStats[t + f].bytes;
+        stats.failed    += g_topicStats[t + f].failed;
+      }
+      fieldTopic[sizeof(T_ISS)] = '1' + (t - TOPIC_FIELD) / FIELD_NUM;
+      t += FIELD_NUM - 1;
+    }
+    if ((stats.published == 0) && (stats.failed == 0)) continue;
+    json.beginObject();
+    json.addString("Topic", (t >= TOPIC_FIELD) ? fieldTopic : TOPIC_SUBTOPIC(t));
+    json.addUInt("Published", stats.published);
+    json.addUInt("Bytes", stats.bytes);
+    json.addUInt("Failed", stats.failed);
+    json.endObject();
+  }
+  json.endArray();
+  // Connection
+  json.beginObject("Connection");
+  json.addString("State", NET_STATE_NAMES[g_netState]);
+  json.addUInt("Since [s]", (millis() - g_netStateSince) / 1000);
+  json.addUInt("WiFi Connects", g_wifiConnects);
+  json.addUInt("MQTT Connects", g_MqttReconnectCount);
+  json.endObject();
+  // Batch Mode
+  json.beginObject("Batch");
+  json.addUInt("Records per Batch", g_batchCount);
+  json.addUInt("Period [s]", g_batchPeriod);
+  json.addUInt("Latency Cap [s]", g_batchLatency);
+  json.addUInt("Pending", g_batchRecords);
+  json.addUInt("Batches", g_batchesSent);
+  json.addUInt("Records", g_batchRecordsSent);
+  json.beginObject("Flushes");
+  for (byte r = 0; r < BATCH_FLUSH_NUM; r++) {
+    json.addUInt(BATCH_FLUSH_NAMES[r], g_batchFlushes[r]);
+  }
+  json.endObject();
+  json.endObject();
+  // Store and Forward
+  const OutboundStats &qs = outbox.stats();
+  json.beginObject("Queue");
+  json.addUInt("RAM Records", outbox.ramCount());
+  json.addUInt("Flash Records", outbox.flashCount());
+  json.addUInt("Enqueued", qs.enqueued);
+  json.addUInt("Forwarded", qs.forwarded);
+  json.addUInt("Dropped", qs.dropped);
+  json.addUInt("High Water", qs.highWater);
+  json.addUInt("Flash ok", outbox.flashReady() ? 1 : 0);
+  json.addUInt("Drain Rate", g_queueRate);
+  json.endObject();
+  // Swinging Door Compression: per field (all transmitters)
+  json.beginObject("Compression");
+  json.addUInt("Span [s]", g_sdtSpan);
+  json.beginArray("Fields");
+  for (byte f = 0; f < FIELD_NUM; f++) {
+    uint32_t inputs = 0, archived = 0;
+    double sse = 0;
+    for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+      inputs   += sdt[id][f].inputs();
+      archived += sdt[id][f].archived();
+      sse      += sdt[id][f].sse();
+    }
+    if (inputs == 0) continue;
+    json.beginObject();
+    json.addString("Field", FIELDS[f].name);
+    json.addFixed("Deviation", g_sdtDeviation[f], FIELDS[f].decimals);
+    json.addUInt("Values", inputs);
+    json.addUInt("Points", archived);
+    json.addFixed("Ratio", archived ? (int32_t)lround(100.0 * inputs / archived) : 0, 2);
+    json.addFixed("RMS Error", (int32_t)lround(100.0 * sqrt(sse / inputs)), FIELDS[f].decimals + 2);
+    json.endObject();
+  }
+  json.endArray();
+  json.endObject();
+  json.endObject();
+  mqttPubJson(TOPIC_NETWORK, mqttOnly);
+}
+
+
+/************************************************************
+ * Send RFM State
+ * this will send State of the RFM69 Receiver as JSON Message:
+ ************************************************************
+ * {"Region":"EU","Channel":3,"Locked":1,"Next Transmitter":1,
+ *  "Stations":[{"ID":1,"Locked":1,"Packet Interval [us]":2562500,
+ *    "Arrival Jitter [us]":1200,"Missed":3,"Skipped":0,"Lost":0}],
+ *  "Hop Source":"timer","Hops measured":12,
+ *  "Acquiring":0,"Carriers detected":3,"Acquisitions":1,
+ *  "Time to Lock Last [ms]":7841,"Time to Lock Mean [ms]":7841,
+ *  "Time to Lock Max [ms]":7841,
+ *  "Hop Lateness Mean [us]":14,"Hop Lateness Max [us]":31,
+ *  "Ring Size":16,"Ring Pending":0,
+ *  "Ring High Water":2,"Ring Overflows":0,
+ *  "Shadow Mismatches":0,
+ *  "Channel Offset [Hz]":[-1220,-1160,-1281,-1098,-1220],
+ *  "Channel Packets":[212,208,215,210,209],
+ *  "Channel CRC Errors [%]":[1.4,0.0,2.3,0.5,0.9]
+ * }
+ ************************************************************
+ * @param[in] mqttOnly if false, then also Serial Output is generated
+ ************************************************************/ 
+void sendRfmState(boolean mqttOnly) {    
+  json.reset();
+  json.beginObject();
+  json.addString("Region", DavisRFM69::regionName(radio.region()));
+  json.addUInt("Channel", radio.channel());
+  json.addUInt("Locked", hopScheduler.locked() ? 1 : 0);
+  json.addInt("Next Transmitter", hopScheduler.target() + 1);
+  json.beginArray("Stations");
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    const DavisHopTx &t = hopScheduler.tx(id);
+    if (!g_station[id].active) continue;
+    json.beginObject();
+    json.addUInt("ID", id + 1);
+    json.addUInt("Locked", t.locked ? 1 : 0);
+    json.addUInt("Packet Interval [us]", t.periodUs);
+    json.addUInt("Arrival Jitter [us]", t.jitterUs);
+    json.addUInt("Missed", t.missed);
+    json.addUInt("Skipped", t.skipped);
+    json.addUInt("Lost", t.lost);
+    json.endObject();
+  }
+  json.endArray();
+  json.addString("Hop Source", HOP_BY_TIMER ? "timer" : "loop");
+  json.addUInt("Hops measured", g_hopLateCount);
+  json.addInt("Hop Lateness Mean [us]", g_hopLateCount ? (int32_t)(g_hopLateSum / g_hopLateCount) : 0);
+  json.addInt("Hop Lateness Max [us]", g_hopLateMax);
+  json.addUInt("Acquiring", g_acqState != ACQ_OFF ? 1 : 0);
+  json.addUInt("Carriers detected", g_acqCarriers);
+  json.addUInt("Acquisitions", g_acqLocks);
+  json.addUInt("Time to Lock Last [ms]", g_timeToLockLast);
+  json.addUInt("Time to Lock Mean [ms]", g_acqLocks ? (uint32_t)(g_timeToLockSum / g_acqLocks) : 0);
+  json.addUInt("Time to Lock Max [ms]", g_timeToLockMax);
+  json.addUInt("Ring Size", DAVIS_RING_SIZE);
+  json.addUInt("Ring Pending", radio.packetsPending());
+  json.addUInt("Ring High Water", radio.ringHighWater());
+  json.addUInt("Ring Overflows", radio.ringOverflows());
+  json.addUInt("Shadow Mismatches", radio.shadowMismatches());
+  // Per Channel: learned frequency offset, packets and CRC error rate [0.1 %]
+  json.beginArray("Channel Offset [Hz]");
+  for (byte ch = 0; ch < radio.numChannels(); ch++) {
+    json.addInt(NULL, radio.channelOffsetHz(ch));
+  }
+  json.endArray();
+  json.beginArray("Channel Packets");
+  for (byte ch = 0; ch < radio.numChannels(); ch++) {
+    json.addUInt(NULL, radio.channelPackets(ch));
+  }
+  json.endArray();
+  json.beginArray("Channel CRC Errors [%]");
+  for (byte ch = 0; ch < radio.numChannels(); ch++) {
+    uint32_t good = radio.channelPackets(ch);
+    uint32_t bad = radio.channelCrcErrors(ch);
+    uint32_t total = good + bad;
+    json.addFixed(NULL, total ? (int32_t)(((uint64_t)bad * 1000 + total / 2) / total) : 0, 1);
+  }
+  json.endArray();
+  json.endObject();
+  mqttPubJson(TOPIC_RFMSTATS, mqttOnly);  
 }
 
 
@@ -1116,89 +3024,103 @@ void sendNetworkState(boolean mqttOnly) {
  * @param[in] mqttOnly if false, then also Serial Output is generated
  ************************************************************/ 
 void sendSketchState(boolean mqttOnly) {    
-  String msgStr;    
-  msgStr = '{';
-  msgStr.concat("\"Project version\":\"" + String(VERSION) + "\",");
-  msgStr.concat("\"Target\":\"" + String(TARGET) + "\",");
-  msgStr.concat("\"Build timestamp\":\"" + String(BUILD_TIMESTAMP)+ "\",");  
-  msgStr.concat("\"Sdk Version\":\"" + String(ESP.getSdkVersion()) + "\",");     
-  msgStr.concat("\"CpuFreq\":" + String(ESP.getCpuFreqMHz()) + ",");
-  msgStr.concat("\"SketchSize\":" + String(ESP.getSketchSize()) + ",");
-  msgStr.concat("\"Free SketchSpace\":" + String(ESP.getFreeSketchSpace()) + ",");
-  msgStr.concat("\"Sketch MD5\":\"" + String(ESP.getSketchMD5()) + "\",");
-  msgStr.concat("\"Flash ChipSize\":" + String(ESP.getFlashChipSize()) + ",");
-  msgStr.concat("\"Flash Chip Speed\":" + String(ESP.getFlashChipSpeed()));  
-  msgStr.concat("}");  
-  mqttPub(T_SKETCH, msgStr, true);  
+  json.reset();
+  json.beginObject();
+  json.addString("Project version", VERSION);
+  json.addString("Target", TARGET);
+  json.addString("Build timestamp", BUILD_TIMESTAMP);
+  json.addString("Sdk Version", ESP.getSdkVersion());
+  json.addUInt("CpuFreq", ESP.getCpuFreqMHz());
+  json.addUInt("SketchSize", g_sketchSize);
+  json.addUInt("Free SketchSpace", ESP.getFreeSketchSpace());
+  json.addString("Sketch MD5", g_sketchMD5);
+  json.addUInt("Flash ChipSize", ESP.getFlashChipSize());
+  json.addUInt("Flash Chip Speed", ESP.getFlashChipSpeed());
+  json.endObject();
+  mqttPubJson(TOPIC_SKETCH, true);  
 }
                   
 
-/************************************************************
- * Init Command Parser
- ************************************************************/ 
-void setupCommandParser(void) {  
-  DBG_SETUP.print("- Init Command Parser... ");  
-  // "command", Params, Callback-Function 
-  // s: String, d:Double, u:Unsigned Int , i:Signed Integer  
-  parser.registerCommand("allrx",  "u", &cmd_allrx);                  // allrx  - Switch on/Off Message for each Packed received
-  parser.registerCommand("hello",  "",  &cmd_hello);                  // hello  - Ping  
-  parser.registerCommand("help",   "",  &cmd_help);                   // help   - Send Help 
-  parser.registerCommand("newday", "",  &cmd_newday);                 // newday - Reset Daily Raincounter
-  parser.registerCommand("period", "u", &cmd_period);                 // period - Set Message Period
-  parser.registerCommand("reboot", "",  &cmd_reboot);                 // reboot - Reboot ESP32
-  parser.registerCommand("reset",  "",  &cmd_reset);                  // reset  - Reset Statistics
-  parser.registerCommand("setrc",  "u", &cmd_setrc);                  // setRC  - Set Raincounter
-  DBG_SETUP.println("done.");
-  delay(DEBUG_SETUP_DELAY);  
-}
-
-
 /************************************************************
  * Init Global Vars
  ************************************************************/ 
 void setupGlobalVars(void){
   DBG_SETUP.print("- Global Vars ... ");    
-  g_Firstrun = true;
-  g_LastCron_1s = millis();       
-  g_LastCron_10s = millis();       
-  g_LastCron_30s = millis();       
-  g_LastCron_60s = millis();       
-  g_LastMqttReconnectAttempt = millis();     
-  g_LastNetMonitoring = millis();          // Timer for Monitoring Network   
+  g_netState = NET_WIFI_WAIT;              // Connection state, see monitorConnections()
+  g_netStateSince = millis();
+  g_netRetryDelay = 0;
+  g_wifiFailures = 0;
+  g_mqttFailures = 0;
+  g_wifiConnects = 0;
   g_MqttReconnectCount = 0;  
-  g_wificonnected = false;  
+  g_wifiUp = false;  
+  g_wifiDropped = false;
   g_rebootActive = false;                  
   g_rebootTriggered = millis();            // millis() when reboot was started  
+  g_bootId = esp_random();
+  g_queueRate = QUEUE_DRAIN_RATE;
+  g_batchCount = 0;                        // Batch Mode off
+  g_batchPeriod = 0;
+  g_batchLatency = BATCH_LATENCY;
+  g_batchRecords = 0;
+  prefs.begin(NVS_NAMESPACE, true);
+  g_issCbor = prefs.getUChar(NVS_KEY_CBOR, ISS_CBOR_TX);
+  prefs.end();
+  g_sendFields = false;                    // Field Topics off
+  for (byte f = 0; f < FIELD_NUM; f++) {
+    g_fieldDeadband[f] = FIELDS[f].deadband;
+  }
+  memset(g_fieldSeen, 0, sizeof(g_fieldSeen));
+  memset(g_fieldPublished, 0, sizeof(g_fieldPublished));
+  g_fieldResync = false;
+  g_sdtSpan = 0;                           // Swinging Door off
+  for (byte f = 0; f < FIELD_NUM; f++) {
+    g_sdtDeviation[f] = FIELDS[f].deviation;
+  }
+  sdtConfigure();
+  strlcpy(g_clientID, composeClientID().c_str(), sizeof(g_clientID));
+  strlcpy(g_sketchMD5, ESP.getSketchMD5().c_str(), sizeof(g_sketchMD5));
+  g_sketchSize = ESP.getSketchSize();
   // RFM69
-  g_hopCount = 0;
-  g_lastRxTime = 0;    
-  g_sinceLastRx = 0;
-  g_lastTimeout = 0;  
-  g_longestBlackout = 0;  
-  g_packetsReceived = 0;
-  g_autoHops = 0;
-  g_BlackoutTag = false;
-  g_numBlackouts = 0;
-  g_receivedStreak = 0;
-  g_receivedStreakMax = 0;
+  hopScheduler.reset();
+  g_acqState = ACQ_OFF;
+  g_acqUntil = 0;
+  g_acqStart = 0;
+  g_acqCarriers = 0;
+  g_acqLocks = 0;
+  g_timeToLockLast = 0;
+  g_timeToLockMax = 0;
+  g_timeToLockSum = 0;
+  g_missedHops = 0;
+  g_missedHopsSeen = 0;
+  g_hopLateCount = 0;
+  g_hopLateSum = 0;
+  g_hopLateMax = 0;
   g_crcErrors = 0;  
+  g_crcCorrected = 0;
   g_sendReceivedPackets = true;
+  memset(g_topicStats, 0, sizeof(g_topicStats));
   g_sendIntervall = 1800;
   g_lastDataSend = 0;
-  // ISS Weather Data
-  g_windSpeed = -1;
-  g_windDirection = 999;
-  g_transmitterBatteryStatus = true;
-  g_goldcapChargeStatus = -1;
-  g_rainRate = -1;
-  g_solarRadiation = -1;
-  g_outsideTemperature = 999;
-  g_gustSpeed = -1;
-  g_outsideHumidity = -1;
-  g_rainClicks = 255;
-  g_rainClicksLast = 255;
-  g_rainClicksDay = 0;
-  g_rainClicksSum = 0;
+  for (uint8_t id = 0; id < DAVIS_HOP_MAX_TX; id++) {
+    IssStation &st = g_station[id];
+    memset(&st, 0, sizeof(st));
+    st.active = false;
+    // ISS Weather Data
+    st.windSpeed = -100;
+    st.windDirection = 999;
+    st.transmitterBatteryStatus = true;
+    st.goldcapChargeStatus = -100;
+    st.rainRate = -100;
+    st.solarRadiation = -100;
+    st.outsideTemperature = 99900;
+    st.gustSpeed = -100;
+    st.outsideHumidity = -100;
+    st.rainClicks = 255;
+    st.rainClicksLast = 255;
+    st.rainClicksDay = 0;
+    st.rainClicksSum = 0;
+  }
   DBG_SETUP.println("done.");
   delay(DEBUG_SETUP_DELAY);  
 }
@@ -1218,36 +3140,61 @@ void setupGPIO(void) {
 
 /************************************************************
  * MQTT Init
- * - Set LastWill to 
- *   - topic:   TOPIC_STATUS 
- *   - message: STATUS_MSG_OFF
- *   - retain:  yes
- * - subscribe to MQTT_PREFIX "/" T_CMD
- * - publish 
- *   - topic:   TOPIC_STATUS 
- *   - message: STATUS_MSG_ON
- *   - retain:  yes
+ * - Register Callback for Commands
+ * - the connection is set up by monitorConnections() as soon 
+ *   as WiFi is connected (LastWill, Status ONLINE, Subscribe)
  ************************************************************/ 
 void setupMQTT(void) {    
-  String myClientID;
-  myClientID = composeClientID();
-  DBG_SETUP.println("Connecting to MQTT-Server ... ");  
+  DBG_SETUP.println("- Init MQTT... ");  
   DBG_SETUP.print("  - ClientID: ");
-  DBG_SETUP.println(myClientID);  
-  if (mqtt.connect(myClientID.c_str(), MQTT_USER, MQTT_PASS, MQTT_PREFIX "/" T_STATUS, 1, true, STATUS_MSG_OFF, true))  { 
-    DBG_SETUP.println("  - Register Callback");
-    mqtt.setCallback(mqttCallback);
-    mqtt.setBufferSize(MQTT_BUFSIZE);
-    DBG_SETUP.println("  - Publish State ONLINE");
-    mqtt.publish(MQTT_PREFIX "/" T_STATUS, STATUS_MSG_ON, true);
-    DBG_SETUP.print("  - Subscribe to ");
-    DBG_SETUP.println(MQTT_PREFIX "/" T_CMD);
-    mqtt.subscribe(MQTT_PREFIX "/" T_CMD);
-    DBG_SETUP.println("  connected.");    
-  } else {      
-      DBG_SETUP.println("Connection failed - trying later...");  
-  }   
-  mqtt.loop();
+  DBG_SETUP.println(g_clientID);  
+  DBG_SETUP.println("  - Register Callback");
+  mqtt.setCallback(mqttCallback);
+  DBG_SETUP.println("  - connecting in background");
+  delay(DEBUG_SETUP_DELAY);
+}
+
+
+/************************************************************
+ * Setup Store and Forward
+ * - mount LittleFS and open flash log of the outbox
+ * - Messages queued before reboot are forwarded after connect
+ ************************************************************/ 
+void setupQueue(void) {
+  DBG_SETUP.println("- Init Outbox... ");
+  if (outbox.begin()) {
+    DBG_SETUP.print("  - Flash Log ok, queued Messages: ");
+    DBG_SETUP.println(outbox.size());
+  } else {
+    DBG_SETUP.println("  - Flash Log not available, RAM only");
+  }
+  delay(DEBUG_SETUP_DELAY);
+}
+
+
+/************************************************************
+ * Setup Tasks
+ * - queues between loop() and the network task
+ * - start network task on NET_TASK_CORE
+ * - on error the network is handled by loop()
+ ************************************************************/ 
+void setupTasks(void) {
+  DBG_SETUP.println("- Init Tasks... ");
+  radioTask = xTaskGetCurrentTaskHandle();   // setup() and loop() run in the same task
+  vTaskPrioritySet(radioTask, RADIO_TASK_PRIO);
+  pubRing = xRingbufferCreate(PUB_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+  cmdQueue = xQueueCreate(CMD_QUEUE_LEN, sizeof(CommandCall));
+  if (!pubRing || !cmdQueue || 
+      (xTaskCreatePinnedToCore(networkTask, "network", NET_TASK_STACK, NULL, NET_TASK_PRIO, &netTask, NET_TASK_CORE) != pdPASS)) {
+    netTask = NULL;
+    DBG_ERROR.println("ERROR: Network Task not started, handled by loop()");
+  } else {
+    DBG_SETUP.print("  - Network Task on Core ");
+    DBG_SETUP.print(NET_TASK_CORE);
+    DBG_SETUP.print(", Radio on Core ");
+    DBG_SETUP.println(xPortGetCoreID());
+  }
+  delay(DEBUG_SETUP_DELAY);
 }
 
 
@@ -1273,17 +3220,18 @@ void setupOTA(void) {
 
   // OTA Callback: onStart
   ArduinoOTA.onStart([]() {
-    String type;
+    const char *msg;
     if (ArduinoOTA.getCommand() == U_FLASH) {
-      type = "sketch";
+      msg = "Update Started: sketch";
     } else { // U_FS
-      type = "filesystem";
+      msg = "Update Started: filesystem";
     }
     // NOTE: if updating FS this would be the place to unmount FS using FS.end()
-    // DBG_SETUP.println("Start updating " + type);
-    dbgout("Update Started: " + type);
+    dbgout(msg);
     // Switch Radio to standby -> don't mess up with receive interrupts
-    radio.standby();
+    // (done by loop(), the radio is only accessed from there)
+    g_radioStandby = true;
+    wakeRadioTask();
   });  
 
   // OTA Callback: onEnd
@@ -1327,10 +3275,61 @@ void setupOTA(void) {
  * - Set Channel 0
  ************************************************************/ 
 void setupRadio(void) {
+  byte region;
   DBG.print(F("init radio..."));
+  prefs.begin(NVS_NAMESPACE, true);
+  region = prefs.getUChar(NVS_KEY_REGION, DAVIS_REGION_DEFAULT);
+  prefs.end();
+  if (!radio.setRegion(region)) {
+    radio.setRegion(DAVIS_REGION_DEFAULT);
+  }
+  hopScheduler.setNumChannels(radio.numChannels());
   radio.init();
   radio.setChannel(0);              // Select Channel 0 
-  DBG.println(F("done"));
+  DBG.print(F("done, region: "));
+  DBG.println(DavisRFM69::regionName(radio.region()));
+}
+
+
+/************************************************************
+ * Select Frequency Region
+ * - hop schedule is learned again on the new channel table
+ * - receiver restarts on channel 0
+ * @param[in] region DAVIS_REGION_US, DAVIS_REGION_EU
+ ************************************************************/ 
+void selectRegion(byte region) {
+  radio.setRegion(region);
+  hopScheduler.reset();
+  hopScheduler.setNumChannels(radio.numChannels());
+  radio.setChannel(0);
+  startAcquisition();
+  armHopTimer();
+}
+
+
+/************************************************************
+ * Setup Hop Timer
+ * - hardware timer with 1 MHz, ISR wakes loop() to hop on 
+ *   missing packets (HOP_BY_TIMER 1)
+ * - the timer ISR runs on the core calling this function,
+ *   the same core as the radio ISR and loop()
+ * - register radio IRQ handler, which wakes loop() to read 
+ *   the packet (no SPI access from the radio ISR)
+ * - register radio packet handler, which re-arms the timer
+ ************************************************************/ 
+void setupHopTimer(void) {
+  DBG_SETUP.print("- Init Hop Timer... ");  
+  #if HOP_BY_TIMER
+  hopTimer = timerBegin(HOP_TIMER_NUM, 80, true);        // APB 80 MHz / 80 = 1 MHz
+  timerAttachInterrupt(hopTimer, &onHopTimer, true);
+  #endif
+  radio.setIrqHandler(wakeRadioTaskFromISR);
+  radio.setPacketHandler(onRadioPacket);
+  radio.setCorrectionFilter(onCorrectedPacket);
+  startAcquisition();
+  armHopTimer();
+  DBG_SETUP.println("done.");
+  delay(DEBUG_SETUP_DELAY);  
 }
 
 
@@ -1338,32 +3337,20 @@ void setupRadio(void) {
  * Init Wifi 
  * - SSID: WIFI_SSID 
  * - PSK:  WIFI_PSK
+ * - does not wait for the connection, see monitorConnections()
  ************************************************************/ 
 void setupWIFI(void) {      
-  int cnt = 0;  
   DBG_SETUP.println("- Init WiFi... ");
   DBG_SETUP.print("  - connecting to '");    
   DBG_SETUP.print(g_wifissid);    
   DBG_SETUP.println("'");      
   WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);    // reconnected with backoff by monitorConnections()
+  WiFi.onEvent(onWiFiEvent);
   WiFi.begin(g_wifissid, g_wifipass);
-  delay(5000);
-  while ((WiFi.status() != WL_CONNECTED) && (cnt < T_WIFI_MAX_TRIES)){
-    cnt++;
-    DBG_SETUP.print("  - Connection failed! - Retrying [");      
-    DBG_SETUP.print(cnt);      
-    DBG_SETUP.println("]...");    
-    delay(2000);
-  }
-  if (WiFi.status() != WL_CONNECTED) {
-    g_wificonnected = false;
-    DBG_SETUP.println("  - Connection failed! - trying later...");
-  } else {
-    g_wificonnected = true;
-    DBG_SETUP.println("  - Successfully connected");    
-    DBG_SETUP.print("  IP address: ");
-    DBG_SETUP.println(WiFi.localIP());
-  }  
+  configTime(0, 0, NTP_SERVER);    // Wall Clock (UTC), synchronized as soon as WiFi is up
+  setNetState(NET_WIFI_WAIT, 0);
+  DBG_SETUP.println("  - connecting in background");
   delay(DEBUG_SETUP_DELAY);
 }
 
@@ -1401,15 +3388,24 @@ void setup(void) {
   // OTA-Update-Handler  
   setupOTA();    
 
+  // Store and Forward
+  setupQueue();
+
   // MQTT
   setupMQTT();
    
-  // MQTT Command Parser
-  setupCommandParser();
-  
   // RFM-Radio
   setupRadio();
 
+  // Hop Timer
+  setupHopTimer();
+
+  // Jobs of loop()
+  setupScheduler();
+
+  // Network Task
+  setupTasks();
+
   // Setup finished  
   dbgout("Init complete, starting Main-Loop");  
   DBG_SETUP.println("##########################################");
@@ -1418,21 +3414,55 @@ void setup(void) {
 
 
 /************************************************************
- * Main Loop
- * - OTA handler
- * - HeartBeat handler
+ * Main Loop (radio task)
+ * - Radio, Decoding, Commands, HeartBeat handler
+ * - WiFi, MQTT and OTA are handled by networkTask()
+ * - event driven: sleeps until the next deadline of the 
+ *   scheduler (Cronjobs, batch flush, hop) or until woken by 
+ *   a task notification (radio ISR, Command, network task), 
+ *   at most T_RADIO_WAIT_MAX
  ************************************************************/ 
 void loop(void) {
+  int64_t start = esp_timer_get_time();
+  int64_t now;
+  int64_t waitUs;
+  uint32_t elapsed;
   // Main Handler
   resetHandler();                  // reset ESP if triggered (see: g_rebootActive and g_rebootTriggered)
-  monitorConnections();            // Monitor (and restore) Wifi & MQTT Connection
-  mqtt.loop();                     // handle MQTT Messaging  
-  ArduinoOTA.handle();             // handle OTA  
-  cronjob();                       // Cronjob-Handler  
-  // APP Handler
-  
-  // First Loop completed
-  g_Firstrun = false;              
-  //   setupRadio(void);
+  if (!netTask) {
+    networkLoop(0);                // Network Task not running
+  }
+  while (radio.service()) {        // Packet signaled by the radio ISR: read, re-arm receiver
+  }
+  if (g_hopTimerExpired) {         // Hop deadline reached (HOP_BY_TIMER 1)
+    g_hopTimerExpired = false;
+    hopPoll();
+    armHopTimer();
+  }
+  if (g_radioStandby) {            // OTA update started
+    g_radioStandby = false;
+    radio.standby();
+  }
+  processCommands();               // Commands received by the network task
+  scheduler.run(start);            // Cronjobs, batch flush, hop (HOP_BY_TIMER 0)
+  fieldsPoll();                    // Field Topics: publish all after reconnect
   pollRadio();
+  scheduler.at(JOB_BATCH, batchDeadline());
+  #if !HOP_BY_TIMER
+  scheduler.at(JOB_HOP, hopDeadline());
+  #endif
+  now = esp_timer_get_time();
+  elapsed = (uint32_t)(now - start);
+  g_radioBusyUs += elapsed;
+  if (elapsed > g_radioStallMaxUs) g_radioStallMaxUs = elapsed;
+  // Sleep until the next deadline or event, the radio ISR and the 
+  // hop timer ISR wake loop() (HOP_BY_TIMER 1)
+  waitUs = scheduler.next() - now;
+  if (waitUs > T_RADIO_WAIT_MAX * 1000LL) waitUs = T_RADIO_WAIT_MAX * 1000LL;
+  if (!netTask && (waitUs > NET_TASK_WAIT_MS * 1000LL)) waitUs = NET_TASK_WAIT_MS * 1000LL;
+  if (waitUs > 0) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((waitUs + 999) / 1000));
+    g_radioIdleUs += (uint32_t)(esp_timer_get_time() - now);
+  }
+  g_radioWakeups++;
 }
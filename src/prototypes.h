@@ -8,33 +8,81 @@
 /************************************************************
  * Prototypes 
  ************************************************************/ 
+boolean acquire(void);
+uint32_t backoffDelay(uint8_t);
+void   batchAdd(uint8_t);
+void   batchFlush(byte);
+void   batchPoll(void);
+int64_t batchDeadline(void);
+void   armHopTimer(void);
 String composeClientID(void);
-void   cronjob(void);
-void   dbgout(String);
+void   dbgout(const char *);
+void   executeCommand(const CommandCall&);
+boolean cmdSetFieldValue(const CommandArg*, CommandReply&, const char*, int32_t*);
+int64_t epochMs(void);
+void   forwardQueued(void);
+int64_t hopDeadline(void);
+boolean hopMissedPacket(void);
+void   hopPoll(void);
 void   loop(void);
 String macToStr(const uint8_t*);
 void   monitorConnections(void);
+void   networkLoop(TickType_t);
+void   networkTask(void*);
+TickType_t networkWait(void);
+void   processCommands(void);
 void   mqttCallback(char*, byte* , unsigned int);
-void   mqttPub(String, String, boolean);
+void   mqttClose(void);
+boolean mqttSendConnect(void);
+void   mqttConnected(void);
+void   mqttFailed(const char*);
+void   mqttPubJson(byte, boolean);
+void   countFailed(byte);
+void   collectFailed(void);
+void   saveSettings(void);
+boolean mqttDeliver(byte, const char*, size_t);
+boolean mqttPublish(byte, const char*, size_t, boolean);
+boolean mqttSend(byte, const char*, size_t);
+void   onHopTimer(void);
 void   oncePerMinute(void);
+void   onWiFiEvent(WiFiEvent_t);
 void   oncePerSecond(void);
 void   oncePerTenSeconds(void);
 void   oncePerThirtySeconds(void);
 void   resetHandler(void);
 void   sendCPUState(boolean);
 void   sendNetworkState(boolean);
+void   sendRfmState(boolean);
+void   selectRegion(byte);
 void   sendSketchState(boolean);
+void   setNetState(byte, uint32_t);
 void   setup(void);
-void   setupCommandParser(void);
 void   setupGlobalVars(void);
 void   setupGPIO(void);
+void   setupHopTimer(void);
 void   setupIRQ(void);
 void   setupMQTT(void);
 void   setupOTA(void);
+void   setupQueue(void);
 void   setupWIFI(void);
+void   wakeRadioTask(void);
+void   wakeRadioTaskFromISR(void);
+void   startAcquisition(void);
 void   setupRadio(void);
+void   setupScheduler(void);
+void   setupTasks(void);
 void   pollRadio(void);
-void   parseIssData(void);
+void   parseIssData(uint8_t id);
 void   sendHelp(void);
-void   sendIssData(uint8_t msgID);
+void   sendIssData(uint8_t id, uint8_t msgID);
+void   sendIssCbor(uint8_t id, uint8_t msgID);
+void   publishFields(uint8_t id);
+void   publishField(uint8_t id, byte f, boolean force);
+void   fieldsPoll(void);
+int32_t fieldValue(uint8_t id, byte f);
+void   sdtAdd(uint8_t id);
+void   sdtFlush(void);
+void   sdtConfigure(void);
+void   sdtPublish(uint8_t id, byte f, int64_t t, int32_t v);
+byte   receiverStatus(uint8_t id);
 #endif
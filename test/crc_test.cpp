@@ -0,0 +1,137 @@
+// crc_test: host test of lib/DavisCRC
+//
+// - crc16Table, crc16Slice4, crc16 (DAVIS_CRC_ENGINE) and checkBatch
+//   against the bit loop DavisRFM69::compute_crc16() used before
+// - exhaustive for all buffers up to 2 bytes, random buffers up to 
+//   64 bytes and random packets (fixed seed, reproducible)
+// - every single bit error of random packets is corrected
+
+#include <DavisCRC.h>
+#include <stdio.h>
+#include <string.h>
+
+#define RANDOM_BUFFERS  2000000 // random buffers checked
+#define RANDOM_MAX_LEN       64 // longest random buffer [bytes]
+#define BATCH_PACKETS     10000 // packets checked by checkBatch()
+
+static uint32_t failures = 0;
+
+/************************************************************
+ * Reference: DavisRFM69::compute_crc16() as it was, including
+ * the cast to char (signed on some targets)
+ ************************************************************/
+template <typename CHAR>
+static uint16_t compute_crc16(const uint8_t *buf, uint8_t len) {
+  unsigned int crc = 0;
+  while (len--) {
+    int i;
+    crc ^= *(const CHAR *)buf++ << 8;
+    for (i = 0; i < 8; ++i) {
+      if (crc & 0x8000)
+        crc = (crc << 1) ^ 0x1021;
+      else
+        crc = crc << 1;
+    }
+  }
+  return crc;
+}
+
+/************************************************************
+ * xorshift32, fixed seed
+ ************************************************************/
+static uint32_t rnd(void) {
+  static uint32_t x = 2463534242u;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+/************************************************************
+ * Compare all engines on one buffer
+ ************************************************************/
+static void compare(const uint8_t *buf, size_t len) {
+  uint16_t ref = compute_crc16<unsigned char>(buf, (uint8_t)len);
+  uint16_t crc[5] = {
+    compute_crc16<signed char>(buf, (uint8_t)len),
+    DavisCRC::crc16Bitwise(buf, len),
+    DavisCRC::crc16Table(buf, len),
+    DavisCRC::crc16Slice4(buf, len),
+    DavisCRC::crc16(buf, len)
+  };
+  for (int i = 0; i < 5; i++) {
+    if (crc[i] != ref) {
+      if (failures++ < 10) printf("FAIL: len %zu, engine %d: %04X, expected %04X\n", len, i, crc[i], ref);
+    }
+  }
+}
+
+/************************************************************
+ * Random packet, CRC correct unless corrupted
+ ************************************************************/
+static void makePacket(uint8_t *p, bool corrupt) {
+  uint16_t crc;
+  for (int i = 0; i < DAVIS_CRC_DATA_LEN; i++) p[i] = (uint8_t)rnd();
+  crc = compute_crc16<unsigned char>(p, DAVIS_CRC_DATA_LEN);
+  p[6] = (uint8_t)(crc >> 8);
+  p[7] = (uint8_t)crc;
+  if (corrupt) p[rnd() % DAVIS_CRC_PACKET_LEN] ^= (uint8_t)(1 << (rnd() % 8));
+}
+
+int main(void) {
+  static uint8_t packets[BATCH_PACKETS][DAVIS_CRC_PACKET_LEN];
+  static bool ok[BATCH_PACKETS];
+  uint8_t buf[RANDOM_MAX_LEN] = {};
+  uint8_t p[DAVIS_CRC_PACKET_LEN];
+  uint8_t q[DAVIS_CRC_PACKET_LEN];
+  size_t len;
+  size_t good;
+  size_t expected;
+  bool exp;
+  // exhaustive: all buffers of 0, 1 and 2 bytes
+  compare(buf, 0);
+  for (uint32_t v = 0; v < 0x10000; v++) {
+    buf[0] = (uint8_t)(v >> 8);
+    buf[1] = (uint8_t)v;
+    if (v < 0x100) compare(buf + 1, 1);
+    compare(buf, 2);
+  }
+  // random buffers
+  for (uint32_t n = 0; n < RANDOM_BUFFERS; n++) {
+    len = rnd() % (RANDOM_MAX_LEN + 1);
+    for (size_t i = 0; i < len; i++) buf[i] = (uint8_t)rnd();
+    compare(buf, len);
+  }
+  // checkBatch and check against the reference, every 4th packet corrupted
+  expected = 0;
+  for (size_t n = 0; n < BATCH_PACKETS; n++) {
+    makePacket(packets[n], (n % 4) == 3);
+  }
+  good = DavisCRC::checkBatch(&packets[0][0], BATCH_PACKETS, ok);
+  for (size_t n = 0; n < BATCH_PACKETS; n++) {
+    uint16_t crc = compute_crc16<unsigned char>(packets[n], DAVIS_CRC_DATA_LEN);
+    exp = (crc == (uint16_t)((packets[n][6] << 8) | packets[n][7])) && (crc != 0);
+    if (exp) expected++;
+    if ((ok[n] != exp) || (DavisCRC::check(packets[n]) != exp)) {
+      if (failures++ < 10) printf("FAIL: checkBatch packet %zu: %d, expected %d\n", n, ok[n], exp);
+    }
+  }
+  if (good != expected) {
+    failures++;
+    printf("FAIL: checkBatch: %zu good, expected %zu\n", good, expected);
+  }
+  // single bit errors are corrected
+  for (int n = 0; n < 1000; n++) {
+    makePacket(p, false);
+    if (!DavisCRC::check(p)) continue;       // CRC 0
+    for (int pos = 0; pos < DAVIS_CRC_PACKET_BITS; pos++) {
+      memcpy(q, p, sizeof(q));
+      q[pos / 8] ^= (uint8_t)(0x80 >> (pos % 8));
+      if ((DavisCRC::correct(q, 1) != 1) || memcmp(p, q, sizeof(q))) {
+        if (failures++ < 10) printf("FAIL: bit %d not corrected\n", pos);
+      }
+    }
+  }
+  printf("crc_test: %s (%u failures)\n", failures ? "FAILED" : "OK", failures);
+  return failures ? 1 : 0;
+}
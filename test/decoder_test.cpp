@@ -0,0 +1,191 @@
+// decoder_test: host test of lib/DavisDecoder
+//
+// - every value printed with formatCenti() is compared with the
+//   text the former float formulas of parseIssData() printed by
+//   String(float), i.e. dtostrf(value, 4, 2) of the ESP32 core
+// - all byte values for wind speed and direction, all 65536
+//   combinations of bytes 3 and 4 for every message ID
+// - wind direction, rain clicks and the battery bit as integers
+
+#include <DavisDecoder.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t checked = 0;
+static uint32_t failures = 0;
+
+/************************************************************
+ * dtostrf() of the ESP32 Arduino core (stdlib_noniso.c), as
+ * called by String(float, 2): width 4, 2 decimals
+ ************************************************************/
+static char *dtostrf(double number, signed int width, unsigned int prec, char *s) {
+  bool negative = false;
+  if (isnan(number)) {
+    strcpy(s, "nan");
+    return s;
+  }
+  if (isinf(number)) {
+    strcpy(s, "inf");
+    return s;
+  }
+  char *out = s;
+  int fillme = width;
+  if (prec > 0) fillme -= (prec + 1);
+  if (number < 0.0) {
+    negative = true;
+    fillme--;
+    number = -number;
+  }
+  double rounding = 2.0;
+  for (uint8_t i = 0; i < prec; ++i) rounding *= 10.0;
+  rounding = 1.0 / rounding;
+  number += rounding;
+  double tenpow = 1.0;
+  int digitcount = 1;
+  while (number >= 10.0 * tenpow) {
+    tenpow *= 10.0;
+    digitcount++;
+  }
+  number /= tenpow;
+  fillme -= digitcount;
+  while (fillme-- > 0) *out++ = ' ';
+  if (negative) *out++ = '-';
+  digitcount += prec;
+  int8_t digit = 0;
+  while (digitcount-- > 0) {
+    digit = (int8_t)number;
+    if (digit > 9) digit = 9;
+    *out++ = (char)('0' | digit);
+    if ((digitcount == (int)prec) && (prec > 0)) *out++ = '.';
+    number -= digit;
+    number *= 10.0;
+  }
+  *out = 0;
+  return s;
+}
+
+/************************************************************
+ * Compare fixed point value with the former float value
+ ************************************************************/
+static void compare(const char *what, const uint8_t *data, float ref, int32_t value) {
+  char expect[32];
+  char got[DAVIS_CENTI_STR_LEN];
+  dtostrf(ref, 4, 2, expect);
+  DavisDecoder::formatCenti(value, got);
+  checked++;
+  if (strcmp(expect, got) != 0) {
+    if (failures++ < 20) {
+      printf("FAIL %s %02x %02x %02x %02x %02x: float \"%s\", fixed \"%s\"\n",
+             what, data[0], data[1], data[2], data[3], data[4], expect, got);
+    }
+  }
+}
+
+/************************************************************
+ * Compare integer value
+ ************************************************************/
+static void compareInt(const char *what, const uint8_t *data, int32_t ref, int32_t value) {
+  checked++;
+  if (ref != value) {
+    if (failures++ < 20) {
+      printf("FAIL %s %02x %02x %02x %02x %02x: float path %d, fixed %d\n",
+             what, data[0], data[1], data[2], data[3], data[4], ref, value);
+    }
+  }
+}
+
+/************************************************************
+ * Bytes 0 - 2: battery bit, wind speed and direction, as
+ * parseIssData() did before
+ ************************************************************/
+static void checkCommon(void) {
+  uint8_t data[8] = {};
+  DavisMeasurement m;
+  uint16_t dir;
+  for (int b = 0; b < 256; b++) {
+    data[0] = (uint8_t)b;
+    data[1] = (uint8_t)b;
+    data[2] = (uint8_t)b;
+    DavisDecoder::decode(data, m);
+    compareInt("battery", data, (data[0] & 0x8) != 0, m.batteryLow);
+    compareInt("txId", data, data[0] & 0x07, m.txId);
+    compareInt("msgId", data, data[0] >> 4, m.msgId);
+    compare("windSpeed", data, (float)data[1] * 1.60934, m.windSpeed);
+    dir = (uint16_t)(data[2] * 360.0f / 255.0f);
+    if (dir >= 180) {
+      dir -= 180;
+    } else {
+      dir += 180;
+    }
+    compareInt("windDirection", data, dir, m.windDirection);
+  }
+}
+
+/************************************************************
+ * Bytes 3 and 4 of one message ID, as parseIssData() did before
+ ************************************************************/
+static void checkField(uint8_t msgId) {
+  uint8_t data[8] = {};
+  DavisMeasurement m;
+  uint16_t rawrr;
+  float cph;
+  float ref;
+  data[0] = (uint8_t)(msgId << 4);
+  for (int v = 0; v < 65536; v++) {
+    data[3] = (uint8_t)(v >> 8);
+    data[4] = (uint8_t)v;
+    DavisDecoder::decode(data, m);
+    switch (msgId) {
+      case DAVIS_MSG_GOLDCAP:
+        ref = (float)((data[3] << 2) + ((data[4] & 0xC0) >> 6)) / 100;
+        compare("goldcap", data, ref, m.value);
+        break;
+      case DAVIS_MSG_RAINRATE:
+        if (data[3] == 255) {
+          ref = 0;
+        } else {
+          rawrr = data[3] + ((data[4] & 0x30) * 16);
+          if ((data[4] & 0x40) == 0) {
+            cph = 57600 / (float)(rawrr);
+          } else {
+            cph = 3600 / (float)(rawrr);
+          }
+          ref = cph * 0.2;
+        }
+        compare("rainRate", data, ref, m.value);
+        break;
+      case DAVIS_MSG_SOLAR:
+        ref = (float)((data[3] * 4) + ((data[4] & 0xC0) >> 6));
+        compare("solar", data, ref, m.value);
+        break;
+      case DAVIS_MSG_TEMPERATURE:
+        ref = (float)(((data[3] * 256 + data[4]) / 160) - 32) * 5 / 9;
+        compare("temperature", data, ref, m.value);
+        break;
+      case DAVIS_MSG_GUST:
+        ref = (float)data[3] * 1.60934;
+        compare("gust", data, ref, m.value);
+        break;
+      case DAVIS_MSG_HUMIDITY:
+        ref = (float)((uint16_t)(((data[4] >> 4) << 8) | data[3])) / 10.0;  // word(data[4] >> 4, data[3])
+        compare("humidity", data, ref, m.value);
+        break;
+      case DAVIS_MSG_RAINCLICKS:
+        compareInt("rainClicks", data, data[3] & 0x7F, m.value);
+        break;
+      default:
+        compareInt("field", data, DAVIS_FIELD_NONE, m.field);
+        break;
+    }
+  }
+}
+
+int main(void) {
+  checkCommon();
+  for (uint8_t id = 0; id < DAVIS_MSG_NUM; id++) {
+    checkField(id);
+  }
+  printf("decoder_test: %s (%u values, %u failures)\n", failures ? "FAILED" : "OK", checked, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+// mqtt_session_test: host test of lib/MqttSession (Client stub)
+//
+// - SUBSCRIBE and PUBLISH packets as written to the connection
+// - incoming PUBLISH split over several loop() calls, one byte
+//   available at a time; QoS 1 acknowledged; packets longer than
+//   the buffer skipped, the next one received
+// - keep alive: PINGREQ after keepAlive without traffic, timeout
+//   if nothing is received another keepAlive later
+// - connection closed or write failed: session lost
+// - the handshake (CONNECT, CONNACK) is done by MqttTransport on
+//   the socket and is not covered here
+
+#include <MqttSession.h>
+#include <stdio.h>
+#include <string>
+
+#define KEEPALIVE  15 // [s]
+#define BUFSIZE    64 // receive buffer [bytes]
+
+static uint32_t failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      if (failures++ < 20) printf("FAIL line %d: %s\n", __LINE__, #cond); \
+    } \
+  } while (0)
+
+/************************************************************
+ * Connection: bytes written kept in tx, bytes to be read in
+ * rx, of which rxAvail are available
+ ************************************************************/
+class StubClient : public Client {
+  public:
+    std::string tx;
+    std::string rx;
+    size_t  rxAvail = 0;
+    bool    open = true;
+    bool    failWrite = false;
+    size_t  write(uint8_t b) { return write(&b, 1); }
+    size_t  write(const uint8_t *buf, size_t size) {
+      if (!open || failWrite) return 0;
+      tx.append((const char *)buf, size);
+      return size;
+    }
+    int     available(void) { return (int)rxAvail; }
+    int     read(void) {
+      uint8_t b;
+      return (read(&b, 1) == 1) ? b : -1;
+    }
+    int     read(uint8_t *buf, size_t size) {
+      if (size > rxAvail) size = rxAvail;
+      if (size == 0) return -1;
+      memcpy(buf, rx.data(), size);
+      rx.erase(0, size);
+      rxAvail -= size;
+      return (int)size;
+    }
+    int     peek(void) { return rxAvail ? (uint8_t)rx[0] : -1; }
+    void    flush(void) {}
+    void    stop(void) { open = false; }
+    uint8_t connected(void) { return open; }
+    void    receive(const std::string &bytes) { rx += bytes; }   // arrives, not available yet
+    void    receiveNow(const std::string &bytes) { rx += bytes; rxAvail = rx.size(); }
+};
+
+static uint8_t buf[BUFSIZE];
+static std::string gotTopic;
+static std::string gotPayload;
+static uint32_t calls = 0;
+
+static void callback(char *topic, uint8_t *payload, unsigned int length) {
+  gotTopic = topic;
+  gotPayload.assign((const char *)payload, length);
+  calls++;
+}
+
+/************************************************************
+ * PUBLISH packet as sent by the broker
+ ************************************************************/
+static std::string publishPacket(const std::string &topic, const std::string &payload, uint8_t qos, uint16_t msgId) {
+  std::string p;
+  size_t rem = 2 + topic.size() + (qos ? 2 : 0) + payload.size();
+  p += (char)(0x30 | (qos << 1));
+  do {
+    p += (char)((rem & 0x7f) | ((rem > 0x7f) ? 0x80 : 0));
+    rem >>= 7;
+  } while (rem);
+  p += (char)(topic.size() >> 8);
+  p += (char)topic.size();
+  p += topic;
+  if (qos) {
+    p += (char)(msgId >> 8);
+    p += (char)msgId;
+  }
+  return p + payload;
+}
+
+int main(void) {
+  StubClient client;
+  MqttSession mqtt(client, buf, sizeof(buf));
+  std::string payload(200, 'x');
+  uint32_t since;
+  mqtt.setCallback(callback);
+  CHECK(!mqtt.connected());
+  CHECK(!mqtt.beginPublish("a/b", 1, false));
+  CHECK(client.tx.empty());
+  mqtt.begin(KEEPALIVE);
+  CHECK(mqtt.connected());
+  CHECK(mqtt.state() == MQTT_SESSION_CONNECTED);
+  // *************************
+  // * SUBSCRIBE, QoS 0, message IDs from 1
+  CHECK(mqtt.subscribe("gw/cmd"));
+  CHECK(client.tx == std::string("\x82\x0b\x00\x01\x00\x06gw/cmd\x00", 13));
+  client.tx.clear();
+  // * PUBLISH, retained, remaining length in 2 bytes
+  CHECK(mqtt.beginPublish("gw/status", payload.size(), true));
+  CHECK(mqtt.write((const uint8_t *)payload.data(), payload.size()) == payload.size());
+  CHECK(mqtt.endPublish());
+  CHECK(client.tx == std::string("\x31\xd3\x01\x00\x09gw/status", 14) + payload);
+  client.tx.clear();
+  // *************************
+  // * incoming PUBLISH, one byte available per loop()
+  client.receive(publishPacket("gw/cmd", "period 5", 0, 0));
+  while (client.rxAvail < client.rx.size()) {
+    CHECK(calls == 0);
+    client.rxAvail++;
+    CHECK(mqtt.loop());
+  }
+  CHECK(calls == 1);
+  CHECK(gotTopic == "gw/cmd");
+  CHECK(gotPayload == "period 5");
+  // * QoS 1: acknowledged
+  client.receiveNow(publishPacket("gw/cmd", "allrx", 1, 0x1234));
+  CHECK(mqtt.loop());
+  CHECK(calls == 2);
+  CHECK(gotPayload == "allrx");
+  CHECK(client.tx == std::string("\x40\x02\x12\x34", 4));
+  client.tx.clear();
+  // * longer than the buffer: skipped, the next one received;
+  //   SUBACK ignored
+  client.receiveNow(publishPacket("gw/cmd", payload, 0, 0));
+  client.receiveNow(std::string("\x90\x03\x00\x01\x00", 5));
+  client.receiveNow(publishPacket("gw/cmd", "reset", 0, 0));
+  CHECK(mqtt.loop());
+  CHECK(calls == 3);
+  CHECK(gotPayload == "reset");
+  CHECK(mqtt.dropped() == 1);
+  CHECK(client.tx.empty());
+  // * PINGREQ of the broker answered
+  client.receiveNow(std::string("\xc0\x00", 2));
+  CHECK(mqtt.loop());
+  CHECK(client.tx == std::string("\xd0\x00", 2));
+  client.tx.clear();
+  // *************************
+  // * keep alive: PINGREQ, answered
+  stubMillis += KEEPALIVE * 1000;
+  CHECK(mqtt.loop());
+  CHECK(client.tx.empty());
+  stubMillis += 1;
+  CHECK(mqtt.loop());
+  CHECK(client.tx == std::string("\xc0\x00", 2));
+  client.tx.clear();
+  client.receiveNow(std::string("\xd0\x00", 2));
+  CHECK(mqtt.loop());
+  since = stubMillis;
+  // * publishing does not keep the session alive without answers
+  for (uint32_t i = 0; (i < 3 * KEEPALIVE) && mqtt.connected(); i++) {
+    stubMillis += 1000;
+    CHECK(mqtt.beginPublish("gw/cpu", 1, false));
+    CHECK(mqtt.write((const uint8_t *)"1", 1) == 1);
+    CHECK(mqtt.endPublish());
+    mqtt.loop();
+  }
+  CHECK(client.tx.find(std::string("\xc0\x00", 2)) != std::string::npos);
+  CHECK(stubMillis - since > 2 * KEEPALIVE * 1000);                // PINGREQ after keepAlive, timeout after another
+  CHECK(stubMillis - since <= 2 * KEEPALIVE * 1000 + 2000);        // 1 s steps, both exceeded by 1 s
+  CHECK(!mqtt.connected());
+  CHECK(mqtt.state() == MQTT_SESSION_TIMEOUT);
+  CHECK(!client.open);
+  // *************************
+  // * connection closed
+  client.open = true;
+  client.tx.clear();
+  mqtt.begin(KEEPALIVE);
+  CHECK(mqtt.connected());
+  client.open = false;
+  CHECK(!mqtt.loop());
+  CHECK(mqtt.state() == MQTT_SESSION_LOST);
+  // * write failed
+  client.open = true;
+  mqtt.begin(KEEPALIVE);
+  CHECK(mqtt.beginPublish("gw/cpu", 2, false));
+  client.failWrite = true;
+  CHECK(mqtt.write((const uint8_t *)"12", 2) == 0);
+  CHECK(!mqtt.endPublish());
+  // * ended by the owner
+  mqtt.end();
+  CHECK(!mqtt.connected());
+  CHECK(mqtt.state() == MQTT_SESSION_DISCONNECTED);
+  printf("mqtt_session_test: %s (%u failures)\n", failures ? "FAILED" : "OK", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+// outbound_test: host test of lib/OutboundQueue (LittleFS stub)
+//
+// - records are forwarded in the order they were pushed, RAM first
+// - the flash log is synced after OUTBOUND_SYNC_RECORDS pushes or
+//   pops or by poll() after OUTBOUND_SYNC_MS, not for each record
+// - after a reset (powerLoss() of the stub) the records synced
+//   are found again: none lost, those removed since the last sync
+//   forwarded again
+
+#include <OutboundQueue.h>
+#include <stdio.h>
+
+static uint32_t failures = 0;
+static uint32_t nextRecord = 0;     // number of the next record pushed
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      if (failures++ < 20) printf("FAIL line %d: %s\n", __LINE__, #cond); \
+    } \
+  } while (0)
+
+/************************************************************
+ * Push record with the next number (uptimeMs and payload)
+ ************************************************************/
+static bool push(OutboundQueue &q) {
+  OutboundRecord rec = {};
+  char payload[32];
+  rec.len = (uint16_t)snprintf(payload, sizeof(payload), "record %u", nextRecord);
+  rec.topic = (uint8_t)(nextRecord % 8);
+  rec.uptimeMs = nextRecord;
+  nextRecord++;
+  return q.push(rec, payload);
+}
+
+/************************************************************
+ * Peek and pop the oldest record, check its number
+ * @return number of the record, -1 if none
+ ************************************************************/
+static int64_t pop(OutboundQueue &q) {
+  OutboundRecord rec;
+  char payload[OUTBOUND_PAYLOAD_MAX];
+  char expect[32];
+  if (!q.peek(rec, payload, sizeof(payload))) return -1;
+  snprintf(expect, sizeof(expect), "record %u", (uint32_t)rec.uptimeMs);
+  CHECK((rec.len == strlen(expect)) && (memcmp(payload, expect, rec.len) == 0));
+  CHECK(rec.topic == rec.uptimeMs % 8);
+  q.pop();
+  return rec.uptimeMs;
+}
+
+/************************************************************
+ * Reboot: new queue on the flash content
+ ************************************************************/
+static OutboundQueue *reboot(OutboundQueue *q) {
+  delete q;
+  LittleFS.powerLoss();
+  q = new OutboundQueue();
+  CHECK(q->begin());
+  CHECK(q->ramCount() == 0);
+  return q;
+}
+
+int main(void) {
+  OutboundQueue *q = new OutboundQueue();
+  uint32_t flushes;
+  uint32_t first;
+  int64_t n;
+  CHECK(q->begin());
+  // *************************
+  // * order, RAM first, flushes per record
+  flushes = LittleFS.flushes;
+  for (uint32_t i = 0; i < OUTBOUND_RAM_SLOTS + 200; i++) {
+    CHECK(push(*q));
+    q->poll();
+  }
+  CHECK(q->ramCount() == OUTBOUND_RAM_SLOTS);
+  CHECK(q->flashCount() == 200);
+  CHECK(LittleFS.flushes - flushes <= 200 / OUTBOUND_SYNC_RECORDS);
+  flushes = LittleFS.flushes;
+  for (uint32_t i = 0; i < OUTBOUND_RAM_SLOTS + 200; i++) {
+    CHECK(pop(*q) == i);
+    q->poll();
+  }
+  CHECK(pop(*q) == -1);
+  CHECK(LittleFS.flushes - flushes <= 200 / OUTBOUND_SYNC_RECORDS + 1);  // pushes not synced yet included
+  // *************************
+  // * poll(): sync after OUTBOUND_SYNC_MS
+  stubMillis += OUTBOUND_SYNC_MS;
+  CHECK(q->sync());
+  flushes = LittleFS.flushes;
+  q->poll();
+  CHECK(LittleFS.flushes == flushes);  // nothing changed
+  for (uint32_t i = 0; i < OUTBOUND_RAM_SLOTS + 1; i++) CHECK(push(*q));
+  stubMillis += OUTBOUND_SYNC_MS - 1;
+  q->poll();
+  CHECK(LittleFS.flushes == flushes);
+  stubMillis += 1;
+  q->poll();
+  CHECK(LittleFS.flushes == flushes + 1);
+  // *************************
+  // * reset: synced records kept, the ones pushed since lost
+  first = nextRecord - 1;           // the flash record
+  for (uint32_t i = 0; i < 40; i++) CHECK(push(*q));
+  stubMillis += OUTBOUND_SYNC_MS;
+  q->poll();
+  for (uint32_t i = 0; i < 5; i++) CHECK(push(*q));
+  q = reboot(q);
+  CHECK(q->flashCount() == 41);
+  // * records removed since the last sync are forwarded again
+  for (uint32_t i = 0; i < 10; i++) CHECK(pop(*q) == first + i);
+  q = reboot(q);
+  CHECK(q->flashCount() == 41);
+  // * removed and synced (OUTBOUND_SYNC_RECORDS pops): gone
+  for (uint32_t i = 0; i < OUTBOUND_SYNC_RECORDS; i++) CHECK(pop(*q) == first + i);
+  q = reboot(q);
+  CHECK(q->flashCount() == 41 - OUTBOUND_SYNC_RECORDS);
+  for (uint32_t i = OUTBOUND_SYNC_RECORDS; i < 41; i++) CHECK(pop(*q) == first + i);
+  CHECK(pop(*q) == -1);
+  n = q->stats().dropped;
+  CHECK(n == 0);
+  delete q;
+  printf("outbound_test: %s (%u failures)\n", failures ? "FAILED" : "OK", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+// publish_alloc_test: no heap allocation on the publish path
+//
+// - malloc(), calloc(), realloc() and free() are replaced by
+//   wrappers counting the calls while a packet is processed
+// - per packet, the library calls of the firmware: CRC check
+//   (DavisCRC), decoding and printing the values (DavisDecoder),
+//   ISS message as JSON (sendIssData()) and CBOR (sendIssCbor()),
+//   Field Topic, Swinging Door and command reply
+// - rendered into static buffers of the firmware sizes, as in
+//   main.cpp; nothing is printed while counting
+// - packets have a valid CRC or a single bit error, so each one
+//   is rendered (except CRC 0, rejected by DavisCRC::check() as
+//   in the firmware); the test fails if one is not
+// - glibc only (__libc_malloc() and friends)
+
+#include <CborWriter.h>
+#include <CommandTable.h>
+#include <DavisCRC.h>
+#include <DavisDecoder.h>
+#include <IssCbor.h>
+#include <JsonWriter.h>
+#include <SwingingDoor.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACKETS         100000 // random packets processed
+#define JSON_BUFSIZE      3072 // as main.cpp
+#define CBOR_BUFSIZE       256 // as main.cpp
+#define CMD_REPLY_SIZE      64 // as main.cpp
+#define DAVIS_PACKET_LEN     DAVIS_CRC_PACKET_LEN
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+extern "C" void  __libc_free(void *p);
+
+static volatile bool counting = false;
+static volatile uint32_t allocs = 0;
+
+extern "C" void *malloc(size_t size) {
+  if (counting) allocs++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+  if (counting) allocs++;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) {
+  if (counting) allocs++;
+  return __libc_realloc(p, size);
+}
+
+extern "C" void free(void *p) {
+  if (counting && p) allocs++;
+  __libc_free(p);
+}
+
+static char jsonBuf[JSON_BUFSIZE];
+static JsonWriter json(jsonBuf, sizeof(jsonBuf));
+static uint8_t cborBuf[CBOR_BUFSIZE];
+static CborWriter cbor(cborBuf, sizeof(cborBuf));
+static char cmdReplyBuf[CMD_REPLY_SIZE];
+static CommandReply cmdReply(cmdReplyBuf, sizeof(cmdReplyBuf));
+static SwingingDoor sdt;
+static volatile size_t sink = 0;       // keeps the results alive
+static uint32_t rendered = 0;          // packets which reached the render step
+static uint32_t expected = 0;          // packets which must reach it (CRC not 0)
+
+/************************************************************
+ * xorshift32, fixed seed
+ ************************************************************/
+static uint32_t rnd(void) {
+  static uint32_t x = 2463534242u;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+/************************************************************
+ * Random packet: bytes 0 - 5 random, CRC of them in bytes 6, 7
+ * (big endian), as makePacket() of crc_test
+ * - counts the packets to be rendered (expected)
+ * @param[in] corrupt flip one random bit
+ ************************************************************/
+static void makePacket(uint8_t *packet, bool corrupt) {
+  uint16_t crc;
+  for (int i = 0; i < DAVIS_CRC_DATA_LEN; i++) packet[i] = (uint8_t)rnd();
+  crc = DavisCRC::crc16(packet, DAVIS_CRC_DATA_LEN);
+  packet[6] = (uint8_t)(crc >> 8);
+  packet[7] = (uint8_t)crc;
+  if (crc != 0) expected++;
+  if (corrupt) packet[rnd() % DAVIS_CRC_PACKET_LEN] ^= (uint8_t)(1 << (rnd() % 8));
+}
+
+/************************************************************
+ * One packet as processed by pollRadio(), parseIssData(),
+ * sendIssData(), sendIssCbor(), publishFields(), sdtAdd() and
+ * executeCommand()
+ ************************************************************/
+static void publish(uint8_t *packet, int64_t t) {
+  DavisMeasurement m;
+  SdtPoint out[SDT_OUT_MAX];
+  char num[DAVIS_CENTI_STR_LEN];
+  uint8_t n;
+  if (!DavisCRC::check(packet) && (DavisCRC::correct(packet) < 0)) return;
+  rendered++;
+  DavisDecoder::decode(packet, m);
+  sink += DavisDecoder::formatCenti(m.windSpeed, num);
+  sink += DavisDecoder::formatCenti(m.value, num);
+  // ISS message, JSON
+  json.reset();
+  json.beginObject();
+  json.addFixed("WindSpeed", m.windSpeed, 2);
+  json.addUInt("WindDirection", m.windDirection);
+  json.addUInt("BattWarning", m.batteryLow ? 1 : 0);
+  json.addHex("Payload", packet, DAVIS_PACKET_LEN, ':');
+  json.addInt("RSSI", -(int32_t)(rnd() & 0x7f));
+  json.addInt64("RxTime", t);
+  json.addUInt("msgID", m.msgId);
+  if (m.field == DAVIS_FIELD_RAINRATE && m.value == DAVIS_RAINRATE_INF) {
+    json.addNull("Rainrate");
+  } else if (DavisDecoder::fieldName(m.field)) {
+    json.addFixed(DavisDecoder::fieldName(m.field), m.value, 2);
+  }
+  json.addString("Receiver Status", "OK");
+  json.endObject();
+  sink += json.length();
+  // ISS message, CBOR
+  cbor.reset();
+  cbor.beginMap();
+  cbor.addUInt(ISS_KEY_VERSION, ISS_CBOR_VERSION);
+  cbor.addFixed(ISS_KEY_WINDSPEED, m.windSpeed, 2);
+  cbor.addUInt(ISS_KEY_WINDDIRECTION, m.windDirection);
+  cbor.addUInt(ISS_KEY_BATTWARNING, m.batteryLow ? 1 : 0);
+  cbor.addBytes(ISS_KEY_PAYLOAD, packet, DAVIS_PACKET_LEN);
+  cbor.addInt(ISS_KEY_RXTIME, t);
+  cbor.addUInt(ISS_KEY_MSGID, m.msgId);
+  if (m.field == DAVIS_FIELD_RAINRATE && m.value == DAVIS_RAINRATE_INF) {
+    cbor.addNull(ISS_KEY_RAINRATE);
+  } else {
+    cbor.addFixed(ISS_KEY_TEMPERATURE, m.value, 2);
+  }
+  cbor.endMap();
+  sink += cbor.length();
+  // Field Topic and Swinging Door
+  sink += JsonWriter::formatFixed(m.value, 2, num);
+  n = sdt.add(t, m.value, out);
+  sink += n;
+  // Command reply
+  cmdReply.reset();
+  cmdReply.add("OK: period ");
+  cmdReply.addUInt(m.windSpeed);
+  sink += cmdReply.length();
+}
+
+int main(void) {
+  uint8_t packet[DAVIS_PACKET_LEN];
+  uint32_t fails = 0;
+  void *volatile p;
+  // the wrappers are in place
+  allocs = 0;
+  counting = true;
+  p = malloc(16);
+  free(p);
+  counting = false;
+  if (allocs != 2) {
+    printf("publish_alloc_test: FAILED (malloc() not replaced)\n");
+    return 1;
+  }
+  sdt.configure(50, 60000000);
+  for (uint32_t i = 0; i < PACKETS; i++) {
+    makePacket(packet, rnd() & 1);
+    allocs = 0;
+    counting = true;
+    publish(packet, (int64_t)i * 2562500);
+    counting = false;
+    if (allocs) {
+      if (fails++ < 10) printf("FAIL packet %u: %u allocations\n", i, allocs);
+    }
+  }
+  // every packet has been rendered (single bit errors are corrected)
+  if ((rendered != expected) || (expected < PACKETS - PACKETS / 1000)) {
+    printf("FAIL %u of %u packets rendered\n", rendered, expected);
+    fails++;
+  }
+  printf("publish_alloc_test: %s (%u packets rendered, %u failures)\n", fails ? "FAILED" : "OK", rendered, fails);
+  return fails ? 1 : 0;
+}
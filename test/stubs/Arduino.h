@@ -0,0 +1,17 @@
+// Host stub of the Arduino core for the library tests
+//
+// - only what the tested libraries use
+// - millis() is the time set by the test (stubMillis)
+
+#ifndef ARDUINO_STUB_h
+#define ARDUINO_STUB_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+inline uint32_t stubMillis = 0;     // [ms] returned by millis()
+
+inline uint32_t millis(void) { return stubMillis; }
+
+#endif  // ARDUINO_STUB_h
@@ -0,0 +1,25 @@
+// Host stub of the Arduino Client interface for the library tests
+//
+// - the calls used by the tested libraries, no connect() and no
+//   Print
+
+#ifndef CLIENT_STUB_h
+#define CLIENT_STUB_h
+
+#include <Arduino.h>
+
+class Client {
+  public:
+    virtual ~Client() {}
+    virtual size_t  write(uint8_t b) = 0;
+    virtual size_t  write(const uint8_t *buf, size_t size) = 0;
+    virtual int     available(void) = 0;
+    virtual int     read(void) = 0;
+    virtual int     read(uint8_t *buf, size_t size) = 0;
+    virtual int     peek(void) = 0;
+    virtual void    flush(void) = 0;
+    virtual void    stop(void) = 0;
+    virtual uint8_t connected(void) = 0;
+};
+
+#endif  // CLIENT_STUB_h
@@ -0,0 +1,84 @@
+// Host stub of LittleFS for the library tests
+//
+// - one file system in RAM, each file has its content as seen by
+//   the open file and its content on flash
+// - File::flush() and close() commit the content to flash (as
+//   LittleFS does on sync), powerLoss() drops everything written
+//   since, as a reset would
+// - flushes are counted (flushes)
+
+#ifndef LITTLEFS_STUB_h
+#define LITTLEFS_STUB_h
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+struct StubFileData {
+  std::string content;              // as seen by the open file
+  std::string flash;                // committed by the last flush
+};
+
+class File {
+  public:
+    File(void) {}
+    File(StubFileData *data, uint32_t *flushes) : _data(data), _flushes(flushes) {}
+    explicit operator bool(void) const { return _data != NULL; }
+    bool   seek(uint32_t pos) {            // beyond the end: extended by write()
+      if (!_data) return false;
+      _pos = pos;
+      return true;
+    }
+    size_t read(uint8_t *buf, size_t size) {
+      if (!_data || (_pos >= _data->content.size())) return 0;
+      if (size > _data->content.size() - _pos) size = _data->content.size() - _pos;
+      memcpy(buf, _data->content.data() + _pos, size);
+      _pos += size;
+      return size;
+    }
+    size_t write(const uint8_t *buf, size_t size) {
+      if (!_data) return 0;
+      if (_pos + size > _data->content.size()) _data->content.resize(_pos + size);
+      memcpy(&_data->content[_pos], buf, size);
+      _pos += size;
+      return size;
+    }
+    void   flush(void) {
+      if (!_data) return;
+      _data->flash = _data->content;
+      (*_flushes)++;
+    }
+    void   close(void) {
+      flush();
+      _data = NULL;
+    }
+
+  protected:
+    StubFileData *_data = NULL;
+    uint32_t     *_flushes = NULL;
+    size_t        _pos = 0;
+};
+
+class LittleFSStub {
+  public:
+    uint32_t flushes = 0;           // File::flush() calls
+
+    bool begin(bool formatOnFail) { (void)formatOnFail; return true; }
+    bool exists(const char *path) { return _files.count(path) > 0; }
+    File open(const char *path, const char *mode) {
+      StubFileData &data = _files[path];
+      if (mode[0] == 'w') data.content.clear();
+      return File(&data, &flushes);
+    }
+    // reset: files as committed by the last flush
+    void powerLoss(void) {
+      for (auto &f : _files) f.second.content = f.second.flash;
+    }
+
+  protected:
+    std::map<std::string, StubFileData> _files;
+};
+
+inline LittleFSStub LittleFS;
+
+#endif  // LITTLEFS_STUB_h
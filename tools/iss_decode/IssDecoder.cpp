@@ -0,0 +1,222 @@
+// Decoder for compact (CBOR) ISS messages, host side
+
+#include "IssDecoder.h"
+#include <CborWriter.h>
+#include <string.h>
+
+#define CBOR_INFO_INDEFINITE  31
+
+
+/************************************************************
+ * Decode message
+ * @param[in]  data message as published
+ * @param[in]  len  length of message
+ * @param[out] json JSON message (reset first)
+ * @return     false if the message is malformed, uses an
+ *             unsupported item or the JSON buffer is too small
+ ************************************************************/
+bool IssDecoder::decode(const uint8_t *data, size_t len, JsonWriter &json) {
+  _p = data;
+  _end = data + len;
+  _error = NULL;
+  json.reset();
+  if (!item(json, NULL, ISS_FIELD_PLAIN, 0)) return false;
+  if (_p != _end) return fail("trailing bytes");
+  if (json.overflow()) return fail("JSON buffer too small");
+  return true;
+}
+
+
+/************************************************************
+ * Record reason of failure
+ * @return false
+ ************************************************************/
+bool IssDecoder::fail(const char *reason) {
+  if (!_error) _error = reason;
+  return false;
+}
+
+
+/************************************************************
+ * Read head: initial byte and argument
+ * @param[out] major major type CBOR_xx
+ * @param[out] info  additional info (CBOR_INFO_INDEFINITE)
+ * @param[out] arg   argument (value, length or tag)
+ ************************************************************/
+bool IssDecoder::readHead(uint8_t &major, uint8_t &info, uint64_t &arg) {
+  size_t n;
+  if (_p >= _end) return fail("truncated");
+  major = *_p & 0xe0;
+  info = *_p & 0x1f;
+  _p++;
+  arg = 0;
+  if (info < 24) {
+    arg = info;
+    return true;
+  }
+  if (info == CBOR_INFO_INDEFINITE) {
+    if ((major == CBOR_UINT) || (major == CBOR_NEGINT) || (major == CBOR_TAG)) return fail("malformed head");
+    return true;
+  }
+  if (info > 27) return fail("reserved additional info");
+  n = (size_t)1 << (info - 24);
+  if ((size_t)(_end - _p) < n) return fail("truncated");
+  while (n--) arg = (arg << 8) | *_p++;
+  return true;
+}
+
+
+/************************************************************
+ * Read integer with sign
+ ************************************************************/
+bool IssDecoder::readInt(int64_t &value) {
+  uint8_t major, info;
+  uint64_t arg;
+  if (!readHead(major, info, arg)) return false;
+  if (((major != CBOR_UINT) && (major != CBOR_NEGINT)) || (arg > INT64_MAX)) {
+    return fail("integer expected");
+  }
+  value = (major == CBOR_UINT) ? (int64_t)arg : -1 - (int64_t)arg;
+  return true;
+}
+
+
+/************************************************************
+ * Read contents of a text string
+ * @param[in]  len length of string
+ * @param[out] buf at least ISS_DECODE_TEXT_MAX + 1 bytes,
+ *                 terminated
+ ************************************************************/
+bool IssDecoder::readText(uint64_t len, char *buf) {
+  if (len > ISS_DECODE_TEXT_MAX) return fail("text too long");
+  if ((uint64_t)(_end - _p) < len) return fail("truncated");
+  memcpy(buf, _p, (size_t)len);
+  buf[len] = 0;
+  _p += len;
+  return true;
+}
+
+
+/************************************************************
+ * Skip break byte, if it is next
+ * @return true if a break byte has been skipped
+ ************************************************************/
+bool IssDecoder::atBreak(void) {
+  if ((_p < _end) && (*_p == CBOR_BREAK)) {
+    _p++;
+    return true;
+  }
+  return false;
+}
+
+
+/************************************************************
+ * Decode one data item
+ * @param[out] json   JSON message
+ * @param[in]  key    member name, NULL: array element or top
+ *                    level
+ * @param[in]  format ISS_FIELD_xx of the member
+ * @param[in]  depth  nesting of maps and arrays
+ ************************************************************/
+bool IssDecoder::item(JsonWriter &json, const char *key, uint8_t format, uint8_t depth) {
+  char text[ISS_DECODE_TEXT_MAX + 1];
+  uint8_t major, info;
+  uint64_t arg, i;
+  int64_t exponent, mantissa;
+  bool indefinite;
+  if (depth >= JSON_WRITER_MAX_DEPTH) return fail("nested too deep");
+  if (!readHead(major, info, arg)) return false;
+  indefinite = (info == CBOR_INFO_INDEFINITE);
+  if (indefinite && (major != CBOR_ARRAY) && (major != CBOR_MAP)) {
+    return fail("indefinite length not supported");
+  }
+  switch (major) {
+    case CBOR_UINT:
+      if ((format == ISS_FIELD_RX_STATUS) && (arg < ISS_RX_STATUS_NUM)) {
+        json.addString(key, ISS_RECEIVER_STATUS_NAMES[arg]);
+      } else if (arg > INT64_MAX) {
+        return fail("integer too large");
+      } else {
+        json.addInt64(key, (int64_t)arg);
+      }
+      return true;
+    case CBOR_NEGINT:
+      if (arg > INT64_MAX) return fail("integer too large");
+      json.addInt64(key, -1 - (int64_t)arg);
+      return true;
+    case CBOR_BYTES:
+      if ((uint64_t)(_end - _p) < arg) return fail("truncated");
+      json.addHex(key, _p, (size_t)arg, (format == ISS_FIELD_HEX) ? ':' : 0);
+      _p += arg;
+      return true;
+    case CBOR_TEXT:
+      if (!readText(arg, text)) return false;
+      json.addString(key, text);
+      return true;
+    case CBOR_ARRAY:
+      json.beginArray(key);
+      for (i = 0; indefinite ? !atBreak() : (i < arg); i++) {
+        if (!item(json, NULL, ISS_FIELD_PLAIN, depth + 1)) return false;
+      }
+      json.endArray();
+      return true;
+    case CBOR_MAP:
+      return map(json, key, indefinite, arg, depth);
+    case CBOR_TAG:
+      if (arg != CBOR_TAG_DECIMAL) {
+        return item(json, key, format, depth);      // other tags: content only
+      }
+      if (!readHead(major, info, arg) || (major != CBOR_ARRAY) || (arg != 2) ||
+          !readInt(exponent) || !readInt(mantissa)) {
+        return fail("malformed decimal fraction");
+      }
+      if ((exponent > 0) || (exponent < -9) || (mantissa < INT32_MIN) || (mantissa > INT32_MAX)) {
+        return fail("decimal fraction out of range");
+      }
+      json.addFixed(key, (int32_t)mantissa, (uint8_t)-exponent);
+      return true;
+    default:
+      if (info == (CBOR_NULL & 0x1f)) {
+        json.addNull(key);
+        return true;
+      }
+      return fail("simple value not supported");
+  }
+}
+
+
+/************************************************************
+ * Decode map (head already read)
+ * - integer keys: names of ISS_CBOR_FIELDS, unknown keys as
+ *   their number
+ * - ISS_KEY_VERSION of the top level map is checked and not
+ *   written to the JSON message
+ ************************************************************/
+bool IssDecoder::map(JsonWriter &json, const char *key, bool indefinite, uint64_t count, uint8_t depth) {
+  char name[ISS_DECODE_TEXT_MAX + 1];
+  uint8_t major, info, format;
+  uint64_t arg, i;
+  int64_t version;
+  json.beginObject(key);
+  for (i = 0; indefinite ? !atBreak() : (i < count); i++) {
+    if (!readHead(major, info, arg)) return false;
+    format = ISS_FIELD_PLAIN;
+    if (major == CBOR_TEXT) {
+      if (!readText(arg, name)) return false;
+    } else if (major != CBOR_UINT) {
+      return fail("key must be integer or text");
+    } else if ((depth == 0) && (arg == ISS_KEY_VERSION)) {
+      if (!readInt(version)) return false;
+      if (version != ISS_CBOR_VERSION) return fail("unknown layout version");
+      continue;
+    } else if (arg < ISS_KEY_NUM) {
+      strcpy(name, ISS_CBOR_FIELDS[arg].name);
+      format = ISS_CBOR_FIELDS[arg].format;
+    } else {
+      JsonWriter::formatUInt64(arg, name);
+    }
+    if (!item(json, name, format, depth + 1)) return false;
+  }
+  json.endObject();
+  return true;
+}
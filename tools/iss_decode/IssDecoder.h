@@ -0,0 +1,38 @@
+// Decoder for compact (CBOR) ISS messages, host side
+//
+// - Turns a message published in the compact layout (see IssCbor.h)
+//   back into the JSON message the gateway publishes in JSON mode
+// - Integer keys are replaced by the member names of ISS_CBOR_FIELDS
+//   (unknown keys by their number), the version key is checked and
+//   dropped
+// - Generic enough for other CBOR messages made of maps, arrays,
+//   integers, strings, byte strings, decimal fractions and null
+
+#ifndef ISSDECODER_h
+#define ISSDECODER_h
+
+#include <JsonWriter.h>
+#include <IssCbor.h>
+
+#define ISS_DECODE_TEXT_MAX     256 // longest text string or key [bytes]
+
+class IssDecoder {
+  public:
+    bool        decode(const uint8_t *data, size_t len, JsonWriter &json); // false on error, see error()
+    const char *error(void) const { return _error; }                      // reason of the last failure
+
+  protected:
+    const uint8_t *_p = NULL;        // next byte to decode
+    const uint8_t *_end = NULL;      // end of message
+    const char    *_error = NULL;
+
+    bool fail(const char *reason);
+    bool readHead(uint8_t &major, uint8_t &info, uint64_t &arg);
+    bool readInt(int64_t &value);
+    bool readText(uint64_t len, char *buf);
+    bool atBreak(void);
+    bool item(JsonWriter &json, const char *key, uint8_t format, uint8_t depth);
+    bool map(JsonWriter &json, const char *key, bool indefinite, uint64_t count, uint8_t depth);
+};
+
+#endif  // ISSDECODER_h
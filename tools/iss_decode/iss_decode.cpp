@@ -0,0 +1,60 @@
+// iss_decode: print a compact (CBOR) ISS message as JSON
+//
+// Usage:
+//   mosquitto_sub -t 'esp32/default/ISS/1' -C 1 -N | iss_decode
+//   iss_decode bf0001011904d2...          (message as hex digits)
+
+#include "IssDecoder.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MSG_MAX    4096              // longest message [bytes]
+#define JSON_MAX   8192              // longest JSON message [bytes]
+
+
+/************************************************************
+ * Parse hex digits (separators ':' and ' ' are skipped)
+ * @return number of bytes, -1 on error
+ ************************************************************/
+static long parseHex(const char *s, uint8_t *buf, size_t size) {
+  size_t len = 0;
+  unsigned int b;
+  while (*s) {
+    if ((*s == ':') || (*s == ' ')) {
+      s++;
+      continue;
+    }
+    if ((len >= size) || (sscanf(s, "%2x", &b) != 1) || !s[1]) return -1;
+    buf[len++] = (uint8_t)b;
+    s += 2;
+  }
+  return (long)len;
+}
+
+
+int main(int argc, char **argv) {
+  static uint8_t msg[MSG_MAX];
+  static char jsonBuf[JSON_MAX];
+  JsonWriter json(jsonBuf, sizeof(jsonBuf));
+  IssDecoder decoder;
+  long len;
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [hex]  (message from stdin if no hex given)\n", argv[0]);
+    return 2;
+  }
+  if (argc == 2) {
+    len = parseHex(argv[1], msg, sizeof(msg));
+    if (len < 0) {
+      fprintf(stderr, "iss_decode: invalid hex digits\n");
+      return 2;
+    }
+  } else {
+    len = (long)fread(msg, 1, sizeof(msg), stdin);
+  }
+  if (!decoder.decode(msg, (size_t)len, json)) {
+    fprintf(stderr, "iss_decode: %s\n", decoder.error());
+    return 1;
+  }
+  puts(json.c_str());
+  return 0;
+}